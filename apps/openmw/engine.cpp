@@ -1,5 +1,6 @@
 #include "engine.hpp"
 
+#include <cstring>
 #include <iomanip>
 
 #include <boost/filesystem/fstream.hpp>
@@ -7,12 +8,15 @@
 #include <osgViewer/ViewerEventHandlers>
 #include <osgDB/ReadFile>
 #include <osgDB/WriteFile>
+#include <osg/Group>
+#include <osg/Timer>
 
 #include <SDL.h>
 
 #include <components/debug/debuglog.hpp>
 
 #include <components/misc/rng.hpp>
+#include <components/misc/stringops.hpp>
 
 #include <components/vfs/manager.hpp>
 #include <components/vfs/registerarchives.hpp>
@@ -22,11 +26,14 @@
 
 #include <components/resource/resourcesystem.hpp>
 #include <components/resource/scenemanager.hpp>
+#include <components/resource/imagemanager.hpp>
+#include <components/resource/keyframemanager.hpp>
 #include <components/resource/stats.hpp>
 
 #include <components/compiler/extensions0.hpp>
 
 #include <components/sceneutil/workqueue.hpp>
+#include <components/sceneutil/shadow.hpp>
 
 #include <components/files/configurationmanager.hpp>
 
@@ -66,6 +73,56 @@ namespace
         if (ret != 0)
             Log(Debug::Error) << "SDL error: " << SDL_GetError();
     }
+
+    class BuildMeshCacheWorkItem : public SceneUtil::WorkItem
+    {
+    public:
+        BuildMeshCacheWorkItem(Resource::SceneManager* sceneManager, std::vector<std::string>::const_iterator begin, std::vector<std::string>::const_iterator end)
+            : mSceneManager(sceneManager)
+            , mMeshes(begin, end)
+            , mWritten(0)
+        {
+        }
+
+        void doWork() override
+        {
+            for (const std::string& mesh : mMeshes)
+            {
+                try
+                {
+                    if (mSceneManager->writeDiskCacheEntry(mesh))
+                        ++mWritten;
+                }
+                catch (std::exception& e)
+                {
+                    Log(Debug::Warning) << "Failed to cache '" << mesh << "': " << e.what();
+                }
+            }
+        }
+
+        size_t getNumWritten() const { return mWritten; }
+
+    private:
+        Resource::SceneManager* mSceneManager;
+        std::vector<std::string> mMeshes;
+        size_t mWritten;
+    };
+
+    bool isMesh(const std::string& path)
+    {
+        static const char * const sMeshTypes[] = { ".nif", ".osg", ".osgt", ".osgb", ".osgx", ".osg2" };
+
+        std::string lowerCase = Misc::StringUtils::lowerCase(path);
+        if (lowerCase.compare(0, 7, "meshes/") != 0)
+            return false;
+        for (const char* type : sMeshTypes)
+        {
+            size_t length = std::strlen(type);
+            if (lowerCase.size() > length && lowerCase.compare(lowerCase.size() - length, length, type) == 0)
+                return true;
+        }
+        return false;
+    }
 }
 
 void OMW::Engine::executeLocalScripts()
@@ -227,6 +284,7 @@ OMW::Engine::Engine(Files::ConfigurationManager& configurationManager)
   , mGrab(true)
   , mExportFonts(false)
   , mRandomSeed(0)
+  , mBuildMeshCache(false)
   , mScriptContext (0)
   , mFSStrict (false)
   , mScriptBlacklistUse (true)
@@ -259,6 +317,9 @@ OMW::Engine::~Engine()
 
     mViewer = nullptr;
 
+    if (mResourceSystem && Settings::Manager::getBool("precompile shaders", "Shaders"))
+        mResourceSystem->getSceneManager()->getShaderManager().writePermutations(getShaderPermutationsPath());
+
     mResourceSystem.reset();
 
     delete mEncoder;
@@ -315,6 +376,11 @@ void OMW::Engine::setSkipMenu (bool skipMenu, bool newGame)
     mNewGame = newGame;
 }
 
+std::string OMW::Engine::getShaderPermutationsPath() const
+{
+    return (mCfgMgr.getCachePath() / "shaderpermutations.txt").string();
+}
+
 std::string OMW::Engine::loadSettings (Settings::Manager & settings)
 {
     // Create the settings manager and load default settings file
@@ -460,33 +526,131 @@ void OMW::Engine::setWindowIcon()
     }
 }
 
-void OMW::Engine::prepareEngine (Settings::Manager & settings)
+void OMW::Engine::prepareResourceSystem()
 {
-    mEnvironment.setStateManager (
-        new MWState::StateManager (mCfgMgr.getUserDataPath() / "saves", mContentFiles.at (0)));
-
-    createWindow(settings);
-
-    osg::ref_ptr<osg::Group> rootNode (new osg::Group);
-    mViewer->setSceneData(rootNode);
-
     mVFS.reset(new VFS::Manager(mFSStrict));
 
     VFS::registerArchives(mVFS.get(), mFileCollections, mArchives, true);
 
     mResourceSystem.reset(new Resource::ResourceSystem(mVFS.get()));
-    mResourceSystem->getSceneManager()->setUnRefImageDataAfterApply(false); // keep to Off for now to allow better state sharing
-    mResourceSystem->getSceneManager()->setFilterSettings(
+    Resource::SceneManager* sceneManager = mResourceSystem->getSceneManager();
+    sceneManager->setUnRefImageDataAfterApply(false); // keep to Off for now to allow better state sharing
+    sceneManager->setFilterSettings(
         Settings::Manager::getString("texture mag filter", "General"),
         Settings::Manager::getString("texture min filter", "General"),
         Settings::Manager::getString("texture mipmap", "General"),
         Settings::Manager::getInt("anisotropy", "General")
     );
+    sceneManager->setShaderPath((mResDir / "shaders").string());
+    sceneManager->setForceShaders(Settings::Manager::getBool("force shaders", "Shaders") || Settings::Manager::getBool("enable shadows", "Shadows")); // Shadows have problems with fixed-function mode
+    // FIXME: calling dummy method because terrain needs to know whether lighting is clamped
+    sceneManager->setClampLighting(Settings::Manager::getBool("clamp lighting", "Shaders"));
+    sceneManager->setAutoUseNormalMaps(Settings::Manager::getBool("auto use object normal maps", "Shaders"));
+    sceneManager->setNormalMapPattern(Settings::Manager::getString("normal map pattern", "Shaders"));
+    sceneManager->setNormalHeightMapPattern(Settings::Manager::getString("normal height map pattern", "Shaders"));
+    sceneManager->setAutoUseSpecularMaps(Settings::Manager::getBool("auto use object specular maps", "Shaders"));
+    sceneManager->setSpecularMapPattern(Settings::Manager::getString("specular map pattern", "Shaders"));
+
+    // The RenderingManager sets the same global defines again once it has the real shadow manager. Meshes converted
+    // without one, i.e. by buildMeshCache, need them as well to get the shaders they would get in the game.
+    Shader::ShaderManager& shaderManager = sceneManager->getShaderManager();
+    Shader::ShaderManager::DefineMap globalDefines = shaderManager.getGlobalDefines();
+    {
+        SceneUtil::ShadowManager shadowManager(new osg::Group, new osg::Group, 0, 0, shaderManager);
+        for (const auto& define : shadowManager.getShadowDefines())
+            globalDefines[define.first] = define.second;
+    }
+    globalDefines["forcePPL"] = Settings::Manager::getBool("force per pixel lighting", "Shaders") ? "1" : "0";
+    globalDefines["clamp"] = Settings::Manager::getBool("clamp lighting", "Shaders") ? "1" : "0";
+    shaderManager.setGlobalDefines(globalDefines);
 
+    mResourceSystem->getKeyframeManager()->setCompressKeyframes(Settings::Manager::getBool("compress keyframes", "Cells"));
+}
+
+std::string OMW::Engine::getMeshCachePath() const
+{
+    return (mCfgMgr.getCachePath() / "meshes").string();
+}
+
+int OMW::Engine::getNumWorkerThreads() const
+{
     int numThreads = Settings::Manager::getInt("preload num threads", "Cells");
     if (numThreads <= 0)
         throw std::runtime_error("Invalid setting: 'preload num threads' must be >0");
-    mWorkQueue = new SceneUtil::WorkQueue(numThreads);
+    return numThreads;
+}
+
+void OMW::Engine::buildMeshCache()
+{
+    prepareResourceSystem();
+    Resource::SceneManager* sceneManager = mResourceSystem->getSceneManager();
+    sceneManager->setDiskCachePath(getMeshCachePath());
+
+    std::vector<std::string> meshes;
+    for (const auto& file : mVFS->getIndex())
+    {
+        if (isMesh(file.first))
+            meshes.push_back(file.first);
+    }
+
+    Log(Debug::Info) << "Building mesh cache for " << meshes.size() << " meshes in " << getMeshCachePath();
+    osg::Timer timer;
+
+    osg::ref_ptr<SceneUtil::WorkQueue> workQueue = new SceneUtil::WorkQueue(getNumWorkerThreads());
+
+    // Work through the meshes in batches and drop everything loaded in between, so that memory usage stays bounded
+    const size_t batchSize = 256;
+    const size_t meshesPerItem = 16;
+    size_t written = 0;
+    for (size_t batchStart = 0; batchStart < meshes.size(); batchStart += batchSize)
+    {
+        size_t batchEnd = std::min(meshes.size(), batchStart + batchSize);
+
+        std::vector<osg::ref_ptr<BuildMeshCacheWorkItem> > items;
+        for (size_t itemStart = batchStart; itemStart < batchEnd; itemStart += meshesPerItem)
+        {
+            size_t itemEnd = std::min(batchEnd, itemStart + meshesPerItem);
+            items.push_back(new BuildMeshCacheWorkItem(sceneManager, meshes.begin() + itemStart, meshes.begin() + itemEnd));
+            workQueue->addWorkItem(items.back());
+        }
+
+        for (const auto& item : items)
+        {
+            item->waitTillDone();
+            written += item->getNumWritten();
+        }
+
+        mResourceSystem->clearCache();
+
+        Log(Debug::Verbose) << "Processed " << batchEnd << "/" << meshes.size() << " meshes";
+    }
+
+    workQueue = nullptr;
+
+    Log(Debug::Info) << "Wrote " << written << " new cache entries, " << meshes.size() - written << " meshes were cached already or can not be cached, "
+                     << "took " << timer.time_s() << " seconds";
+
+    // No game was running, don't overwrite state recorded during the last session
+    mResourceSystem.reset();
+}
+
+void OMW::Engine::prepareEngine (Settings::Manager & settings)
+{
+    createWindow(settings);
+
+    osg::ref_ptr<osg::Group> rootNode (new osg::Group);
+    mViewer->setSceneData(rootNode);
+
+    prepareResourceSystem();
+    if (Settings::Manager::getBool("mesh disk cache", "Cells"))
+        mResourceSystem->getSceneManager()->setDiskCachePath(getMeshCachePath());
+
+    mWorkQueue = new SceneUtil::WorkQueue(getNumWorkerThreads());
+    if (Settings::Manager::getBool("progressive texture loading", "General"))
+        mResourceSystem->getImageManager()->setProgressiveLoading(mWorkQueue.get(), mViewer->getCamera()->getGraphicsContext());
+
+    mEnvironment.setStateManager (
+        new MWState::StateManager (mCfgMgr.getUserDataPath() / "saves", mContentFiles.at (0), mWorkQueue.get()));
 
     // Create input and UI first to set up a bootstrapping environment for
     // showing a loading screen and keeping the window responsive while doing so
@@ -552,10 +716,18 @@ void OMW::Engine::prepareEngine (Settings::Manager & settings)
     // Create the world
     mEnvironment.setWorld( new MWWorld::World (mViewer, rootNode, mResourceSystem.get(), mWorkQueue.get(),
         mFileCollections, mContentFiles, mEncoder, mActivationDistanceOverride, mCellName,
-        mStartupScript, mResDir.string(), mCfgMgr.getUserDataPath().string()));
+        mStartupScript, mResDir.string(), mCfgMgr.getUserDataPath().string(), mCfgMgr.getCachePath().string()));
     mEnvironment.getWorld()->setupPlayer();
     input->setPlayer(&mEnvironment.getWorld()->getPlayer());
 
+    // The global shader defines are final now, so the programs recorded in previous sessions can be built
+    if (Settings::Manager::getBool("precompile shaders", "Shaders"))
+    {
+        Shader::ShaderManager& shaderManager = mResourceSystem->getSceneManager()->getShaderManager();
+        shaderManager.setRecordPermutations(true);
+        mResourceSystem->getSceneManager()->compilePrograms(shaderManager.readPermutations(getShaderPermutationsPath()));
+    }
+
     window->setStore(mEnvironment.getWorld()->getStore());
     window->initUI();
 
@@ -671,6 +843,12 @@ void OMW::Engine::go()
     // Create encoder
     mEncoder = new ToUTF8::Utf8Encoder(mEncoding);
 
+    if (mBuildMeshCache)
+    {
+        buildMeshCache();
+        return;
+    }
+
     // Setup viewer
     mViewer = new osgViewer::Viewer;
     mViewer->setReleaseContextAtEndOfFrameHint(false);
@@ -831,6 +1009,11 @@ void OMW::Engine::setSaveGameFile(const std::string &savegame)
     mSaveGameFile = savegame;
 }
 
+void OMW::Engine::setBuildMeshCache(bool build)
+{
+    mBuildMeshCache = build;
+}
+
 void OMW::Engine::setRandomSeed(unsigned int seed)
 {
     mRandomSeed = seed;
@@ -100,6 +100,7 @@ namespace OMW
 
             bool mExportFonts;
             unsigned int mRandomSeed;
+            bool mBuildMeshCache;
 
             Compiler::Extensions mExtensions;
             Compiler::Context *mScriptContext;
@@ -124,12 +125,25 @@ namespace OMW
             /// Load settings from various files, returns the path to the user settings file
             std::string loadSettings (Settings::Manager & settings);
 
+            /// Set up the VFS and the resource system, configured the same way for game play and the mesh cache tool
+            void prepareResourceSystem();
+
             /// Prepare engine for game play
             void prepareEngine (Settings::Manager & settings);
 
+            /// Write optimized versions of all meshes in the VFS to the mesh disk cache, instead of starting the game
+            void buildMeshCache();
+
+            std::string getMeshCachePath() const;
+
+            int getNumWorkerThreads() const;
+
             void createWindow(Settings::Manager& settings);
             void setWindowIcon();
 
+            /// Path of the file listing the shader programs used in previous sessions
+            std::string getShaderPermutationsPath() const;
+
         public:
             Engine(Files::ConfigurationManager& configurationManager);
             virtual ~Engine();
@@ -203,6 +217,9 @@ namespace OMW
 
             void setRandomSeed(unsigned int seed);
 
+            /// Fill the mesh disk cache and quit, instead of starting the game.
+            void setBuildMeshCache(bool build);
+
         private:
             Files::ConfigurationManager& mCfgMgr;
     };
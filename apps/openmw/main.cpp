@@ -133,6 +133,9 @@ bool parseOptions (int argc, char** argv, OMW::Engine& engine, Files::Configurat
         ("export-fonts", bpo::value<bool>()->implicit_value(true)
             ->default_value(false), "Export Morrowind .fnt fonts to PNG image and XML file in current directory")
 
+        ("build-mesh-cache", bpo::value<bool>()->implicit_value(true)
+            ->default_value(false), "optimize all meshes and store them in the mesh disk cache, then quit")
+
         ("activate-dist", bpo::value <int> ()->default_value (-1), "activation distance override")
 
         ("random-seed", bpo::value <unsigned int> ()
@@ -237,6 +240,7 @@ bool parseOptions (int argc, char** argv, OMW::Engine& engine, Files::Configurat
     engine.setSoundUsage(!variables["no-sound"].as<bool>());
     engine.setActivationDistanceOverride (variables["activate-dist"].as<int>());
     engine.enableFontExport(variables["export-fonts"].as<bool>());
+    engine.setBuildMeshCache(variables["build-mesh-cache"].as<bool>());
     engine.setRandomSeed(variables["random-seed"].as<unsigned int>());
 
     return true;
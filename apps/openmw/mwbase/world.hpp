@@ -593,6 +593,9 @@ namespace MWBase
             /// Return terrain height at \a worldPos position.
             virtual float getTerrainHeightAt(const osg::Vec3f& worldPos) const = 0;
 
+            /// Return terrain heights at many positions, faster than querying them one by one.
+            virtual void getTerrainHeightsAt(const std::vector<osg::Vec3f>& worldPos, std::vector<float>& heights) const = 0;
+
             /// Return physical or rendering half extents of the given actor.
             virtual osg::Vec3f getHalfExtents(const MWWorld::ConstPtr& actor, bool rendering=false) const = 0;
 
@@ -1,6 +1,7 @@
 #include "effectmanager.hpp"
 
 #include <osg/PositionAttitudeTransform>
+#include <osg/StateSet>
 
 #include <components/resource/resourcesystem.hpp>
 #include <components/resource/scenemanager.hpp>
@@ -33,6 +34,11 @@ void EffectManager::addEffect(const std::string &model, const std::string& textu
 
     Effect effect;
     effect.mAnimTime.reset(new EffectAnimationTime);
+    effect.mModel = model;
+    effect.mNode = node;
+    effect.mStateSet = node->getStateSet();
+    // a non-magic texture override only replaces the root state set, magic ones may change any number of nodes
+    effect.mRecycle = !isMagicVFX || textureOverride.empty();
 
     SceneUtil::FindMaxControllerLengthVisitor findMaxLengthVisitor;
     node->accept(findMaxLengthVisitor);
@@ -63,10 +69,7 @@ void EffectManager::update(float dt)
         it->second.mAnimTime->addTime(dt);
 
         if (it->second.mAnimTime->getTime() >= it->second.mMaxControllerLength)
-        {
-            mParentNode->removeChild(it->first);
-            mEffects.erase(it++);
-        }
+            removeEffect(it++);
         else
             ++it;
     }
@@ -74,11 +77,22 @@ void EffectManager::update(float dt)
 
 void EffectManager::clear()
 {
-    for (EffectMap::iterator it = mEffects.begin(); it != mEffects.end(); ++it)
+    while (!mEffects.empty())
+        removeEffect(mEffects.begin());
+}
+
+void EffectManager::removeEffect(EffectMap::iterator it)
+{
+    mParentNode->removeChild(it->first);
+    it->first->removeChild(it->second.mNode);
+
+    if (it->second.mRecycle)
     {
-        mParentNode->removeChild(it->first);
+        it->second.mNode->setStateSet(it->second.mStateSet);
+        mResourceSystem->getSceneManager()->recycleInstance(it->second.mModel, it->second.mNode);
     }
-    mEffects.clear();
+
+    mEffects.erase(it);
 }
 
 }
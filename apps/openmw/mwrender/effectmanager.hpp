@@ -10,6 +10,8 @@
 namespace osg
 {
     class Group;
+    class Node;
+    class StateSet;
     class Vec3f;
     class PositionAttitudeTransform;
 }
@@ -44,11 +46,17 @@ namespace MWRender
         {
             float mMaxControllerLength;
             std::shared_ptr<EffectAnimationTime> mAnimTime;
+            std::string mModel;
+            osg::ref_ptr<osg::Node> mNode;
+            osg::ref_ptr<osg::StateSet> mStateSet; // of mNode, before the texture override
+            bool mRecycle; // the instance can be restored to its original state
         };
 
         typedef std::map<osg::ref_ptr<osg::PositionAttitudeTransform>, Effect> EffectMap;
         EffectMap mEffects;
 
+        void removeEffect(EffectMap::iterator it);
+
         osg::ref_ptr<osg::Group> mParentNode;
         Resource::ResourceSystem* mResourceSystem;
 
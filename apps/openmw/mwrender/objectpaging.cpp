@@ -0,0 +1,359 @@
+#include "objectpaging.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <memory>
+
+#include <osg/Group>
+#include <osg/MatrixTransform>
+#include <osg/Stats>
+
+#include <components/debug/debuglog.hpp>
+#include <components/esm/esmreader.hpp>
+#include <components/esm/loadcell.hpp>
+#include <components/esm/loadstat.hpp>
+#include <components/misc/constants.hpp>
+#include <components/resource/memoryusage.hpp>
+#include <components/resource/scenemanager.hpp>
+#include <components/sceneutil/staticbatch.hpp>
+#include <components/to_utf8/to_utf8.hpp>
+
+#include "../mwbase/environment.hpp"
+#include "../mwbase/world.hpp"
+
+#include "../mwworld/esmstore.hpp"
+
+#include "vismask.hpp"
+
+namespace
+{
+
+    bool overlapsGrid(float size, const osg::Vec2f& center, const osg::Vec4i& grid)
+    {
+        float halfSize = size / 2.f;
+        return center.x() - halfSize < grid[2] && center.x() + halfSize > grid[0]
+            && center.y() - halfSize < grid[3] && center.y() + halfSize > grid[1];
+    }
+
+    /// Open a content file for reading references, with the same indices of its masters as the reader the engine loaded
+    /// it with, so the reference numbers come out the same.
+    void openReader(ESM::ESMReader& reader, int index, const std::string& filename, ToUTF8::Utf8Encoder* encoder)
+    {
+        // without the encoder, IDs with non-ASCII characters would not match the records in the store
+        reader.setEncoder(encoder);
+        reader.open(filename);
+        reader.setIndex(index);
+
+        const ESM::ESMReader& loaded = MWBase::Environment::get().getWorld()->getEsmReader().at(index);
+        const std::vector<ESM::Header::MasterData>& masters = reader.getGameFiles();
+        for (size_t i=0; i<masters.size() && i<loaded.getGameFiles().size(); ++i)
+            const_cast<ESM::Header::MasterData&>(masters[i]).index = loaded.getGameFiles()[i].index;
+    }
+
+    /// Read the references of a cell from all content files that modify it, the same way the cell store does.
+    void readRefs(const ESM::Cell& cell, std::vector<ESM::ESMReader>& readers, ToUTF8::Utf8Encoder* encoder, std::map<ESM::RefNum, ESM::CellRef>& refs)
+    {
+        for (size_t i=0; i<cell.mContextList.size(); ++i)
+        {
+            try
+            {
+                int index = cell.mContextList[i].index;
+                if (readers.size() <= static_cast<size_t>(index))
+                    readers.resize(index+1);
+                ESM::ESMReader& reader = readers[index];
+                if (reader.getContext().filename != cell.mContextList[i].filename)
+                    openReader(reader, index, cell.mContextList[i].filename, encoder);
+
+                cell.restore(reader, i);
+
+                ESM::CellRef ref;
+                ref.mRefNum.mContentFile = ESM::RefNum::RefNum_NoContentFile;
+                bool deleted = false;
+                while (ESM::Cell::getNextRef(reader, ref, deleted))
+                {
+                    // moved references are drawn in their new cell
+                    if (std::find(cell.mMovedRefs.begin(), cell.mMovedRefs.end(), ref.mRefNum) != cell.mMovedRefs.end())
+                        continue;
+
+                    if (deleted)
+                        refs.erase(ref.mRefNum);
+                    else
+                        refs[ref.mRefNum] = ref;
+                }
+            }
+            catch (std::exception& e)
+            {
+                Log(Debug::Error) << "An error occurred reading references of cell " << cell.getDescription() << " for object paging: " << e.what();
+            }
+        }
+
+        for (const std::pair<ESM::CellRef, bool>& leased : cell.mLeasedRefs)
+        {
+            if (leased.second)
+                refs.erase(leased.first.mRefNum);
+            else
+                refs[leased.first.mRefNum] = leased.first;
+        }
+    }
+
+}
+
+namespace MWRender
+{
+
+    ObjectPaging::ObjectPaging(Resource::SceneManager* sceneManager, const ToUTF8::Utf8Encoder* encoder, float minSize, int halfGridSize)
+        : GenericResourceManager<ChunkId>(nullptr)
+        , mSceneManager(sceneManager)
+        , mEncoder(encoder)
+        , mMinSize(minSize)
+        , mHalfGridSize(halfGridSize)
+        , mBlacklistGeneration(0)
+    {
+    }
+
+    osg::ref_ptr<osg::Node> ObjectPaging::getChunk(float size, const osg::Vec2f& center, unsigned char lod, unsigned int lodFlags)
+    {
+        osg::Vec4i activeGrid;
+        {
+            OpenThreads::ScopedLock<OpenThreads::Mutex> lock(mMutex);
+            activeGrid = mActiveGrid;
+        }
+        return getChunk(size, center, activeGrid);
+    }
+
+    void ObjectPaging::preloadChunk(float size, const osg::Vec2f& center, unsigned char lod, unsigned int lodFlags, const osg::Vec3f& viewPoint)
+    {
+        // The chunks overlapping the active grid are keyed by it, so after the player moved into another cell they would
+        // all be created by the cull traversal. Create them with the grid around the preloaded view point instead.
+        int cellX = static_cast<int>(std::floor(viewPoint.x() / Constants::CellSizeInUnits));
+        int cellY = static_cast<int>(std::floor(viewPoint.y() / Constants::CellSizeInUnits));
+        osg::Vec4i upcomingGrid (cellX - mHalfGridSize, cellY - mHalfGridSize, cellX + mHalfGridSize + 1, cellY + mHalfGridSize + 1);
+        osg::ref_ptr<osg::Node> node = getChunk(size, center, upcomingGrid);
+
+        // Nothing else uses the chunk until the grid changes, keep it from being expired or evicted from the cache until then.
+        // The chunks for the active grid are held by the preloaded view itself.
+        OpenThreads::ScopedLock<OpenThreads::Mutex> lock(mMutex);
+        if (upcomingGrid != mActiveGrid)
+            mPreloadedChunks[upcomingGrid][std::make_tuple(center, size)] = node;
+    }
+
+    osg::ref_ptr<osg::Node> ObjectPaging::getChunk(float size, const osg::Vec2f& center, const osg::Vec4i& grid)
+    {
+        // chunks away from the active grid do not depend on it, so they stay valid when it moves
+        osg::Vec4i activeGrid;
+        if (overlapsGrid(size, center, grid))
+            activeGrid = grid;
+
+        unsigned int generation;
+        {
+            OpenThreads::ScopedLock<OpenThreads::Mutex> lock(mMutex);
+            generation = mBlacklistGeneration;
+        }
+
+        ChunkId id = std::make_tuple(center, size, activeGrid);
+        osg::ref_ptr<osg::Object> obj = mCache->getRefFromObjectCache(id);
+        if (obj)
+            return obj->asNode();
+
+        osg::ref_ptr<osg::Node> node = createChunk(size, center, activeGrid);
+
+        OpenThreads::ScopedLock<OpenThreads::Mutex> lock(mMutex);
+        if (generation == mBlacklistGeneration)
+            mCache->addEntryToObjectCache(id, node.get(), 0.0, Resource::getNodeMemoryUsage(*node));
+        return node;
+    }
+
+    osg::ref_ptr<osg::Node> ObjectPaging::createChunk(float size, const osg::Vec2f& center, const osg::Vec4i& activeGrid)
+    {
+        const MWWorld::ESMStore& store = MWBase::Environment::get().getWorld()->getStore();
+
+        std::set<ESM::RefNum> blacklist;
+        {
+            OpenThreads::ScopedLock<OpenThreads::Mutex> lock(mMutex);
+            blacklist = mBlacklist;
+        }
+
+        const float halfSize = size / 2.f;
+        const osg::Vec2f minBound = center - osg::Vec2f(halfSize, halfSize);
+        const osg::Vec2f maxBound = center + osg::Vec2f(halfSize, halfSize);
+        const float minRadius = mMinSize * size * Constants::CellSizeInUnits;
+
+        SceneUtil::StaticBatchBuilder builder(osg::Vec3f(center.x() * Constants::CellSizeInUnits, center.y() * Constants::CellSizeInUnits, 0.f));
+
+        // nullptr for models that can not be merged
+        std::map<std::string, osg::ref_ptr<const osg::Node> > templates;
+
+        std::vector<ESM::ESMReader> readers;
+        // the encoder's output buffer can't be shared between threads, so each chunk converts with its own
+        std::unique_ptr<ToUTF8::Utf8Encoder> encoder;
+        if (mEncoder)
+            encoder.reset(new ToUTF8::Utf8Encoder(mEncoder->getEncoding()));
+
+        for (int cellX = static_cast<int>(std::floor(minBound.x())); cellX < maxBound.x(); ++cellX)
+        {
+            for (int cellY = static_cast<int>(std::floor(minBound.y())); cellY < maxBound.y(); ++cellY)
+            {
+                if (cellX >= activeGrid[0] && cellX < activeGrid[2] && cellY >= activeGrid[1] && cellY < activeGrid[3])
+                    continue;
+
+                const ESM::Cell* cell = store.get<ESM::Cell>().search(cellX, cellY);
+                if (!cell)
+                    continue;
+
+                std::map<ESM::RefNum, ESM::CellRef> refs;
+                readRefs(*cell, readers, encoder.get(), refs);
+
+                for (const auto& pair : refs)
+                {
+                    const ESM::CellRef& ref = pair.second;
+                    if (blacklist.count(ref.mRefNum))
+                        continue;
+
+                    osg::Vec3f position = ref.mPos.asVec3();
+                    if (size < 1.f)
+                    {
+                        // a chunk smaller than a cell takes the references closest to it, so that each reference of the
+                        // cell ends up in exactly one of the chunks covering it
+                        osg::Vec2f cellPosition (position.x() / Constants::CellSizeInUnits, position.y() / Constants::CellSizeInUnits);
+                        cellPosition.x() = std::min(std::max(cellPosition.x(), float(cellX)), std::nextafter(float(cellX+1), float(cellX)));
+                        cellPosition.y() = std::min(std::max(cellPosition.y(), float(cellY)), std::nextafter(float(cellY+1), float(cellY)));
+                        if (cellPosition.x() < minBound.x() || cellPosition.x() >= maxBound.x()
+                                || cellPosition.y() < minBound.y() || cellPosition.y() >= maxBound.y())
+                            continue;
+                    }
+
+                    const ESM::Static* stat = store.get<ESM::Static>().search(ref.mRefID);
+                    if (!stat || stat->mModel.empty())
+                        continue;
+
+                    std::string model = "meshes\\" + stat->mModel;
+                    auto found = templates.find(model);
+                    if (found == templates.end())
+                    {
+                        osg::ref_ptr<const osg::Node> node;
+                        try
+                        {
+                            node = mSceneManager->getTemplate(model);
+                            if (!SceneUtil::StaticBatchBuilder::canBatch(*node))
+                                node = nullptr;
+                        }
+                        catch (std::exception&)
+                        {
+                            // the error is reported when the object is loaded in its cell
+                        }
+                        found = templates.insert(std::make_pair(model, node)).first;
+                    }
+                    if (!found->second)
+                        continue;
+
+                    if (found->second->getBound().radius() * ref.mScale < minRadius)
+                        continue;
+
+                    const float* rot = ref.mPos.rot;
+                    osg::Quat attitude = osg::Quat(rot[2], osg::Vec3f(0, 0, -1))
+                            * osg::Quat(rot[1], osg::Vec3f(0, -1, 0))
+                            * osg::Quat(rot[0], osg::Vec3f(-1, 0, 0));
+                    osg::Matrix transform = osg::Matrix::scale(osg::Vec3f(ref.mScale, ref.mScale, ref.mScale))
+                            * osg::Matrix::rotate(attitude) * osg::Matrix::translate(position);
+
+                    builder.addInstance(*found->second, transform, nullptr);
+                }
+            }
+        }
+
+        if (!builder.getNumInstances())
+        {
+            // cache empty chunks as well, so the content files are not read again
+            return new osg::Group;
+        }
+
+        osg::ref_ptr<SceneUtil::StaticBatch> batch = builder.build();
+        osg::ref_ptr<osg::Node> node = batch->getNode();
+        node->setNodeMask(Mask_StaticBatch);
+        return node;
+    }
+
+    bool ObjectPaging::setActiveGrid(const osg::Vec4i& grid)
+    {
+        PreloadedChunkMap chunksToRemove;
+        {
+            OpenThreads::ScopedLock<OpenThreads::Mutex> lock(mMutex);
+            if (grid == mActiveGrid)
+                return false;
+            mActiveGrid = grid;
+
+            // Keep the chunks preloaded for the new grid until the next change, by then the views using them hold them.
+            // Those of the other grids are not going to be used.
+            auto found = mPreloadedChunks.find(grid);
+            if (found != mPreloadedChunks.end())
+                chunksToRemove[grid].swap(found->second);
+            chunksToRemove.swap(mPreloadedChunks);
+        }
+        // note, actual unref happens outside of the lock
+        return true;
+    }
+
+    bool ObjectPaging::blacklistObject(const ESM::RefNum& refNum, const osg::Vec3f& position)
+    {
+        {
+            OpenThreads::ScopedLock<OpenThreads::Mutex> lock(mMutex);
+            if (!mBlacklist.insert(refNum).second)
+                return false;
+            ++mBlacklistGeneration;
+        }
+
+        osg::Vec2f cell (std::floor(position.x() / Constants::CellSizeInUnits), std::floor(position.y() / Constants::CellSizeInUnits));
+        auto overlapsCell = [&] (const osg::Vec2f& center, float size)
+        {
+            float halfSize = size / 2.f;
+            return center.x() - halfSize < cell.x() + 1 && center.x() + halfSize > cell.x()
+                && center.y() - halfSize < cell.y() + 1 && center.y() + halfSize > cell.y();
+        };
+
+        bool removed = false;
+        mCache->removeFromObjectCacheIf([&](const ChunkId& id)
+        {
+            bool overlaps = overlapsCell(std::get<0>(id), std::get<1>(id));
+            removed |= overlaps;
+            return overlaps;
+        });
+
+        std::vector<osg::ref_ptr<osg::Node> > chunksToRemove;
+        {
+            OpenThreads::ScopedLock<OpenThreads::Mutex> lock(mMutex);
+            for (auto& grid : mPreloadedChunks)
+            {
+                for (auto it = grid.second.begin(); it != grid.second.end();)
+                {
+                    if (overlapsCell(std::get<0>(it->first), std::get<1>(it->first)))
+                    {
+                        chunksToRemove.push_back(it->second);
+                        it = grid.second.erase(it);
+                    }
+                    else
+                        ++it;
+                }
+            }
+        }
+        return removed;
+    }
+
+    void ObjectPaging::clear()
+    {
+        PreloadedChunkMap chunksToRemove;
+        {
+            OpenThreads::ScopedLock<OpenThreads::Mutex> lock(mMutex);
+            mBlacklist.clear();
+            ++mBlacklistGeneration;
+            chunksToRemove.swap(mPreloadedChunks);
+        }
+        mCache->clear();
+    }
+
+    void ObjectPaging::reportStats(unsigned int frameNumber, osg::Stats* stats) const
+    {
+        stats->setAttribute(frameNumber, "Object Chunk", mCache->getCacheSize());
+    }
+
+}
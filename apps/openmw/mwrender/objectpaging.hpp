@@ -0,0 +1,86 @@
+#ifndef OPENMW_MWRENDER_OBJECTPAGING_H
+#define OPENMW_MWRENDER_OBJECTPAGING_H
+
+#include <map>
+#include <set>
+#include <tuple>
+
+#include <osg/Vec2f>
+#include <osg/Vec3f>
+#include <osg/Vec4i>
+
+#include <OpenThreads/Mutex>
+
+#include <components/esm/cellref.hpp>
+#include <components/resource/resourcemanager.hpp>
+#include <components/terrain/quadtreeworld.hpp>
+
+namespace Resource
+{
+    class SceneManager;
+}
+
+namespace ToUTF8
+{
+    class Utf8Encoder;
+}
+
+namespace MWRender
+{
+
+    typedef std::tuple<osg::Vec2f, float, osg::Vec4i> ChunkId; // Center, Size, Active grid if the chunk overlaps it
+
+    /// @brief Draws the static objects of the cells outside of the active grid along with the distant terrain.
+    /// @par The objects of each terrain chunk are read from the content files and merged into a few drawables. Objects that
+    /// are small compared to the chunk are left out, so distant chunks only show the landmarks.
+    /// @note Changes made to objects in the game are not known until their cell is loaded, see blacklistObject.
+    class ObjectPaging : public Resource::GenericResourceManager<ChunkId>, public Terrain::QuadTreeWorld::ChunkManager
+    {
+    public:
+        /// @param encoder The encoder the content files were loaded with, may be nullptr.
+        /// @param minSize Objects with a bounding radius below this fraction of the chunk size are not drawn.
+        /// @param halfGridSize The number of cells the active grid extends from the player's cell in each direction.
+        ObjectPaging(Resource::SceneManager* sceneManager, const ToUTF8::Utf8Encoder* encoder, float minSize, int halfGridSize);
+
+        osg::ref_ptr<osg::Node> getChunk(float size, const osg::Vec2f& center, unsigned char lod, unsigned int lodFlags) override;
+
+        /// Create the chunk for the active grid that will be centered on the cell of \a viewPoint once it is reached.
+        void preloadChunk(float size, const osg::Vec2f& center, unsigned char lod, unsigned int lodFlags, const osg::Vec3f& viewPoint) override;
+
+        /// Set the exterior cells whose objects are drawn by the scene instead, as the grid coordinates of the first cell
+        /// followed by those past the last cell.
+        /// @return Has the active grid changed?
+        bool setActiveGrid(const osg::Vec4i& grid);
+
+        /// Stop drawing a reference from the content files, e.g. because it was moved or disabled in the game.
+        /// @param position The position of the reference in the content file.
+        /// @return Has a cached chunk been discarded?
+        bool blacklistObject(const ESM::RefNum& refNum, const osg::Vec3f& position);
+
+        /// Forget about the blacklisted references and discard all chunks.
+        void clear();
+
+        void reportStats(unsigned int frameNumber, osg::Stats* stats) const override;
+
+    private:
+        osg::ref_ptr<osg::Node> getChunk(float size, const osg::Vec2f& center, const osg::Vec4i& grid);
+
+        osg::ref_ptr<osg::Node> createChunk(float size, const osg::Vec2f& center, const osg::Vec4i& activeGrid);
+
+        Resource::SceneManager* mSceneManager;
+        const ToUTF8::Utf8Encoder* mEncoder;
+        float mMinSize;
+        int mHalfGridSize;
+
+        OpenThreads::Mutex mMutex; // protects the members below
+        osg::Vec4i mActiveGrid;
+        std::set<ESM::RefNum> mBlacklist;
+        // <grid, <<center, size>, chunk>> created by preloadChunk for a grid that is not active yet
+        typedef std::map<osg::Vec4i, std::map<std::tuple<osg::Vec2f, float>, osg::ref_ptr<osg::Node> > > PreloadedChunkMap;
+        PreloadedChunkMap mPreloadedChunks;
+        unsigned int mBlacklistGeneration; // chunks created before the blacklist changed are not cached
+    };
+
+}
+
+#endif
@@ -1,10 +1,22 @@
 #include "objects.hpp"
 
+#include <cmath>
+#include <memory>
+#include <typeinfo>
+
 #include <osg/Group>
+#include <osg/MatrixTransform>
 #include <osg/UserDataContainer>
 
+#include <components/esm/loadstat.hpp>
+#include <components/misc/constants.hpp>
+#include <components/resource/resourcesystem.hpp>
+#include <components/resource/scenemanager.hpp>
+#include <components/sceneutil/lightmanager.hpp>
 #include <components/sceneutil/positionattitudetransform.hpp>
+#include <components/sceneutil/staticbatch.hpp>
 #include <components/sceneutil/unrefqueue.hpp>
+#include <components/sceneutil/workqueue.hpp>
 
 #include "../mwworld/ptr.hpp"
 #include "../mwworld/class.hpp"
@@ -15,13 +27,101 @@
 #include "vismask.hpp"
 
 
+namespace
+{
+    // Batches cover square chunks of this size, so that culling and light lists stay reasonably fine-grained
+    const float sBatchChunkSize = Constants::CellSizeInUnits / 4.f;
+}
+
 namespace MWRender
 {
 
-Objects::Objects(Resource::ResourceSystem* resourceSystem, osg::ref_ptr<osg::Group> rootNode, SceneUtil::UnrefQueue* unrefQueue)
+class BatchCellWorkItem : public SceneUtil::WorkItem
+{
+public:
+    struct Object
+    {
+        osg::ref_ptr<const osg::Node> mBaseNode;
+        std::string mModel;
+        osg::Matrix mTransform;
+    };
+
+    BatchCellWorkItem(Resource::SceneManager* sceneManager)
+        : mSceneManager(sceneManager)
+    {
+    }
+
+    void addObject(const SceneUtil::PositionAttitudeTransform* baseNode, const std::string& model)
+    {
+        Object object;
+        object.mBaseNode = baseNode;
+        object.mModel = model;
+        baseNode->computeLocalToWorldMatrix(object.mTransform, nullptr);
+        mObjects.push_back(object);
+    }
+
+    void doWork() override
+    {
+        typedef std::pair<int, int> ChunkCoord;
+        std::map<ChunkCoord, std::unique_ptr<SceneUtil::StaticBatchBuilder> > builders;
+
+        // nullptr for models that can not be batched
+        std::map<std::string, osg::ref_ptr<const osg::Node> > templates;
+
+        for (const Object& object : mObjects)
+        {
+            auto found = templates.find(object.mModel);
+            if (found == templates.end())
+            {
+                osg::ref_ptr<const osg::Node> node;
+                try
+                {
+                    node = mSceneManager->getTemplate(object.mModel);
+                    if (!SceneUtil::StaticBatchBuilder::canBatch(*node))
+                        node = nullptr;
+                }
+                catch (std::exception&)
+                {
+                    // the error was reported when the object itself was loaded
+                }
+                found = templates.insert(std::make_pair(object.mModel, node)).first;
+            }
+            if (!found->second)
+                continue;
+
+            osg::Vec3f position = object.mTransform.getTrans();
+            ChunkCoord coord (static_cast<int>(std::floor(position.x() / sBatchChunkSize)), static_cast<int>(std::floor(position.y() / sBatchChunkSize)));
+            std::unique_ptr<SceneUtil::StaticBatchBuilder>& builder = builders[coord];
+            if (!builder)
+                builder.reset(new SceneUtil::StaticBatchBuilder(osg::Vec3f((coord.first + 0.5f) * sBatchChunkSize, (coord.second + 0.5f) * sBatchChunkSize, 0.f)));
+            builder->addInstance(*found->second, object.mTransform, object.mBaseNode.get());
+        }
+
+        for (const auto& pair : builders)
+        {
+            // a single object gains nothing from being batched
+            if (pair.second->getNumInstances() > 1)
+                mBatches.push_back(pair.second->build());
+        }
+    }
+
+    const std::vector<Object>& getObjects() const { return mObjects; }
+
+    /// @note Only valid once the work is done.
+    const std::vector<osg::ref_ptr<SceneUtil::StaticBatch> >& getBatches() const { return mBatches; }
+
+private:
+    Resource::SceneManager* mSceneManager;
+    std::vector<Object> mObjects;
+    std::vector<osg::ref_ptr<SceneUtil::StaticBatch> > mBatches;
+};
+
+Objects::Objects(Resource::ResourceSystem* resourceSystem, osg::ref_ptr<osg::Group> rootNode, SceneUtil::UnrefQueue* unrefQueue,
+                 SceneUtil::WorkQueue* batchWorkQueue)
     : mRootNode(rootNode)
     , mResourceSystem(resourceSystem)
     , mUnrefQueue(unrefQueue)
+    , mBatchWorkQueue(batchWorkQueue)
 {
 }
 
@@ -114,6 +214,8 @@ bool Objects::removeObject (const MWWorld::Ptr& ptr)
     if(!ptr.getRefData().getBaseNode())
         return true;
 
+    unbatchObject(ptr);
+
     PtrAnimationMap::iterator iter = mObjects.find(ptr);
     if(iter != mObjects.end())
     {
@@ -162,6 +264,26 @@ void Objects::removeCell(const MWWorld::CellStore* store)
             ++iter;
     }
 
+    auto pending = mPendingBatches.find(store);
+    if (pending != mPendingBatches.end())
+    {
+        for (const BatchCellWorkItem::Object& object : pending->second->getObjects())
+            mPendingObjects.erase(object.mBaseNode.get());
+        mPendingBatches.erase(pending);
+    }
+
+    auto batches = mCellBatches.find(store);
+    if (batches != mCellBatches.end())
+    {
+        // the batch nodes are removed along with the cell node
+        for (const auto& batch : batches->second)
+        {
+            for (const void* id : batch->getInstances())
+                mBatchedObjects.erase(static_cast<const osg::Node*>(id));
+        }
+        mCellBatches.erase(batches);
+    }
+
     CellMap::iterator cell = mCellSceneNodes.find(store);
     if(cell != mCellSceneNodes.end())
     {
@@ -172,12 +294,104 @@ void Objects::removeCell(const MWWorld::CellStore* store)
     }
 }
 
+void Objects::batchCell(const MWWorld::CellStore* store)
+{
+    if (!mBatchWorkQueue || mCellSceneNodes.find(store) == mCellSceneNodes.end())
+        return;
+
+    osg::ref_ptr<BatchCellWorkItem> item (new BatchCellWorkItem(mResourceSystem->getSceneManager()));
+    for (PtrAnimationMap::iterator iter = mObjects.begin(); iter != mObjects.end(); ++iter)
+    {
+        MWWorld::Ptr ptr = iter->second->getPtr();
+        if (ptr.getCell() != store || ptr.getTypeName() != typeid(ESM::Static).name())
+            continue;
+
+        // objects that are not rendered as plain statics (e.g. hidden ones) are left alone
+        SceneUtil::PositionAttitudeTransform* baseNode = ptr.getRefData().getBaseNode();
+        if (!baseNode || baseNode->getNodeMask() != Mask_Static)
+            continue;
+
+        item->addObject(baseNode, ptr.getClass().getModel(ptr));
+    }
+
+    if (item->getObjects().size() < 2)
+        return;
+
+    for (const BatchCellWorkItem::Object& object : item->getObjects())
+        mPendingObjects.insert(object.mBaseNode.get());
+
+    mPendingBatches[store] = item;
+    mBatchWorkQueue->addWorkItem(item);
+}
+
+void Objects::updateBatches()
+{
+    for (auto iter = mPendingBatches.begin(); iter != mPendingBatches.end();)
+    {
+        if (!iter->second->isDone())
+        {
+            ++iter;
+            continue;
+        }
+
+        CellMap::iterator cell = mCellSceneNodes.find(iter->first);
+        for (const osg::ref_ptr<SceneUtil::StaticBatch>& batch : iter->second->getBatches())
+        {
+            if (cell == mCellSceneNodes.end())
+                break;
+
+            for (const void* id : batch->getInstances())
+            {
+                // the object was changed or removed while the batch was being built
+                if (mPendingObjects.find(static_cast<const osg::Node*>(id)) == mPendingObjects.end())
+                {
+                    batch->hideInstance(id);
+                    continue;
+                }
+
+                // the work item holds a reference to the base node, so it is still alive
+                osg::Node* baseNode = const_cast<osg::Node*>(static_cast<const osg::Node*>(id));
+                baseNode->setNodeMask(Mask_BatchedObject);
+                mBatchedObjects[baseNode] = batch;
+            }
+
+            batch->getNode()->setNodeMask(Mask_StaticBatch);
+            batch->getNode()->addCullCallback(new SceneUtil::LightListCallback);
+            cell->second->addChild(batch->getNode());
+            mCellBatches[iter->first].push_back(batch);
+        }
+
+        for (const BatchCellWorkItem::Object& object : iter->second->getObjects())
+            mPendingObjects.erase(object.mBaseNode.get());
+        mPendingBatches.erase(iter++);
+    }
+}
+
+void Objects::unbatchObject(const MWWorld::Ptr &ptr)
+{
+    SceneUtil::PositionAttitudeTransform* baseNode = ptr.getRefData().getBaseNode();
+    if (!baseNode)
+        return;
+
+    mPendingObjects.erase(baseNode);
+
+    BatchMap::iterator found = mBatchedObjects.find(baseNode);
+    if (found == mBatchedObjects.end())
+        return;
+
+    found->second->hideInstance(baseNode);
+    mBatchedObjects.erase(found);
+    baseNode->setNodeMask(Mask_Static);
+}
+
 void Objects::updatePtr(const MWWorld::Ptr &old, const MWWorld::Ptr &cur)
 {
     osg::Node* objectNode = cur.getRefData().getBaseNode();
     if (!objectNode)
         return;
 
+    unbatchObject(cur);
+
     MWWorld::CellStore *newCell = cur.getCell();
 
     osg::Group* cellnode;
@@ -2,7 +2,9 @@
 #define GAME_RENDER_OBJECTS_H
 
 #include <map>
+#include <set>
 #include <string>
+#include <vector>
 
 #include <osg/ref_ptr>
 #include <osg/Object>
@@ -27,11 +29,14 @@ namespace MWWorld
 namespace SceneUtil
 {
     class UnrefQueue;
+    class WorkQueue;
+    class StaticBatch;
 }
 
 namespace MWRender{
 
 class Animation;
+class BatchCellWorkItem;
 
 class PtrHolder : public osg::Object
 {
@@ -68,10 +73,21 @@ class Objects{
 
     osg::ref_ptr<SceneUtil::UnrefQueue> mUnrefQueue;
 
+    osg::ref_ptr<SceneUtil::WorkQueue> mBatchWorkQueue;
+
+    typedef std::map<const osg::Node*, osg::ref_ptr<SceneUtil::StaticBatch> > BatchMap;
+    BatchMap mBatchedObjects; // base node -> batch drawing it
+
+    std::map<const MWWorld::CellStore*, std::vector<osg::ref_ptr<SceneUtil::StaticBatch> > > mCellBatches;
+    std::map<const MWWorld::CellStore*, osg::ref_ptr<BatchCellWorkItem> > mPendingBatches;
+    std::set<const osg::Node*> mPendingObjects; // base nodes of objects in mPendingBatches that were not unbatched yet
+
     void insertBegin(const MWWorld::Ptr& ptr);
 
 public:
-    Objects(Resource::ResourceSystem* resourceSystem, osg::ref_ptr<osg::Group> rootNode, SceneUtil::UnrefQueue* unrefQueue);
+    /// @param batchWorkQueue If not null, static objects are merged into batches in this queue's threads, see batchCell().
+    Objects(Resource::ResourceSystem* resourceSystem, osg::ref_ptr<osg::Group> rootNode, SceneUtil::UnrefQueue* unrefQueue,
+            SceneUtil::WorkQueue* batchWorkQueue);
     ~Objects();
 
     /// @param animated Attempt to load separate keyframes from a .kf file matching the model file?
@@ -89,6 +105,18 @@ public:
 
     void removeCell(const MWWorld::CellStore* store);
 
+    /// Merge the geometry of the static objects in the given cell into a few batches in the background, to cut down on
+    /// cull traversal and draw calls. The batches are attached in updateBatches() once they are ready.
+    /// @note Call after all objects of the cell were inserted.
+    void batchCell(const MWWorld::CellStore* store);
+
+    /// Attach finished batches to the scene graph. Call once per frame.
+    void updateBatches();
+
+    /// Remove the object from its batch, if any, so that it is drawn individually again.
+    /// @note Call before changing the object's base node.
+    void unbatchObject(const MWWorld::Ptr& ptr);
+
     /// Updates containing cell for object rendering data
     void updatePtr(const MWWorld::Ptr &old, const MWWorld::Ptr &cur);
 
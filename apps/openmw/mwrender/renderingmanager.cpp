@@ -2,6 +2,7 @@
 
 #include <limits>
 #include <cstdlib>
+#include <typeinfo>
 
 #include <osg/Light>
 #include <osg/LightModel>
@@ -21,6 +22,8 @@
 
 #include <osgViewer/Viewer>
 
+#include <boost/filesystem/path.hpp>
+
 #include <components/debug/debuglog.hpp>
 
 #include <components/resource/resourcesystem.hpp>
@@ -39,11 +42,14 @@
 #include <components/sceneutil/unrefqueue.hpp>
 #include <components/sceneutil/writescene.hpp>
 #include <components/sceneutil/shadow.hpp>
+#include <components/sceneutil/riggeometry.hpp>
+#include <components/sceneutil/skeleton.hpp>
 
 #include <components/terrain/terraingrid.hpp>
 #include <components/terrain/quadtreeworld.hpp>
 
 #include <components/esm/loadcell.hpp>
+#include <components/esm/loadstat.hpp>
 #include <components/fallback/fallback.hpp>
 
 #include <components/detournavigator/navigator.hpp>
@@ -67,6 +73,7 @@
 #include "util.hpp"
 #include "navmesh.hpp"
 #include "actorspaths.hpp"
+#include "objectpaging.hpp"
 
 namespace
 {
@@ -195,7 +202,8 @@ namespace MWRender
 
     RenderingManager::RenderingManager(osgViewer::Viewer* viewer, osg::ref_ptr<osg::Group> rootNode,
                                        Resource::ResourceSystem* resourceSystem, SceneUtil::WorkQueue* workQueue,
-                                       const std::string& resourcePath, DetourNavigator::Navigator& navigator)
+                                       const std::string& resourcePath, const std::string& cachePath, DetourNavigator::Navigator& navigator,
+                                       const ToUTF8::Utf8Encoder* encoder)
         : mViewer(viewer)
         , mRootNode(rootNode)
         , mResourceSystem(resourceSystem)
@@ -217,15 +225,12 @@ namespace MWRender
         , mBorders(false)
     {
         resourceSystem->getSceneManager()->setParticleSystemMask(MWRender::Mask_ParticleSystem);
-        resourceSystem->getSceneManager()->setShaderPath(resourcePath + "/shaders");
-        resourceSystem->getSceneManager()->setForceShaders(Settings::Manager::getBool("force shaders", "Shaders") || Settings::Manager::getBool("enable shadows", "Shadows")); // Shadows have problems with fixed-function mode
-        // FIXME: calling dummy method because terrain needs to know whether lighting is clamped
-        resourceSystem->getSceneManager()->setClampLighting(Settings::Manager::getBool("clamp lighting", "Shaders"));
-        resourceSystem->getSceneManager()->setAutoUseNormalMaps(Settings::Manager::getBool("auto use object normal maps", "Shaders"));
-        resourceSystem->getSceneManager()->setNormalMapPattern(Settings::Manager::getString("normal map pattern", "Shaders"));
-        resourceSystem->getSceneManager()->setNormalHeightMapPattern(Settings::Manager::getString("normal height map pattern", "Shaders"));
-        resourceSystem->getSceneManager()->setAutoUseSpecularMaps(Settings::Manager::getBool("auto use object specular maps", "Shaders"));
-        resourceSystem->getSceneManager()->setSpecularMapPattern(Settings::Manager::getString("specular map pattern", "Shaders"));
+
+        int skinningThreads = Settings::Manager::getInt("skinning num threads", "Game");
+        if (skinningThreads > 0)
+            SceneUtil::RigGeometry::setSkinningWorkQueue(new SceneUtil::WorkQueue(skinningThreads));
+        SceneUtil::Skeleton::setUpdateRateDistances(Settings::Manager::getFloat("half rate animation distance", "Game"),
+                                                    Settings::Manager::getFloat("quarter rate animation distance", "Game"));
 
         osg::ref_ptr<SceneUtil::LightManager> sceneRoot = new SceneUtil::LightManager;
         sceneRoot->setLightingMask(Mask_Lighting);
@@ -242,7 +247,7 @@ namespace MWRender
 
         int indoorShadowCastingTraversalMask = shadowCastingTraversalMask;
         if (Settings::Manager::getBool("object shadows", "Shadows"))
-            shadowCastingTraversalMask |= (Mask_Object|Mask_Static);
+            shadowCastingTraversalMask |= (Mask_Object|Mask_Static|Mask_StaticBatch);
 
         mShadowManager.reset(new SceneUtil::ShadowManager(sceneRoot, mRootNode, shadowCastingTraversalMask, indoorShadowCastingTraversalMask, mResourceSystem->getSceneManager()->getShaderManager()));
 
@@ -262,7 +267,8 @@ namespace MWRender
         mActorsPaths.reset(new ActorsPaths(mRootNode, Settings::Manager::getBool("enable agents paths render", "Navigator")));
         mPathgrid.reset(new Pathgrid(mRootNode));
 
-        mObjects.reset(new Objects(mResourceSystem, sceneRoot, mUnrefQueue.get()));
+        mObjects.reset(new Objects(mResourceSystem, sceneRoot, mUnrefQueue.get(),
+                                   Settings::Manager::getBool("batch static objects", "Cells") ? mWorkQueue.get() : nullptr));
 
         if (getenv("OPENMW_DONT_PRECOMPILE") == nullptr)
         {
@@ -305,15 +311,31 @@ namespace MWRender
             const int vertexLodMod = Settings::Manager::getInt("vertex lod mod", "Terrain");
             float maxCompGeometrySize = Settings::Manager::getFloat("max composite geometry size", "Terrain");
             maxCompGeometrySize = std::max(maxCompGeometrySize, 1.f);
-            mTerrain.reset(new Terrain::QuadTreeWorld(
+            Terrain::QuadTreeWorld* quadTreeWorld = new Terrain::QuadTreeWorld(
                 sceneRoot, mRootNode, mResourceSystem, mTerrainStorage, Mask_Terrain, Mask_PreCompile, Mask_Debug,
-                compMapResolution, compMapLevel, lodFactor, vertexLodMod, maxCompGeometrySize));
+                compMapResolution, compMapLevel, lodFactor, vertexLodMod, maxCompGeometrySize);
+            mTerrain.reset(quadTreeWorld);
+
+            // a queue of its own, the preloading runs on mWorkQueue and waits for the chunks
+            int chunkThreads = Settings::Manager::getInt("chunk preload num threads", "Terrain");
+            if (chunkThreads > 0)
+                quadTreeWorld->setChunkWorkQueue(new SceneUtil::WorkQueue(chunkThreads));
+
+            if (Settings::Manager::getBool("object paging", "Terrain"))
+            {
+                mObjectPaging.reset(new ObjectPaging(mResourceSystem->getSceneManager(), encoder, Settings::Manager::getFloat("object paging min size", "Terrain"),
+                                                     Settings::Manager::getInt("exterior cell load distance", "Cells")));
+                quadTreeWorld->addChunkManager(mObjectPaging.get());
+                mResourceSystem->addResourceManager(mObjectPaging.get());
+            }
         }
         else
             mTerrain.reset(new Terrain::TerrainGrid(sceneRoot, mRootNode, mResourceSystem, mTerrainStorage, Mask_Terrain, Mask_PreCompile, Mask_Debug));
 
         mTerrain->setTargetFrameRate(Settings::Manager::getFloat("target framerate", "Cells"));
         mTerrain->setWorkQueue(mWorkQueue.get());
+        if (Settings::Manager::getBool("composite map disk cache", "Terrain"))
+            mTerrain->setCompositeMapDiskCachePath((boost::filesystem::path(cachePath) / "terrain").string());
 
         mCamera.reset(new Camera(mViewer->getCamera()));
 
@@ -367,7 +389,7 @@ namespace MWRender
         mViewer->getCamera()->setComputeNearFarMode(osg::Camera::DO_NOT_COMPUTE_NEAR_FAR);
         mViewer->getCamera()->setCullingMode(cullingMode);
 
-        mViewer->getCamera()->setCullMask(~(Mask_UpdateVisitor|Mask_SimpleWater));
+        mViewer->getCamera()->setCullMask(~(Mask_UpdateVisitor|Mask_SimpleWater|Mask_BatchedObject));
 
         mNearClip = Settings::Manager::getFloat("near clip", "Camera");
         mViewDistance = Settings::Manager::getFloat("viewing distance", "Camera");
@@ -389,6 +411,11 @@ namespace MWRender
     {
         // let background loading thread finish before we delete anything else
         mWorkQueue = nullptr;
+
+        if (mObjectPaging)
+            mResourceSystem->removeResourceManager(mObjectPaging.get());
+
+        SceneUtil::RigGeometry::setSkinningWorkQueue(nullptr);
     }
 
     MWRender::Objects& RenderingManager::getObjects()
@@ -431,6 +458,18 @@ namespace MWRender
 
         workItem->mTextures.push_back("textures/_land_default.dds");
 
+        // blood splatters are spawned in large numbers during combat
+        int poolSize = Settings::Manager::getInt("effect instance pool size", "Cells");
+        if (poolSize > 0)
+        {
+            for (int i=0; i<3; ++i)
+            {
+                std::string model = Fallback::Map::getString("Blood_Model_" + std::to_string(i));
+                if (!model.empty())
+                    mResourceSystem->getSceneManager()->setInstancePoolSize("meshes\\" + model, poolSize);
+            }
+        }
+
         mWorkQueue->addWorkItem(workItem);
     }
 
@@ -513,6 +552,8 @@ namespace MWRender
 
         if (store->getCell()->isExterior())
             mTerrain->loadCell(store->getCell()->getGridX(), store->getCell()->getGridY());
+
+        mObjects->batchCell(store);
     }
     void RenderingManager::removeCell(const MWWorld::CellStore *store)
     {
@@ -524,6 +565,28 @@ namespace MWRender
             mTerrain->unloadCell(store->getCell()->getGridX(), store->getCell()->getGridY());
 
         mWater->removeCell(store);
+
+        if (mObjectPaging && store->getCell()->isExterior())
+        {
+            // The paged objects are read from the content files. Changes made in the game are only known while the cell is
+            // loaded, so keep the changed objects out of the chunks from now on.
+            bool rebuildViews = false;
+            store->forEachConst([&](const MWWorld::ConstPtr& ptr)
+            {
+                if (ptr.getTypeName() == typeid(ESM::Static).name() && ptr.getCellRef().hasContentFile()
+                        && (ptr.getRefData().hasChanged() || ptr.getCellRef().hasChanged()))
+                    rebuildViews |= mObjectPaging->blacklistObject(ptr.getCellRef().getRefNum(), ptr.getCellRef().getPosition().asVec3());
+                return true;
+            });
+            if (rebuildViews)
+                static_cast<Terrain::QuadTreeWorld*>(mTerrain.get())->rebuildViews();
+        }
+    }
+
+    void RenderingManager::setActiveGrid(const osg::Vec4i& grid)
+    {
+        if (mObjectPaging && mObjectPaging->setActiveGrid(grid))
+            static_cast<Terrain::QuadTreeWorld*>(mTerrain.get())->rebuildViews();
     }
 
     void RenderingManager::enableTerrain(bool enable)
@@ -639,6 +702,8 @@ namespace MWRender
 
         mUnrefQueue->flush(mWorkQueue.get());
 
+        mObjects->updateBatches();
+
         if (!paused)
         {
             mEffectManager->update(dt);
@@ -691,16 +756,19 @@ namespace MWRender
             mCamera->rotateCamera(-ptr.getRefData().getPosition().rot[0], -ptr.getRefData().getPosition().rot[2], false);
         }
 
+        mObjects->unbatchObject(ptr);
         ptr.getRefData().getBaseNode()->setAttitude(rot);
     }
 
     void RenderingManager::moveObject(const MWWorld::Ptr &ptr, const osg::Vec3f &pos)
     {
+        mObjects->unbatchObject(ptr);
         ptr.getRefData().getBaseNode()->setPosition(pos);
     }
 
     void RenderingManager::scaleObject(const MWWorld::Ptr &ptr, const osg::Vec3f &scale)
     {
+        mObjects->unbatchObject(ptr);
         ptr.getRefData().getBaseNode()->setScale(scale);
 
         if (ptr == mCamera->getTrackingPtr()) // update height of camera
@@ -1050,7 +1118,7 @@ namespace MWRender
         mIntersectionVisitor->setIntersector(intersector);
 
         int mask = ~0;
-        mask &= ~(Mask_RenderToTexture|Mask_Sky|Mask_Debug|Mask_Effect|Mask_Water|Mask_SimpleWater);
+        mask &= ~(Mask_RenderToTexture|Mask_Sky|Mask_Debug|Mask_Effect|Mask_Water|Mask_SimpleWater|Mask_StaticBatch);
         if (ignorePlayer)
             mask &= ~(Mask_Player);
         if (ignoreActors)
@@ -1110,6 +1178,12 @@ namespace MWRender
     {
         mSky->setMoonColour(false);
 
+        if (mObjectPaging)
+        {
+            mObjectPaging->clear();
+            static_cast<Terrain::QuadTreeWorld*>(mTerrain.get())->rebuildViews();
+        }
+
         notifyWorldSpaceChanged();
     }
 
@@ -1288,6 +1362,11 @@ namespace MWRender
         return mTerrain->getHeightAt(pos);
     }
 
+    void RenderingManager::getTerrainHeightsAt(const std::vector<osg::Vec3f> &pos, std::vector<float> &heights)
+    {
+        mTerrain->getHeightsAt(pos, heights);
+    }
+
     bool RenderingManager::vanityRotateCamera(const float *rot)
     {
         if(!mCamera->isVanityOrPreviewModeEnabled())
@@ -19,6 +19,7 @@ namespace osg
 {
     class Group;
     class PositionAttitudeTransform;
+    class Vec4i;
 }
 
 namespace osgUtil
@@ -59,6 +60,11 @@ namespace SceneUtil
     class UnrefQueue;
 }
 
+namespace ToUTF8
+{
+    class Utf8Encoder;
+}
+
 namespace DetourNavigator
 {
     struct Navigator;
@@ -80,13 +86,15 @@ namespace MWRender
     class LandManager;
     class NavMesh;
     class ActorsPaths;
+    class ObjectPaging;
 
     class RenderingManager : public MWRender::RenderingInterface
     {
     public:
         RenderingManager(osgViewer::Viewer* viewer, osg::ref_ptr<osg::Group> rootNode,
                          Resource::ResourceSystem* resourceSystem, SceneUtil::WorkQueue* workQueue,
-                         const std::string& resourcePath, DetourNavigator::Navigator& navigator);
+                         const std::string& resourcePath, const std::string& cachePath, DetourNavigator::Navigator& navigator,
+                         const ToUTF8::Utf8Encoder* encoder);
         ~RenderingManager();
 
         MWRender::Objects& getObjects();
@@ -125,6 +133,9 @@ namespace MWRender
         void addCell(const MWWorld::CellStore* store);
         void removeCell(const MWWorld::CellStore* store);
 
+        /// Set the exterior cells that are loaded, as the grid coordinates of the first cell followed by those past the last cell.
+        void setActiveGrid(const osg::Vec4i& grid);
+
         void enableTerrain(bool enable);
 
         void updatePtr(const MWWorld::Ptr& old, const MWWorld::Ptr& updated);
@@ -196,6 +207,7 @@ namespace MWRender
         float getNearClipDistance() const;
 
         float getTerrainHeightAt(const osg::Vec3f& pos);
+        void getTerrainHeightsAt(const std::vector<osg::Vec3f>& pos, std::vector<float>& heights);
 
         // camera stuff
         bool vanityRotateCamera(const float *rot);
@@ -264,6 +276,7 @@ namespace MWRender
         std::unique_ptr<Pathgrid> mPathgrid;
         std::unique_ptr<Objects> mObjects;
         std::unique_ptr<Water> mWater;
+        std::unique_ptr<ObjectPaging> mObjectPaging;
         std::unique_ptr<Terrain::World> mTerrain;
         TerrainStorage* mTerrainStorage;
         std::unique_ptr<SkyManager> mSky;
@@ -53,7 +53,13 @@ namespace MWRender
         Mask_PreCompile = (1<<18),
 
         // Set on a camera's cull mask to enable the LightManager
-        Mask_Lighting = (1<<19)
+        Mask_Lighting = (1<<19),
+
+        // child of Scene, merged geometry of static objects, see Objects::batchCell
+        Mask_StaticBatch = (1<<20),
+
+        // replaces Mask_Static on objects drawn by a static batch, so they are still found by intersection tests but not rendered
+        Mask_BatchedObject = (1<<21)
     };
 
 }
@@ -931,16 +931,18 @@ namespace MWSound
 
                         float step = mNearWaterRadius * 2.0f / (mNearWaterPoints - 1);
 
+                        mNearWaterPositions.clear();
                         for (int x = 0; x < mNearWaterPoints; x++)
                         {
                             for (int y = 0; y < mNearWaterPoints; y++)
-                            {
-                                float height = world->getTerrainHeightAt(
-                                            osg::Vec3f(pos.x() - mNearWaterRadius + x*step, pos.y() - mNearWaterRadius + y*step, 0.0f));
+                                mNearWaterPositions.emplace_back(pos.x() - mNearWaterRadius + x*step, pos.y() - mNearWaterRadius + y*step, 0.0f);
+                        }
 
-                                if (height < 0)
-                                    underwaterPoints++;
-                            }
+                        world->getTerrainHeightsAt(mNearWaterPositions, mNearWaterHeights);
+                        for (float height : mNearWaterHeights)
+                        {
+                            if (height < 0)
+                                underwaterPoints++;
                         }
 
                         volume *= underwaterPoints * 2.0f / (mNearWaterPoints*mNearWaterPoints);
@@ -7,6 +7,9 @@
 #include <deque>
 #include <map>
 #include <unordered_map>
+#include <vector>
+
+#include <osg/Vec3f>
 
 #include <components/settings/settings.hpp>
 
@@ -61,6 +64,8 @@ namespace MWSound
 
         int mNearWaterRadius;
         int mNearWaterPoints;
+        std::vector<osg::Vec3f> mNearWaterPositions; // reused for querying the terrain heights around the player
+        std::vector<float> mNearWaterHeights;
         float mNearWaterIndoorTolerance;
         float mNearWaterOutdoorTolerance;
         std::string mNearWaterIndoorID;
@@ -11,6 +11,8 @@
 
 #include <components/settings/settings.hpp>
 
+#include <components/sceneutil/workqueue.hpp>
+
 #include <osg/Image>
 
 #include <osgDB/Registry>
@@ -40,6 +42,49 @@
 
 #include "quicksavemanager.hpp"
 
+namespace MWState
+{
+    /// Encodes a rendered screenshot to JPEG in the background, so the save path can keep going in the meantime.
+    class ScreenshotEncodeWorkItem : public SceneUtil::WorkItem
+    {
+    public:
+        ScreenshotEncodeWorkItem(osg::ref_ptr<osg::Image> image)
+            : mImage(image)
+        {
+        }
+
+        virtual void doWork()
+        {
+            osgDB::ReaderWriter* readerwriter = osgDB::Registry::instance()->getReaderWriterForExtension("jpg");
+            if (!readerwriter)
+            {
+                Log(Debug::Error) << "Error: Unable to write screenshot, can't find a jpg ReaderWriter";
+                return;
+            }
+
+            std::ostringstream ostream;
+            osgDB::ReaderWriter::WriteResult result = readerwriter->writeImage(*mImage, ostream);
+            if (!result.success())
+            {
+                Log(Debug::Error) << "Error: Unable to write screenshot: " << result.message() << " code " << result.status();
+                return;
+            }
+
+            std::string data = ostream.str();
+            mImageData.assign(data.begin(), data.end());
+            // The pixel data is no longer needed, release it on this thread rather than the main thread.
+            mImage = nullptr;
+        }
+
+        /// @note Only valid once waitTillDone() has returned.
+        std::vector<char>& getImageData() { return mImageData; }
+
+    private:
+        osg::ref_ptr<osg::Image> mImage;
+        std::vector<char> mImageData;
+    };
+}
+
 void MWState::StateManager::cleanup (bool force)
 {
     if (mState!=State_NoGame || force)
@@ -86,8 +131,9 @@ std::map<int, int> MWState::StateManager::buildContentFileIndexMap (const ESM::E
     return map;
 }
 
-MWState::StateManager::StateManager (const boost::filesystem::path& saves, const std::string& game)
+MWState::StateManager::StateManager (const boost::filesystem::path& saves, const std::string& game, SceneUtil::WorkQueue* workQueue)
 : mQuitRequest (false), mAskLoadRecent(false), mState (State_NoGame), mCharacterManager (saves, game), mTimePlayed (0)
+, mWorkQueue(workQueue)
 {
 
 }
@@ -220,12 +266,9 @@ void MWState::StateManager::saveGame (const std::string& description, const Slot
         profile.mTimePlayed = mTimePlayed;
         profile.mDescription = description;
 
-        writeScreenshot(profile.mScreenshot);
-
-        if (!slot)
-            slot = character->createSlot (profile);
-        else
-            slot = character->updateSlot (slot, profile);
+        // The screenshot is encoded in the background while the rest of the header is prepared,
+        // we only need the result once the profile record gets written.
+        osg::ref_ptr<ScreenshotEncodeWorkItem> screenshot = captureScreenshot();
 
         // Make sure the animation state held by references is up to date before saving the game.
         MWBase::Environment::get().getMechanicsManager()->persistAnimationStates();
@@ -271,6 +314,14 @@ void MWState::StateManager::saveGame (const std::string& description, const Slot
 
         Loading::ScopedLoad load(&listener);
 
+        screenshot->waitTillDone();
+        profile.mScreenshot.swap(screenshot->getImageData());
+
+        if (!slot)
+            slot = character->createSlot (profile);
+        else
+            slot = character->updateSlot (slot, profile);
+
         writer.startRecord (ESM::REC_SAVE);
         slot->mProfile.save (writer);
         writer.endRecord (ESM::REC_SAVE);
@@ -645,30 +696,17 @@ bool MWState::StateManager::verifyProfile(const ESM::SavedGame& profile) const
     return true;
 }
 
-void MWState::StateManager::writeScreenshot(std::vector<char> &imageData) const
+osg::ref_ptr<MWState::ScreenshotEncodeWorkItem> MWState::StateManager::captureScreenshot() const
 {
     int screenshotW = 259*2, screenshotH = 133*2; // *2 to get some nice antialiasing
 
     osg::ref_ptr<osg::Image> screenshot (new osg::Image);
 
+    // The readback has to happen on the main thread as it renders a frame, only the encoding is deferred.
     MWBase::Environment::get().getWorld()->screenshot(screenshot.get(), screenshotW, screenshotH);
 
-    osgDB::ReaderWriter* readerwriter = osgDB::Registry::instance()->getReaderWriterForExtension("jpg");
-    if (!readerwriter)
-    {
-        Log(Debug::Error) << "Error: Unable to write screenshot, can't find a jpg ReaderWriter";
-        return;
-    }
-
-    std::ostringstream ostream;
-    osgDB::ReaderWriter::WriteResult result = readerwriter->writeImage(*screenshot, ostream);
-    if (!result.success())
-    {
-        Log(Debug::Error) << "Error: Unable to write screenshot: " << result.message() << " code " << result.status();
-        return;
-    }
-
-    std::string data = ostream.str();
-    imageData = std::vector<char>(data.begin(), data.end());
-
+    osg::ref_ptr<ScreenshotEncodeWorkItem> item (new ScreenshotEncodeWorkItem(screenshot));
+    // Put it in front of any preloading work, the save is blocked on it.
+    mWorkQueue->addWorkItem(item, true);
+    return item;
 }
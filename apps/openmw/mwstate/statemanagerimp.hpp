@@ -7,10 +7,19 @@
 
 #include <boost/filesystem/path.hpp>
 
+#include <osg/ref_ptr>
+
 #include "charactermanager.hpp"
 
+namespace SceneUtil
+{
+    class WorkQueue;
+}
+
 namespace MWState
 {
+    class ScreenshotEncodeWorkItem;
+
     class StateManager : public MWBase::StateManager
     {
             bool mQuitRequest;
@@ -18,6 +27,7 @@ namespace MWState
             State mState;
             CharacterManager mCharacterManager;
             double mTimePlayed;
+            osg::ref_ptr<SceneUtil::WorkQueue> mWorkQueue;
 
         private:
 
@@ -25,13 +35,15 @@ namespace MWState
 
             bool verifyProfile (const ESM::SavedGame& profile) const;
 
-            void writeScreenshot (std::vector<char>& imageData) const;
+            osg::ref_ptr<ScreenshotEncodeWorkItem> captureScreenshot() const;
+            ///< Render the savegame screenshot and start encoding it on the work queue.
+            /// Call waitTillDone() on the returned item before accessing the encoded data.
 
             std::map<int, int> buildContentFileIndexMap (const ESM::ESMReader& reader) const;
 
         public:
 
-            StateManager (const boost::filesystem::path& saves, const std::string& game);
+            StateManager (const boost::filesystem::path& saves, const std::string& game, SceneUtil::WorkQueue* workQueue);
 
             virtual void requestQuit();
 
@@ -40,8 +40,10 @@ namespace MWWorld
         ~CellPreloader();
 
         /// Ask a background thread to preload rendering meshes and collision shapes for objects in this cell.
+        /// @param distance The distance of the cell from the player, see Resource::ImageManager::DistanceHint. 0 loads the
+        /// textures of its objects in full resolution right away.
         /// @note The cell itself must be in State_Loaded or State_Preloaded.
-        void preload(MWWorld::CellStore* cell, double timestamp);
+        void preload(MWWorld::CellStore* cell, float distance, double timestamp);
 
         void notifyLoaded(MWWorld::CellStore* cell);
 
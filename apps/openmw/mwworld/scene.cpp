@@ -1,7 +1,11 @@
 #include "scene.hpp"
 
+#include <algorithm>
+#include <cmath>
 #include <limits>
 
+#include <osg/Vec4i>
+
 #include <BulletCollision/CollisionDispatch/btCollisionObject.h>
 #include <BulletCollision/CollisionShapes/btCompoundShape.h>
 
@@ -595,6 +599,9 @@ namespace MWWorld
             }
         }
 
+        mRendering.setActiveGrid(osg::Vec4i(playerCellX - mHalfGridSize, playerCellY - mHalfGridSize,
+                                            playerCellX + mHalfGridSize + 1, playerCellY + mHalfGridSize + 1));
+
         CellStore* current = MWBase::Environment::get().getWorld()->getExterior(playerCellX, playerCellY);
         MWBase::Environment::get().getWindowManager()->changeCell(current);
 
@@ -659,6 +666,7 @@ namespace MWWorld
         mPhysics->setUnrefQueue(rendering.getUnrefQueue());
 
         rendering.getResourceSystem()->setExpiryDelay(Settings::Manager::getFloat("cache expiry delay", "Cells"));
+        rendering.getResourceSystem()->setMemoryBudget(static_cast<size_t>(std::max(0, Settings::Manager::getInt("cache memory budget", "Cells"))) * 1024 * 1024);
 
         mPreloader->setExpiryDelay(Settings::Manager::getFloat("preload cell expiry delay", "Cells"));
         mPreloader->setMinCacheSize(Settings::Manager::getInt("preload cell cache min", "Cells"));
@@ -926,14 +934,15 @@ namespace MWWorld
             {
                 try
                 {
+                    float distance = std::sqrt(sqrDistToPlayer);
                     if (!door.getCellRef().getDestCell().empty())
-                        preloadCell(MWBase::Environment::get().getWorld()->getInterior(door.getCellRef().getDestCell()));
+                        preloadCell(MWBase::Environment::get().getWorld()->getInterior(door.getCellRef().getDestCell()), distance);
                     else
                     {
                         osg::Vec3f pos = door.getCellRef().getDoorDest().asVec3();
                         int x,y;
                         MWBase::Environment::get().getWorld()->positionToIndex (pos.x(), pos.y(), x, y);
-                        preloadCell(MWBase::Environment::get().getWorld()->getExterior(x,y), true);
+                        preloadCell(MWBase::Environment::get().getWorld()->getExterior(x,y), distance, true);
                         exteriorPositions.push_back(pos);
                     }
                 }
@@ -974,12 +983,12 @@ namespace MWWorld
                 float loadDist = Constants::CellSizeInUnits / 2 + Constants::CellSizeInUnits - mCellLoadingThreshold + mPreloadDistance;
 
                 if (dist < loadDist)
-                    preloadCell(MWBase::Environment::get().getWorld()->getExterior(cellX+dx, cellY+dy));
+                    preloadCell(MWBase::Environment::get().getWorld()->getExterior(cellX+dx, cellY+dy), dist);
             }
         }
     }
 
-    void Scene::preloadCell(CellStore *cell, bool preloadSurrounding)
+    void Scene::preloadCell(CellStore *cell, float distance, bool preloadSurrounding)
     {
         if (preloadSurrounding && cell->isExterior())
         {
@@ -990,14 +999,15 @@ namespace MWWorld
             {
                 for (int dy = -mHalfGridSize; dy <= mHalfGridSize; ++dy)
                 {
-                    mPreloader->preload(MWBase::Environment::get().getWorld()->getExterior(x+dx, y+dy), mRendering.getReferenceTime());
+                    float cellDistance = distance + std::max(std::abs(dx), std::abs(dy)) * Constants::CellSizeInUnits;
+                    mPreloader->preload(MWBase::Environment::get().getWorld()->getExterior(x+dx, y+dy), cellDistance, mRendering.getReferenceTime());
                     if (++numpreloaded >= mPreloader->getMaxCacheSize())
                         break;
                 }
             }
         }
         else
-            mPreloader->preload(cell, mRendering.getReferenceTime());
+            mPreloader->preload(cell, distance, mRendering.getReferenceTime());
     }
 
     void Scene::preloadTerrain(const osg::Vec3f &pos)
@@ -1050,14 +1060,15 @@ namespace MWWorld
 
         for (ESM::Transport::Dest& dest : listVisitor.mList)
         {
+            // the player has to talk to the service first, so these are only needed after the nearby cells
             if (!dest.mCellName.empty())
-                preloadCell(MWBase::Environment::get().getWorld()->getInterior(dest.mCellName));
+                preloadCell(MWBase::Environment::get().getWorld()->getInterior(dest.mCellName), mPreloadDistance);
             else
             {
                 osg::Vec3f pos = dest.mPos.asVec3();
                 int x,y;
                 MWBase::Environment::get().getWorld()->positionToIndex( pos.x(), pos.y(), x, y);
-                preloadCell(MWBase::Environment::get().getWorld()->getExterior(x,y), true);
+                preloadCell(MWBase::Environment::get().getWorld()->getExterior(x,y), mPreloadDistance, true);
                 exteriorPositions.push_back(pos);
             }
         }
@@ -98,7 +98,8 @@ namespace MWWorld
 
             ~Scene();
 
-            void preloadCell(MWWorld::CellStore* cell, bool preloadSurrounding=false);
+            /// @param distance The distance of the cell from the player, see CellPreloader::preload.
+            void preloadCell(MWWorld::CellStore* cell, float distance, bool preloadSurrounding=false);
             void preloadTerrain(const osg::Vec3f& pos);
 
             void unloadCell (CellStoreCollection::iterator iter);
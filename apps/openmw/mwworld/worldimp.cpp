@@ -6,6 +6,8 @@
 #include <BulletCollision/CollisionDispatch/btCollisionWorld.h>
 #include <BulletCollision/CollisionShapes/btCompoundShape.h>
 
+#include <boost/filesystem/path.hpp>
+
 #include <components/debug/debuglog.hpp>
 
 #include <components/esm/esmreader.hpp>
@@ -19,7 +21,9 @@
 #include <components/files/collections.hpp>
 
 #include <components/resource/bulletshape.hpp>
+#include <components/resource/bulletshapemanager.hpp>
 #include <components/resource/resourcesystem.hpp>
+#include <components/resource/scenemanager.hpp>
 
 #include <components/sceneutil/positionattitudetransform.hpp>
 
@@ -158,7 +162,7 @@ namespace MWWorld
         const std::vector<std::string>& contentFiles,
         ToUTF8::Utf8Encoder* encoder, int activationDistanceOverride,
         const std::string& startCell, const std::string& startupScript,
-        const std::string& resourcePath, const std::string& userDataPath)
+        const std::string& resourcePath, const std::string& userDataPath, const std::string& cachePath)
     : mResourceSystem(resourceSystem), mLocalScripts (mStore),
       mSky (true), mCells (mStore, mEsm),
       mGodMode(false), mScriptsEnabled(true), mContentFiles (contentFiles), mUserDataPath(userDataPath),
@@ -196,6 +200,8 @@ namespace MWWorld
         mSwimHeightScale = mStore.get<ESM::GameSetting>().find("fSwimHeightScale")->mValue.getFloat();
 
         mPhysics.reset(new MWPhysics::PhysicsSystem(resourceSystem, rootNode));
+        if (Settings::Manager::getBool("collision disk cache", "Cells"))
+            mPhysics->getShapeManager()->setDiskCachePath((boost::filesystem::path(cachePath) / "collision").string());
 
         if (auto navigatorSettings = DetourNavigator::makeSettingsFromSettingsManager())
         {
@@ -210,7 +216,7 @@ namespace MWWorld
             mNavigator.reset(new DetourNavigator::NavigatorStub());
         }
 
-        mRendering.reset(new MWRender::RenderingManager(viewer, rootNode, resourceSystem, workQueue, resourcePath, *mNavigator));
+        mRendering.reset(new MWRender::RenderingManager(viewer, rootNode, resourceSystem, workQueue, resourcePath, cachePath, *mNavigator, encoder));
         mProjectileManager.reset(new ProjectileManager(mRendering->getLightRoot(), resourceSystem, mRendering.get(), mPhysics.get()));
         mRendering->preloadCommonAssets();
 
@@ -402,7 +408,7 @@ namespace MWWorld
                 mPlayer->readRecord(reader, type);
                 if (getPlayerPtr().isInCell())
                 {
-                    mWorldScene->preloadCell(getPlayerPtr().getCell(), true);
+                    mWorldScene->preloadCell(getPlayerPtr().getCell(), 0.f, true);
                     if (getPlayerPtr().getCell()->isExterior())
                         mWorldScene->preloadTerrain(getPlayerPtr().getRefData().getPosition().asVec3());
                 }
@@ -3548,6 +3554,11 @@ namespace MWWorld
         return mRendering->getTerrainHeightAt(worldPos);
     }
 
+    void World::getTerrainHeightsAt(const std::vector<osg::Vec3f>& worldPos, std::vector<float>& heights) const
+    {
+        mRendering->getTerrainHeightsAt(worldPos, heights);
+    }
+
     osg::Vec3f World::getHalfExtents(const ConstPtr& object, bool rendering) const
     {
         if (!object.getClass().isActor())
@@ -3771,10 +3782,23 @@ namespace MWWorld
 
     void World::preloadEffects(const ESM::EffectList *effectList)
     {
+        // the visual effects of the spells the player has readied are likely to be spawned repeatedly
+        int poolSize = Settings::Manager::getInt("effect instance pool size", "Cells");
+
         for (const ESM::ENAMstruct& effectInfo : effectList->mList)
         {
             const ESM::MagicEffect *effect = mStore.get<ESM::MagicEffect>().find(effectInfo.mEffectID);
 
+            if (poolSize > 0)
+            {
+                for (const std::string* vfx : { &effect->mCasting, &effect->mHit, &effect->mArea })
+                {
+                    const ESM::Static* vfxStatic = mStore.get<ESM::Static>().search(*vfx);
+                    if (vfxStatic && !vfxStatic->mModel.empty())
+                        poolEffectModel("meshes\\" + vfxStatic->mModel, poolSize);
+                }
+            }
+
             if (MWMechanics::isSummoningEffect(effectInfo.mEffectID))
             {
                 preload(mWorldScene.get(), mStore, "VFX_Summon_Start");
@@ -3791,6 +3815,23 @@ namespace MWWorld
         }
     }
 
+    void World::poolEffectModel(const std::string& model, int poolSize)
+    {
+        // every pool keeps its instances alive for the rest of the session, so only the effects of the last few
+        // readied spells are pooled
+        const std::size_t maxPooledEffectModels = 16;
+
+        mPooledEffectModels.remove(model);
+        mPooledEffectModels.push_front(model);
+        mResourceSystem->getSceneManager()->setInstancePoolSize(model, poolSize);
+
+        while (mPooledEffectModels.size() > maxPooledEffectModels)
+        {
+            mResourceSystem->getSceneManager()->setInstancePoolSize(mPooledEffectModels.back(), 0);
+            mPooledEffectModels.pop_back();
+        }
+    }
+
     DetourNavigator::Navigator* World::getNavigator() const
     {
         return mNavigator.get();
@@ -1,6 +1,8 @@
 #ifndef GAME_MWWORLD_WORLDIMP_H
 #define GAME_MWWORLD_WORLDIMP_H
 
+#include <list>
+
 #include <osg/ref_ptr>
 
 #include <components/settings/settings.hpp>
@@ -123,6 +125,9 @@ namespace MWWorld
 
             std::string mStartCell;
 
+            std::list<std::string> mPooledEffectModels;
+            ///< models of readied spell effects that have an instance pool, most recently readied first
+
             void updateWeather(float duration, bool paused = false);
             int getDaysPerMonth (int month) const;
 
@@ -138,6 +143,9 @@ namespace MWWorld
 
             void preloadSpells();
 
+            void poolEffectModel(const std::string& model, int poolSize);
+            ///< Create an instance pool for \a model and drop the pools of the least recently readied effects.
+
             MWWorld::Ptr getFacedObject(float maxDistance, bool ignorePlayer=true);
 
     public: // FIXME
@@ -198,7 +206,7 @@ namespace MWWorld
                 const std::vector<std::string>& contentFiles,
                 ToUTF8::Utf8Encoder* encoder, int activationDistanceOverride,
                 const std::string& startCell, const std::string& startupScript,
-                const std::string& resourcePath, const std::string& userDataPath);
+                const std::string& resourcePath, const std::string& userDataPath, const std::string& cachePath);
 
             virtual ~World();
 
@@ -698,6 +706,9 @@ namespace MWWorld
             /// Return terrain height at \a worldPos position.
             float getTerrainHeightAt(const osg::Vec3f& worldPos) const override;
 
+            /// Return terrain heights at many positions, faster than querying them one by one.
+            void getTerrainHeightsAt(const std::vector<osg::Vec3f>& worldPos, std::vector<float>& heights) const override;
+
             /// Return physical or rendering half extents of the given actor.
             osg::Vec3f getHalfExtents(const MWWorld::ConstPtr& actor, bool rendering=false) const override;
 
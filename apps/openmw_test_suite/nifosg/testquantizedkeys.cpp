@@ -0,0 +1,129 @@
+#include <components/nifosg/quantizedkeys.hpp>
+
+#include <gtest/gtest.h>
+
+#include <cmath>
+
+namespace
+{
+    using namespace testing;
+    using namespace NifOsg;
+
+    // half of a 15 bit step of the small components in [-1/sqrt(2), 1/sqrt(2)], with some room for float rounding
+    const double sMaxQuatComponentError = 0.5 * 2 * 0.70710678 / 32767 + 1e-6;
+    // the dropped component is at least 1/2 and recovered from the other three, so it gets up to three times their error
+    const double sMaxDroppedQuatComponentError = 3 * sMaxQuatComponentError;
+
+    osg::Quat normalized(const osg::Quat& quat)
+    {
+        return quat / quat.length();
+    }
+
+    int getDroppedComponent(const QuantizedQuaternionKeyMap& keys, size_t index)
+    {
+        const std::uint16_t* packed = &keys.mValues[index * 3];
+        return (packed[0] >> 15) | ((packed[1] >> 14) & 0x2);
+    }
+
+    struct NifOsgQuantizedQuaternionKeyMapTest : Test
+    {
+        QuantizedQuaternionKeyMap mKeys;
+    };
+
+    TEST_F(NifOsgQuantizedQuaternionKeyMapTest, round_trip_should_be_within_half_a_step)
+    {
+        const osg::Quat quats[] = {
+            osg::Quat(0, 0, 0, 1),
+            osg::Quat(0.5, 0.5, 0.5, 0.5),
+            normalized(osg::Quat(0.1, 0.2, 0.3, 0.9)),
+            normalized(osg::Quat(0.7, 0.01, -0.7, 0.1)),
+            osg::Quat(1.2, osg::Vec3f(0.3f, -0.8f, 0.5f)),
+        };
+        for (const osg::Quat& quat : quats)
+            mKeys.addKey(0.f, quat);
+
+        ASSERT_EQ(mKeys.size(), sizeof(quats) / sizeof(quats[0]));
+        for (size_t i = 0; i < mKeys.size(); ++i)
+        {
+            const osg::Quat value = mKeys.getValue(i);
+            // q and -q are the same rotation
+            const double sign = value.asVec4() * quats[i].asVec4() < 0 ? -1 : 1;
+            const int dropped = getDroppedComponent(mKeys, i);
+            for (int j = 0; j < 4; ++j)
+                EXPECT_NEAR(value[j], sign * quats[i][j], j == dropped ? sMaxDroppedQuatComponentError : sMaxQuatComponentError)
+                    << "key " << i << " component " << j;
+        }
+    }
+
+    TEST_F(NifOsgQuantizedQuaternionKeyMapTest, should_drop_largest_component)
+    {
+        for (int largest = 0; largest < 4; ++largest)
+        {
+            osg::Quat quat(0.2, -0.3, 0.1, 0.25);
+            quat[largest] = 0.8;
+            mKeys.addKey(0.f, normalized(quat));
+            EXPECT_EQ(getDroppedComponent(mKeys, mKeys.size() - 1), largest);
+        }
+    }
+
+    TEST_F(NifOsgQuantizedQuaternionKeyMapTest, should_drop_largest_component_by_magnitude)
+    {
+        mKeys.addKey(0.f, normalized(osg::Quat(0.4, -0.8, 0.3, 0.2)));
+        EXPECT_EQ(getDroppedComponent(mKeys, 0), 1);
+    }
+
+    TEST_F(NifOsgQuantizedQuaternionKeyMapTest, negative_largest_component_should_decode_as_negated_quaternion)
+    {
+        const osg::Quat quat = normalized(osg::Quat(0.1, 0.2, -0.9, 0.3));
+        mKeys.addKey(0.f, quat);
+        const osg::Quat value = mKeys.getValue(0);
+        EXPECT_GT(value[2], 0);
+        for (int j = 0; j < 4; ++j)
+            EXPECT_NEAR(value[j], -quat[j], sMaxDroppedQuatComponentError) << "component " << j;
+    }
+
+    TEST_F(NifOsgQuantizedQuaternionKeyMapTest, should_normalize_input)
+    {
+        const osg::Quat quat = normalized(osg::Quat(0.1, 0.2, 0.3, 0.9));
+        mKeys.addKey(0.f, quat * 3);
+        const osg::Quat value = mKeys.getValue(0);
+        for (int j = 0; j < 4; ++j)
+            EXPECT_NEAR(value[j], quat[j], sMaxDroppedQuatComponentError) << "component " << j;
+    }
+
+    TEST(NifOsgQuantizedVec3KeyMapTest, round_trip_should_be_within_half_a_step_of_track_range)
+    {
+        const std::vector<float> times {0.f, 1.f, 2.f, 3.f};
+        const std::vector<osg::Vec3f> values {
+            osg::Vec3f(-100.f, 0.f, 5.f),
+            osg::Vec3f(37.3f, 0.001f, 5.f),
+            osg::Vec3f(250.f, -0.002f, 5.f),
+            osg::Vec3f(12.345f, 0.f, 5.f),
+        };
+        QuantizedVec3KeyMap keys;
+        keys.assign(times, values);
+
+        ASSERT_EQ(keys.size(), values.size());
+        EXPECT_EQ(keys.mTimes, times);
+        const osg::Vec3f range(350.f, 0.003f, 0.f);
+        for (size_t i = 0; i < keys.size(); ++i)
+        {
+            const osg::Vec3f value = keys.getValue(i);
+            for (int j = 0; j < 3; ++j)
+                EXPECT_NEAR(value[j], values[i][j], 0.5f * range[j] / 65535.f + 1e-5f * std::abs(values[i][j]))
+                    << "key " << i << " component " << j;
+        }
+    }
+
+    TEST(NifOsgQuantizedVec3KeyMapTest, range_bounds_should_be_exact)
+    {
+        const std::vector<osg::Vec3f> values {osg::Vec3f(-1.f, 2.f, 3.f), osg::Vec3f(4.f, -5.f, 6.f)};
+        QuantizedVec3KeyMap keys;
+        keys.assign({0.f, 1.f}, values);
+
+        EXPECT_EQ(keys.getValue(0).x(), -1.f);
+        EXPECT_EQ(keys.getValue(1).y(), -5.f);
+        EXPECT_FLOAT_EQ(keys.getValue(1).x(), 4.f);
+        EXPECT_FLOAT_EQ(keys.getValue(0).y(), 2.f);
+    }
+}
@@ -0,0 +1,220 @@
+#include <components/resource/objectcache.hpp>
+
+#include <osg/Node>
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <map>
+#include <utility>
+
+namespace
+{
+    using namespace testing;
+    using namespace Resource;
+
+    template <typename KeyType>
+    class TestObjectCache : public GenericObjectCache<KeyType>
+    {
+    public:
+        typedef GenericObjectCache<KeyType> Base;
+
+        static const unsigned int sNumShards = Base::sNumShards;
+
+        unsigned int getShardIndex(const KeyType& key)
+        {
+            return static_cast<unsigned int>(&this->getShard(key) - this->_shards);
+        }
+
+        std::size_t getShardMemoryUsage(const KeyType& key)
+        {
+            return this->getShard(key)._size;
+        }
+
+    protected:
+        virtual ~TestObjectCache() {}
+    };
+
+    struct ResourceObjectCacheTest : Test
+    {
+        const std::size_t mObjectSize = 10;
+        const std::size_t mShardBudget = 3 * mObjectSize;
+        osg::ref_ptr<TestObjectCache<int> > mCache {new TestObjectCache<int>};
+
+        /// @return Keys that are all stored in the same shard as the first one.
+        std::vector<int> getKeysInSameShard(unsigned int count)
+        {
+            std::vector<int> keys;
+            const unsigned int shard = mCache->getShardIndex(0);
+            for (int key = 0; keys.size() < count; ++key)
+                if (mCache->getShardIndex(key) == shard)
+                    keys.push_back(key);
+            return keys;
+        }
+
+        /// @return One key stored in each shard.
+        std::vector<int> getKeyPerShard()
+        {
+            std::map<unsigned int, int> keys;
+            for (int key = 0; keys.size() < TestObjectCache<int>::sNumShards; ++key)
+                keys.emplace(mCache->getShardIndex(key), key);
+            std::vector<int> result;
+            for (const auto& key : keys)
+                result.push_back(key.second);
+            return result;
+        }
+
+        void add(int key)
+        {
+            mCache->addEntryToObjectCache(key, new osg::Node, 0.0, mObjectSize);
+        }
+
+        bool contains(int key)
+        {
+            return mCache->checkInObjectCache(key, 0.0);
+        }
+    };
+
+    TEST_F(ResourceObjectCacheTest, exceeding_budget_should_remove_least_recently_used_object)
+    {
+        mCache->setMemoryBudget(mShardBudget * TestObjectCache<int>::sNumShards);
+        const std::vector<int> keys = getKeysInSameShard(5);
+        add(keys[0]);
+        add(keys[1]);
+        add(keys[2]);
+        // use the oldest object, so that the second one becomes the least recently used
+        EXPECT_TRUE(mCache->getRefFromObjectCache(keys[0]));
+
+        add(keys[3]);
+        EXPECT_FALSE(contains(keys[1]));
+        EXPECT_EQ(mCache->getCacheSize(), 3u);
+
+        add(keys[4]);
+        EXPECT_FALSE(contains(keys[2]));
+        EXPECT_TRUE(contains(keys[0]));
+        EXPECT_TRUE(contains(keys[3]));
+        EXPECT_TRUE(contains(keys[4]));
+    }
+
+    TEST_F(ResourceObjectCacheTest, exceeding_budget_should_keep_objects_with_external_references)
+    {
+        mCache->setMemoryBudget(mShardBudget * TestObjectCache<int>::sNumShards);
+        const std::vector<int> keys = getKeysInSameShard(4);
+        add(keys[0]);
+        osg::ref_ptr<osg::Object> used = mCache->getRefFromObjectCache(keys[0]);
+        add(keys[1]);
+        add(keys[2]);
+        // the oldest object is still in use, so this one is the least recently used that can go
+        EXPECT_TRUE(mCache->getRefFromObjectCache(keys[1]));
+        add(keys[3]);
+
+        EXPECT_TRUE(contains(keys[0]));
+        EXPECT_FALSE(contains(keys[2]));
+        EXPECT_EQ(mCache->getMemoryUsage(), 3 * mObjectSize);
+    }
+
+    TEST_F(ResourceObjectCacheTest, budget_should_apply_to_each_shard_separately)
+    {
+        mCache->setMemoryBudget(mShardBudget * TestObjectCache<int>::sNumShards);
+        const std::vector<int> keys = getKeyPerShard();
+        for (int key : keys)
+            add(key);
+        const std::vector<int> sameShard = getKeysInSameShard(4);
+        for (unsigned int i = 1; i < sameShard.size(); ++i)
+            add(sameShard[i]);
+
+        // the shard is over its part of the budget, even though the cache as a whole is not
+        EXPECT_FALSE(contains(sameShard[0]));
+        EXPECT_EQ(mCache->getShardMemoryUsage(sameShard[0]), mShardBudget);
+        EXPECT_EQ(mCache->getMemoryUsage(), (TestObjectCache<int>::sNumShards - 1) * mObjectSize + mShardBudget);
+        for (int key : keys)
+        {
+            if (key == sameShard[0])
+                continue;
+            EXPECT_TRUE(contains(key)) << "key " << key;
+        }
+    }
+
+    TEST_F(ResourceObjectCacheTest, memory_usage_should_follow_added_replaced_and_removed_objects)
+    {
+        const std::vector<int> keys = getKeysInSameShard(2);
+        add(keys[0]);
+        add(keys[1]);
+        EXPECT_EQ(mCache->getShardMemoryUsage(keys[0]), 2 * mObjectSize);
+        EXPECT_EQ(mCache->getMemoryUsage(), 2 * mObjectSize);
+
+        mCache->addEntryToObjectCache(keys[0], new osg::Node, 0.0, 3 * mObjectSize);
+        EXPECT_EQ(mCache->getShardMemoryUsage(keys[0]), 4 * mObjectSize);
+
+        mCache->removeFromObjectCache(keys[1]);
+        EXPECT_EQ(mCache->getMemoryUsage(), 3 * mObjectSize);
+
+        mCache->removeExpiredObjectsInCache(1.0);
+        EXPECT_EQ(mCache->getMemoryUsage(), 0u);
+        EXPECT_EQ(mCache->getCacheSize(), 0u);
+    }
+
+    TEST_F(ResourceObjectCacheTest, without_budget_should_keep_all_objects)
+    {
+        const std::vector<int> keys = getKeysInSameShard(10);
+        for (int key : keys)
+            add(key);
+        EXPECT_EQ(mCache->getCacheSize(), keys.size());
+        EXPECT_EQ(mCache->getMemoryUsage(), keys.size() * mObjectSize);
+    }
+
+    TEST_F(ResourceObjectCacheTest, eviction_candidates_should_be_least_recently_used_objects_of_each_shard)
+    {
+        const std::vector<int> keys = getKeysInSameShard(4);
+        for (int key : keys)
+            add(key);
+        EXPECT_TRUE(mCache->getRefFromObjectCache(keys[0]));
+
+        std::vector<EvictionCandidate> candidates;
+        mCache->getEvictionCandidates(2 * mObjectSize, candidates);
+        ASSERT_EQ(candidates.size(), 2u);
+        EXPECT_LT(candidates[0].first, candidates[1].first);
+
+        EXPECT_EQ(mCache->removeLeastRecentlyUsed(candidates[1].first), 2 * mObjectSize);
+        EXPECT_TRUE(contains(keys[0]));
+        EXPECT_FALSE(contains(keys[1]));
+        EXPECT_FALSE(contains(keys[2]));
+        EXPECT_TRUE(contains(keys[3]));
+    }
+
+    TEST(ResourceObjectCacheShardTest, pair_keys_should_spread_over_all_shards)
+    {
+        osg::ref_ptr<TestObjectCache<std::pair<int, int> > > cache(new TestObjectCache<std::pair<int, int> >);
+        const unsigned int numShards = TestObjectCache<std::pair<int, int> >::sNumShards;
+        std::vector<unsigned int> counts(numShards, 0);
+        // a grid of cells around the origin, as used for the keys of land and cell data
+        const int halfSize = 16;
+        for (int x = -halfSize; x < halfSize; ++x)
+            for (int y = -halfSize; y < halfSize; ++y)
+                ++counts[cache->getShardIndex(std::make_pair(x, y))];
+
+        const unsigned int expected = 4 * halfSize * halfSize / numShards;
+        for (unsigned int i = 0; i < numShards; ++i)
+        {
+            EXPECT_GT(counts[i], expected / 2) << "shard " << i;
+            EXPECT_LT(counts[i], expected * 3 / 2) << "shard " << i;
+        }
+    }
+
+    TEST(ResourceObjectCacheShardTest, consecutive_int_keys_should_spread_over_all_shards)
+    {
+        osg::ref_ptr<TestObjectCache<int> > cache(new TestObjectCache<int>);
+        const unsigned int numShards = TestObjectCache<int>::sNumShards;
+        std::vector<unsigned int> counts(numShards, 0);
+        const int numKeys = 1024;
+        for (int key = 0; key < numKeys; ++key)
+            ++counts[cache->getShardIndex(key)];
+
+        const unsigned int expected = numKeys / numShards;
+        for (unsigned int i = 0; i < numShards; ++i)
+        {
+            EXPECT_GT(counts[i], expected / 2) << "shard " << i;
+            EXPECT_LT(counts[i], expected * 3 / 2) << "shard " << i;
+        }
+    }
+}
@@ -0,0 +1,168 @@
+#include <components/terrain/quadtreenode.hpp>
+#include <components/terrain/viewdata.hpp>
+
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <set>
+
+namespace
+{
+    using namespace testing;
+    using namespace Terrain;
+
+    const float sCellSize = 100.f;
+    const float sRootSize = 16.f;
+    const float sMinSize = 0.5f;
+    const float sMaxDist = 1000.f;
+
+    /// Refines nodes until they are smaller than their distance, in the manner of the default LOD callback of QuadTreeWorld.
+    class TestLodCallback : public LodCallback
+    {
+    public:
+        TestLodCallback() : mNumCalls(0) {}
+
+        virtual bool isSufficientDetail(QuadTreeNode* node, float dist)
+        {
+            ++mNumCalls;
+            return dist >= getThreshold(node);
+        }
+
+        virtual float getDetailMargin(QuadTreeNode* node, float dist)
+        {
+            return std::abs(dist - getThreshold(node));
+        }
+
+        unsigned int mNumCalls;
+
+    private:
+        static float getThreshold(QuadTreeNode* node)
+        {
+            return node->getSize() * sCellSize;
+        }
+    };
+
+    void buildTree(QuadTreeNode* node)
+    {
+        const float size = node->getSize();
+        const osg::Vec2f& center = node->getCenter();
+        // give the terrain some height that varies between the nodes
+        const float height = std::abs(std::sin(center.x() * 0.7f + center.y() * 0.3f)) * 200.f + size * 10.f;
+        const osg::Vec3f min((center.x() - size/2.f) * sCellSize, (center.y() - size/2.f) * sCellSize, 0.f);
+        const osg::Vec3f max((center.x() + size/2.f) * sCellSize, (center.y() + size/2.f) * sCellSize, height);
+        node->setBoundingBox(osg::BoundingBox(min, max));
+        if (size <= sMinSize)
+            return;
+
+        const float childSize = size / 2.f;
+        const float offset = childSize / 2.f;
+        node->addChildNode(new QuadTreeNode(node, NW, childSize, center + osg::Vec2f(-offset, offset)));
+        node->addChildNode(new QuadTreeNode(node, NE, childSize, center + osg::Vec2f(offset, offset)));
+        node->addChildNode(new QuadTreeNode(node, SW, childSize, center + osg::Vec2f(-offset, -offset)));
+        node->addChildNode(new QuadTreeNode(node, SE, childSize, center + osg::Vec2f(offset, -offset)));
+        for (unsigned int i=0; i<node->getNumChildren(); ++i)
+            buildTree(node->getChild(i));
+    }
+
+    std::multiset<QuadTreeNode*> getNodes(ViewData& vd)
+    {
+        std::multiset<QuadTreeNode*> nodes;
+        for (unsigned int i=0; i<vd.getNumEntries(); ++i)
+            nodes.insert(vd.getEntry(i).mNode);
+        return nodes;
+    }
+
+    struct TerrainQuadTreeNodeTest : Test
+    {
+        osg::ref_ptr<QuadTreeNode> mRootNode {new QuadTreeNode(nullptr, Root, sRootSize, osg::Vec2f(0.f, 0.f))};
+        osg::ref_ptr<TestLodCallback> mLodCallback {new TestLodCallback};
+
+        TerrainQuadTreeNodeTest()
+        {
+            buildTree(mRootNode.get());
+            mRootNode->initNeighbours();
+        }
+
+        unsigned int traverse(ViewData& vd, const osg::Vec3f& viewPoint)
+        {
+            mLodCallback->mNumCalls = 0;
+            vd.reset();
+            mRootNode->traverse(&vd, viewPoint, mLodCallback.get(), sMaxDist);
+            return mLodCallback->mNumCalls;
+        }
+
+        /// Move the view point in steps of the given length and check that each incremental traversal selects the same
+        /// nodes as a traversal from scratch. @return How many times the incremental traversals had to check a node.
+        unsigned int walk(ViewData& vd, osg::Vec3f& viewPoint, const osg::Vec3f& step, unsigned int numSteps)
+        {
+            unsigned int numCalls = 0;
+            for (unsigned int i=0; i<numSteps; ++i)
+            {
+                viewPoint += step;
+                numCalls += traverse(vd, viewPoint);
+                vd.markUnchanged();
+
+                ViewData fresh;
+                traverse(fresh, viewPoint);
+
+                EXPECT_EQ(getNodes(vd), getNodes(fresh)) << "at step " << i << " of length " << step.length();
+                EXPECT_EQ(vd.getNumEntries(), getNodes(vd).size());
+                for (unsigned int j=0; j<vd.getNumEntries(); ++j)
+                    EXPECT_TRUE(vd.contains(vd.getEntry(j).mNode));
+            }
+            return numCalls;
+        }
+    };
+
+    TEST_F(TerrainQuadTreeNodeTest, traverse_should_select_nodes_within_view_distance)
+    {
+        ViewData vd;
+        traverse(vd, osg::Vec3f(0.f, 0.f, 100.f));
+        ASSERT_GT(vd.getNumEntries(), 0u);
+        for (unsigned int i=0; i<vd.getNumEntries(); ++i)
+            EXPECT_LE(vd.getEntry(i).mNode->distance(osg::Vec3f(0.f, 0.f, 100.f)), sMaxDist);
+    }
+
+    TEST_F(TerrainQuadTreeNodeTest, movement_smaller_than_margins_should_reuse_previous_traversal)
+    {
+        ViewData vd;
+        osg::Vec3f viewPoint(10.f, 20.f, 150.f);
+        const unsigned int numCallsFromScratch = traverse(vd, viewPoint);
+        vd.markUnchanged();
+
+        const unsigned int numSteps = 20;
+        const unsigned int numCalls = walk(vd, viewPoint, osg::Vec3f(0.3f, 0.2f, 0.f), numSteps);
+        EXPECT_LT(numCalls, numCallsFromScratch * numSteps);
+    }
+
+    TEST_F(TerrainQuadTreeNodeTest, movement_larger_than_margins_should_match_traversal_from_scratch)
+    {
+        ViewData vd;
+        osg::Vec3f viewPoint(-700.f, -600.f, 150.f);
+        traverse(vd, viewPoint);
+        vd.markUnchanged();
+
+        walk(vd, viewPoint, osg::Vec3f(5.f, 3.f, 0.f), 20);
+        walk(vd, viewPoint, osg::Vec3f(37.f, 41.f, -2.f), 20);
+        walk(vd, viewPoint, osg::Vec3f(160.f, 90.f, 10.f), 10);
+        walk(vd, viewPoint, osg::Vec3f(-450.f, 20.f, 0.f), 5);
+        walk(vd, viewPoint, osg::Vec3f(0.f, 0.f, 400.f), 3);
+        walk(vd, viewPoint, osg::Vec3f(1.f, -1.f, -1.f), 20);
+    }
+
+    TEST_F(TerrainQuadTreeNodeTest, changed_view_distance_should_not_reuse_previous_traversal)
+    {
+        ViewData vd;
+        const osg::Vec3f viewPoint(10.f, 20.f, 150.f);
+        traverse(vd, viewPoint);
+        vd.markUnchanged();
+
+        vd.reset();
+        mRootNode->traverse(&vd, viewPoint, mLodCallback.get(), sMaxDist / 2.f);
+
+        ViewData fresh;
+        fresh.reset();
+        mRootNode->traverse(&fresh, viewPoint, mLodCallback.get(), sMaxDist / 2.f);
+        EXPECT_EQ(getNodes(vd), getNodes(fresh));
+    }
+}
@@ -5,12 +5,12 @@
 #include <OpenThreads/ScopedLock>
 
 #include <osg/Image>
-#include <osg/Plane>
 
 #include <boost/algorithm/string.hpp>
 
 #include <components/debug/debuglog.hpp>
 #include <components/misc/resourcehelpers.hpp>
+#include <components/resource/diskcache.hpp>
 #include <components/vfs/manager.hpp>
 
 namespace ESMTerrain
@@ -48,6 +48,8 @@ namespace ESMTerrain
 
     const float defaultHeight = ESM::Land::DEFAULT_HEIGHT;
 
+    const size_t maxHeightCacheSize = 16;
+
     Storage::Storage(const VFS::Manager *vfs, const std::string& normalMapPattern, const std::string& normalHeightMapPattern, bool autoUseNormalMaps, const std::string& specularMapPattern, bool autoUseSpecularMaps)
         : mVFS(vfs)
         , mNormalMapPattern(normalMapPattern)
@@ -55,6 +57,7 @@ namespace ESMTerrain
         , mAutoUseNormalMaps(autoUseNormalMaps)
         , mSpecularMapPattern(specularMapPattern)
         , mAutoUseSpecularMaps(autoUseSpecularMaps)
+        , mHeightCacheCounter(0)
     {
     }
 
@@ -442,83 +445,125 @@ namespace ESMTerrain
         int cellX = static_cast<int>(std::floor(worldPos.x() / float(Constants::CellSizeInUnits)));
         int cellY = static_cast<int>(std::floor(worldPos.y() / float(Constants::CellSizeInUnits)));
 
+        osg::ref_ptr<const LandObject> land = getHeightLand(cellX, cellY);
+        return interpolateHeight(land ? land->getData(ESM::Land::DATA_VHGT) : nullptr, cellX, cellY, worldPos);
+    }
+
+    void Storage::getHeightsAt(const std::vector<osg::Vec3f> &worldPos, std::vector<float> &heights)
+    {
+        heights.resize(worldPos.size());
+
+        // neighbouring positions are usually in the same cell, so only look up the land when the cell changes
+        osg::ref_ptr<const LandObject> land;
+        const ESM::Land::LandData* data = nullptr;
+        int lastCellX = 0;
+        int lastCellY = 0;
+        for (size_t i=0; i<worldPos.size(); ++i)
+        {
+            int cellX = static_cast<int>(std::floor(worldPos[i].x() / float(Constants::CellSizeInUnits)));
+            int cellY = static_cast<int>(std::floor(worldPos[i].y() / float(Constants::CellSizeInUnits)));
+            if (i == 0 || cellX != lastCellX || cellY != lastCellY)
+            {
+                land = getHeightLand(cellX, cellY);
+                data = land ? land->getData(ESM::Land::DATA_VHGT) : nullptr;
+                lastCellX = cellX;
+                lastCellY = cellY;
+            }
+            heights[i] = interpolateHeight(data, cellX, cellY, worldPos[i]);
+        }
+    }
+
+    void Storage::clearHeightCache()
+    {
+        OpenThreads::ScopedLock<OpenThreads::Mutex> lock(mHeightCacheMutex);
+        mHeightCache.clear();
+    }
+
+    osg::ref_ptr<const LandObject> Storage::getHeightLand(int cellX, int cellY)
+    {
+        {
+            OpenThreads::ScopedLock<OpenThreads::Mutex> lock(mHeightCacheMutex);
+            for (HeightCacheEntry& entry : mHeightCache)
+            {
+                if (entry.mCellX == cellX && entry.mCellY == cellY)
+                {
+                    entry.mLastUsed = ++mHeightCacheCounter;
+                    return entry.mLand;
+                }
+            }
+        }
+
+        // not holding the lock while loading, other threads may query cells that are cached in the meantime
         osg::ref_ptr<const LandObject> land = getLand(cellX, cellY);
-        if (!land)
-            return defaultHeight;
 
-        const ESM::Land::LandData* data = land->getData(ESM::Land::DATA_VHGT);
+        OpenThreads::ScopedLock<OpenThreads::Mutex> lock(mHeightCacheMutex);
+        HeightCacheEntry entry;
+        entry.mCellX = cellX;
+        entry.mCellY = cellY;
+        entry.mLastUsed = ++mHeightCacheCounter;
+        entry.mLand = land;
+        if (mHeightCache.size() < maxHeightCacheSize)
+            mHeightCache.push_back(entry);
+        else
+        {
+            // evict the least recently used cell, or the same cell if another thread added it in the meantime
+            auto evicted = mHeightCache.begin();
+            for (auto it = mHeightCache.begin(); it != mHeightCache.end(); ++it)
+            {
+                if (it->mCellX == cellX && it->mCellY == cellY)
+                {
+                    evicted = it;
+                    break;
+                }
+                if (it->mLastUsed < evicted->mLastUsed)
+                    evicted = it;
+            }
+            *evicted = entry;
+        }
+        return land;
+    }
+
+    float Storage::interpolateHeight(const ESM::Land::LandData* data, int cellX, int cellY, const osg::Vec3f& worldPos)
+    {
         if (!data)
             return defaultHeight;
 
-        // Mostly lifted from Ogre::Terrain::getHeightAtTerrainPosition
-
         // Normalized position in the cell
         float nX = (worldPos.x() - (cellX * Constants::CellSizeInUnits)) / float(Constants::CellSizeInUnits);
         float nY = (worldPos.y() - (cellY * Constants::CellSizeInUnits)) / float(Constants::CellSizeInUnits);
 
         // get left / bottom points (rounded down)
         float factor = ESM::Land::LAND_SIZE - 1.0f;
-        float invFactor = 1.0f / factor;
 
         int startX = static_cast<int>(nX * factor);
         int startY = static_cast<int>(nY * factor);
-        int endX = startX + 1;
-        int endY = startY + 1;
-
-        endX = std::min(endX, ESM::Land::LAND_SIZE-1);
-        endY = std::min(endY, ESM::Land::LAND_SIZE-1);
-
-        // now get points in terrain space (effectively rounding them to boundaries)
-        float startXTS = startX * invFactor;
-        float startYTS = startY * invFactor;
-        float endXTS = endX * invFactor;
-        float endYTS = endY * invFactor;
+        int endX = std::min(startX + 1, ESM::Land::LAND_SIZE-1);
+        int endY = std::min(startY + 1, ESM::Land::LAND_SIZE-1);
 
         // get parametric from start coord to next point
-        float xParam = (nX - startXTS) * factor;
-        float yParam = (nY - startYTS) * factor;
-
-        /* For even / odd tri strip rows, triangles are this shape:
-        even     odd
-        3---2   3---2
-        | / |   | \ |
-        0---1   0---1
+        float xParam = nX * factor - startX;
+        float yParam = nY * factor - startY;
+
+        /* The quads are split into triangles like this:
+        3---2
+        | \ |
+        0---1
+        FIXME: deal with differing triangle alignment
         */
 
-        // Build all 4 positions in normalized cell space, using point-sampled height
-        osg::Vec3f v0 (startXTS, startYTS, getVertexHeight(data, startX, startY) / float(Constants::CellSizeInUnits));
-        osg::Vec3f v1 (endXTS, startYTS, getVertexHeight(data, endX, startY) / float(Constants::CellSizeInUnits));
-        osg::Vec3f v2 (endXTS, endYTS, getVertexHeight(data, endX, endY) / float(Constants::CellSizeInUnits));
-        osg::Vec3f v3 (startXTS, endYTS, getVertexHeight(data, startX, endY) / float(Constants::CellSizeInUnits));
-        // define this plane in terrain space
-        osg::Plane plane;
-        // FIXME: deal with differing triangle alignment
-        if (true)
+        // Interpolate linearly over the triangle containing the position, using point-sampled heights
+        if ((1.f - yParam) > xParam)
         {
-            // odd row
-            bool secondTri = ((1.0 - yParam) > xParam);
-            if (secondTri)
-                plane = osg::Plane(v0, v1, v3);
-            else
-                plane = osg::Plane(v1, v2, v3);
+            float h0 = getVertexHeight(data, startX, startY);
+            return h0 + (getVertexHeight(data, endX, startY) - h0) * xParam
+                      + (getVertexHeight(data, startX, endY) - h0) * yParam;
         }
-        /*
         else
         {
-            // even row
-            bool secondTri = (yParam > xParam);
-            if (secondTri)
-                plane.redefine(v0, v2, v3);
-            else
-                plane.redefine(v0, v1, v2);
+            float h2 = getVertexHeight(data, endX, endY);
+            return h2 + (getVertexHeight(data, startX, endY) - h2) * (1.f - xParam)
+                      + (getVertexHeight(data, endX, startY) - h2) * (1.f - yParam);
         }
-        */
-
-        // Solve plane equation for z
-        return (-plane.getNormal().x() * nX
-                -plane.getNormal().y() * nY
-                - plane[3]) / plane.getNormal().z() * Constants::CellSizeInUnits;
-
     }
 
     float Storage::getVertexHeight(const ESM::Land::LandData* data, int x, int y)
@@ -540,6 +585,77 @@ namespace ESMTerrain
         }
     }
 
+    void Storage::addBlendmapsToKey(float chunkSize, const osg::Vec2f &chunkCenter, Resource::DiskCacheKey &key)
+    {
+        osg::Vec2f origin = chunkCenter - osg::Vec2f(chunkSize/2.f, chunkSize/2.f);
+
+        // the blendmaps also sample the neighbouring cells at the borders, see getVtexIndexAt
+        int startCellX = static_cast<int>(std::floor(origin.x())) - 1;
+        int startCellY = static_cast<int>(std::floor(origin.y())) - 1;
+        int endCellX = static_cast<int>(std::floor(origin.x() + chunkSize)) + 1;
+        int endCellY = static_cast<int>(std::floor(origin.y() + chunkSize)) + 1;
+
+        std::set<UniqueTextureId> textureIds;
+        for (int cellY = startCellY; cellY <= endCellY; ++cellY)
+        {
+            for (int cellX = startCellX; cellX <= endCellX; ++cellX)
+            {
+                osg::ref_ptr<const LandObject> land = getLand(cellX, cellY);
+                const ESM::Land::LandData* data = land ? land->getData(ESM::Land::DATA_VTEX) : nullptr;
+                key.add(data != nullptr);
+                if (!data)
+                    continue;
+
+                key.add(land->getPlugin());
+                key.add(data->mTextures, sizeof(data->mTextures));
+                for (int i=0; i<ESM::Land::LAND_NUM_TEXTURES; ++i)
+                {
+                    int tex = data->mTextures[i];
+                    textureIds.insert(tex == 0 ? std::make_pair(0,0) : std::make_pair(tex, land->getPlugin()));
+                }
+            }
+        }
+        textureIds.insert(std::make_pair(0,0)); // cells without land
+
+        for (const UniqueTextureId& id : textureIds)
+        {
+            const std::string diffuseMap = getLayerInfo(getTextureName(id)).mDiffuseMap;
+            key.add(static_cast<int>(id.first)).add(static_cast<int>(id.second)).add(diffuseMap);
+            uint64_t hash = getTextureHash(diffuseMap);
+            key.add(&hash, sizeof(hash));
+        }
+    }
+
+    uint64_t Storage::getTextureHash(const std::string &texture)
+    {
+        {
+            OpenThreads::ScopedLock<OpenThreads::Mutex> lock(mTextureHashMutex);
+            std::map<std::string, uint64_t>::const_iterator found = mTextureHashes.find(texture);
+            if (found != mTextureHashes.end())
+                return found->second;
+        }
+
+        Resource::DiskCacheKey key;
+        try
+        {
+            if (mVFS->exists(texture))
+            {
+                Files::IStreamPtr stream = mVFS->get(texture);
+                char buffer[4096];
+                while (stream->read(buffer, sizeof(buffer)) || stream->gcount() > 0)
+                    key.add(buffer, static_cast<size_t>(stream->gcount()));
+            }
+        }
+        catch (std::exception& e)
+        {
+            Log(Debug::Warning) << "Failed to read land texture " << texture << ": " << e.what();
+        }
+
+        OpenThreads::ScopedLock<OpenThreads::Mutex> lock(mTextureHashMutex);
+        mTextureHashes[texture] = key.getHash();
+        return key.getHash();
+    }
+
     Terrain::LayerInfo Storage::getLayerInfo(const std::string& texture)
     {
         OpenThreads::ScopedLock<OpenThreads::Mutex> lock(mLayerInfoMutex);
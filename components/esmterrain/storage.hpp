@@ -1,6 +1,8 @@
 #ifndef COMPONENTS_ESM_TERRAIN_STORAGE_H
 #define COMPONENTS_ESM_TERRAIN_STORAGE_H
 
+#include <cstdint>
+
 #include <OpenThreads/Mutex>
 
 #include <components/terrain/storage.hpp>
@@ -97,8 +99,17 @@ namespace ESMTerrain
         virtual void getBlendmaps (float chunkSize, const osg::Vec2f& chunkCenter, ImageVector& blendmaps,
                                std::vector<Terrain::LayerInfo>& layerList);
 
+        /// Adds the texture indices of the land records, the textures they resolve to and the contents of those textures.
+        virtual void addBlendmapsToKey (float chunkSize, const osg::Vec2f& chunkCenter, Resource::DiskCacheKey& key);
+
+        /// @note Thread safe.
         virtual float getHeightAt (const osg::Vec3f& worldPos);
 
+        /// @note Thread safe.
+        virtual void getHeightsAt (const std::vector<osg::Vec3f>& worldPos, std::vector<float>& heights);
+
+        virtual void clearHeightCache();
+
         /// Get the transformation factor for mapping cell units to world units.
         virtual float getCellWorldSize();
 
@@ -116,6 +127,12 @@ namespace ESMTerrain
 
         inline float getVertexHeight (const ESM::Land::LandData* data, int x, int y);
 
+        /// @param data The height data of the cell at cellX, cellY, or nullptr if it has none.
+        inline float interpolateHeight (const ESM::Land::LandData* data, int cellX, int cellY, const osg::Vec3f& worldPos);
+
+        /// Get the land of a cell through the height cache.
+        osg::ref_ptr<const LandObject> getHeightLand(int cellX, int cellY);
+
         inline const LandObject* getLand(int cellX, int cellY, LandCache& cache);
 
         // Since plugins can define new texture palettes, we need to know the plugin index too
@@ -129,6 +146,12 @@ namespace ESMTerrain
         std::map<std::string, Terrain::LayerInfo> mLayerInfoMap;
         OpenThreads::Mutex mLayerInfoMutex;
 
+        /// Hash the contents of a texture file, remembering the result for the rest of the session.
+        uint64_t getTextureHash(const std::string& texture);
+
+        std::map<std::string, uint64_t> mTextureHashes;
+        OpenThreads::Mutex mTextureHashMutex;
+
         std::string mNormalMapPattern;
         std::string mNormalHeightMapPattern;
         bool mAutoUseNormalMaps;
@@ -137,6 +160,19 @@ namespace ESMTerrain
         bool mAutoUseSpecularMaps;
 
         Terrain::LayerInfo getLayerInfo(const std::string& texture);
+
+        /// The land of the cells that had their heights queried most recently. Height queries tend to stay around the
+        /// same few cells, which are then found without going through getLand.
+        struct HeightCacheEntry
+        {
+            int mCellX;
+            int mCellY;
+            unsigned int mLastUsed;
+            osg::ref_ptr<const LandObject> mLand; // nullptr for cells without land
+        };
+        std::vector<HeightCacheEntry> mHeightCache;
+        unsigned int mHeightCacheCounter;
+        OpenThreads::Mutex mHeightCacheMutex;
     };
 
 }
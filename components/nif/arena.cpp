@@ -0,0 +1,46 @@
+#include "arena.hpp"
+
+#include <cassert>
+#include <cstdint>
+
+namespace Nif
+{
+
+RecordArena::RecordArena(size_t blockSize)
+    : mBlockSize(blockSize)
+    , mCapacity(0)
+    , mCurrent(nullptr)
+    , mRemaining(0)
+{
+}
+
+void* RecordArena::allocate(size_t size, size_t alignment)
+{
+    // Memory from new[] is suitably aligned for any fundamental type, which is all that records need.
+    assert(alignment <= alignof(std::max_align_t));
+
+    size_t padding = (alignment - reinterpret_cast<uintptr_t>(mCurrent) % alignment) % alignment;
+    if (mCurrent == nullptr || padding + size > mRemaining)
+    {
+        // Oversized requests get a dedicated block, so they don't waste the remainder of the current one.
+        if (size > mBlockSize / 4)
+        {
+            mBlocks.emplace_back(new char[size]);
+            mCapacity += size;
+            return mBlocks.back().get();
+        }
+
+        mBlocks.emplace_back(new char[mBlockSize]);
+        mCapacity += mBlockSize;
+        mCurrent = mBlocks.back().get();
+        mRemaining = mBlockSize;
+        padding = 0;
+    }
+
+    char* result = mCurrent + padding;
+    mCurrent = result + size;
+    mRemaining -= padding + size;
+    return result;
+}
+
+}
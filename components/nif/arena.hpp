@@ -0,0 +1,46 @@
+#ifndef OPENMW_COMPONENTS_NIF_ARENA_HPP
+#define OPENMW_COMPONENTS_NIF_ARENA_HPP
+
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <vector>
+
+namespace Nif
+{
+
+/// Monotonic allocator owning the storage of all records of a NIFFile.
+/// Memory is handed out from large blocks and is only given back all at once when the arena is destroyed.
+/// @note The arena does not run destructors, the owner must destroy the objects it created before releasing it.
+class RecordArena
+{
+public:
+    explicit RecordArena(size_t blockSize = 64 * 1024);
+
+    /// Get \a size bytes of memory aligned to \a alignment, valid until the arena is destroyed.
+    void* allocate(size_t size, size_t alignment);
+
+    /// Construct an object of type T in arena memory.
+    template <class T>
+    T* create()
+    {
+        return new (allocate(sizeof(T), alignof(T))) T;
+    }
+
+    /// Total number of bytes reserved from the heap.
+    size_t getCapacity() const { return mCapacity; }
+
+private:
+    RecordArena(const RecordArena&);
+    void operator=(const RecordArena&);
+
+    size_t mBlockSize;
+    size_t mCapacity;
+    char* mCurrent;
+    size_t mRemaining;
+    std::vector<std::unique_ptr<char[]>> mBlocks;
+};
+
+}
+
+#endif
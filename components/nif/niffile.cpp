@@ -11,24 +11,42 @@ namespace Nif
 NIFFile::NIFFile(Files::IStreamPtr stream, const std::string &name)
     : ver(0)
     , filename(name)
+    , mFileSize(0)
     , mUseSkinning(false)
 {
-    parse(stream);
+    try
+    {
+        parse(stream);
+    }
+    catch (...)
+    {
+        // The destructor won't run, make sure the records parsed so far don't leak their contents
+        destroyRecords();
+        throw;
+    }
 }
 
 NIFFile::~NIFFile()
 {
+    destroyRecords();
+}
+
+void NIFFile::destroyRecords()
+{
+    // The record storage itself is owned by mArena and released along with it
     for (std::vector<Record*>::iterator it = records.begin() ; it != records.end(); ++it)
     {
-        delete *it;
+        if (*it)
+            (*it)->~Record();
     }
+    records.clear();
 }
 
-template <typename NodeType> static Record* construct() { return new NodeType; }
+template <typename NodeType> static Record* construct(RecordArena& arena) { return arena.create<NodeType>(); }
 
 struct RecordFactoryEntry {
 
-    typedef Record* (*create_t) ();
+    typedef Record* (*create_t) (RecordArena& arena);
 
     create_t        mCreate;
     RecordType      mType;
@@ -36,7 +54,7 @@ struct RecordFactoryEntry {
 };
 
 ///Helper function for adding records to the factory map
-static std::pair<std::string,RecordFactoryEntry> makeEntry(std::string recName, Record* (*create_t) (), RecordType type)
+static std::pair<std::string,RecordFactoryEntry> makeEntry(std::string recName, RecordFactoryEntry::create_t create_t, RecordType type)
 {
     RecordFactoryEntry anEntry = {create_t,type};
     return std::make_pair(recName, anEntry);
@@ -132,6 +150,7 @@ std::string NIFFile::printVersion(unsigned int version)
 void NIFFile::parse(Files::IStreamPtr stream)
 {
     NIFStream nif (this, stream);
+    mFileSize = nif.getSize();
 
     // Check the header string
     std::string head = nif.getVersionString();
@@ -173,7 +192,7 @@ void NIFFile::parse(Files::IStreamPtr stream)
 
         if (entry != factories.end())
         {
-            r = entry->second.mCreate ();
+            r = entry->second.mCreate (mArena);
             r->recType = entry->second.mType;
         }
         else
@@ -9,6 +9,7 @@
 #include <components/debug/debuglog.hpp>
 #include <components/files/constrainedfilestream.hpp>
 
+#include "arena.hpp"
 #include "record.hpp"
 
 namespace Nif
@@ -45,6 +46,12 @@ class NIFFile final : public File
     /// File name, used for error messages and opening the file
     std::string filename;
 
+    /// Storage for all records of this file
+    RecordArena mArena;
+
+    /// Size of the file the records were read from
+    size_t mFileSize;
+
     /// Record list
     std::vector<Record*> records;
 
@@ -56,6 +63,9 @@ class NIFFile final : public File
     /// Parse the file
     void parse(Files::IStreamPtr stream);
 
+    /// Run the destructors of all records, their storage is released along with mArena
+    void destroyRecords();
+
     /// Get the file's version in a human readable form
     ///\returns A string containing a human readable NIF version number
     std::string printVersion(unsigned int version);
@@ -109,6 +119,10 @@ public:
 
     /// Get the name of the file
     std::string getFilename() const override { return filename; }
+
+    /// Get an estimate of the memory used by the records in bytes.
+    /// @note Record members with their own storage, such as vertex arrays, are estimated from the size of the file.
+    size_t getMemoryUsage() const { return mArena.getCapacity() + mFileSize + records.capacity() * sizeof(Record*); }
 };
 typedef std::shared_ptr<const Nif::NIFFile> NIFFilePtr;
 
@@ -5,8 +5,11 @@
 
 #include "nifstream.hpp"
 
+#include <algorithm>
+#include <functional>
+#include <numeric>
 #include <sstream>
-#include <map>
+#include <vector>
 
 #include "niffile.hpp"
 
@@ -31,10 +34,10 @@ typedef KeyT<osg::Vec3f> Vector3Key;
 typedef KeyT<osg::Vec4f> Vector4Key;
 typedef KeyT<osg::Quat> QuaternionKey;
 
+/// Keyframe track, stored as parallel arrays of key times and key values sorted by time.
+/// @note Times are strictly increasing, for duplicate times only the last key read from the file is kept.
 template<typename T, T (NIFStream::*getValue)()>
 struct KeyMapT {
-    typedef std::map< float, KeyT<T> > MapType;
-
     typedef T ValueType;
     typedef KeyT<T> KeyType;
 
@@ -44,10 +47,13 @@ struct KeyMapT {
     static const unsigned int sXYZInterpolation = 4;
 
     unsigned int mInterpolationType;
-    MapType mKeys;
+    std::vector<float> mTimes;
+    std::vector<KeyType> mKeys;
 
     KeyMapT() : mInterpolationType(sLinearInterpolation) {}
 
+    const T& getValue(size_t index) const { return mKeys[index].mValue; }
+
     //Read in a KeyGroup (see http://niftools.sourceforge.net/doc/nif/NiKeyframeData.html)
     void read(NIFStream *nif, bool force=false)
     {
@@ -59,6 +65,7 @@ struct KeyMapT {
         if(count == 0 && !force)
             return;
 
+        mTimes.clear();
         mKeys.clear();
 
         mInterpolationType = nif->getUInt();
@@ -70,28 +77,31 @@ struct KeyMapT {
         {
             for(size_t i = 0;i < count;i++)
             {
-                float time = nif->getFloat();
+                mTimes.push_back(nif->getFloat());
                 readValue(nifReference, key);
-                mKeys[time] = key;
+                mKeys.push_back(key);
             }
+            sortKeys();
         }
         else if(mInterpolationType == sQuadraticInterpolation)
         {
             for(size_t i = 0;i < count;i++)
             {
-                float time = nif->getFloat();
+                mTimes.push_back(nif->getFloat());
                 readQuadratic(nifReference, key);
-                mKeys[time] = key;
+                mKeys.push_back(key);
             }
+            sortKeys();
         }
         else if(mInterpolationType == sTBCInterpolation)
         {
             for(size_t i = 0;i < count;i++)
             {
-                float time = nif->getFloat();
+                mTimes.push_back(nif->getFloat());
                 readTBC(nifReference, key);
-                mKeys[time] = key;
+                mKeys.push_back(key);
             }
+            sortKeys();
         }
         //XYZ keys aren't actually read here.
         //data.hpp sees that the last type read was sXYZInterpolation and:
@@ -122,7 +132,40 @@ struct KeyMapT {
         }
     }
 
+    bool empty() const { return mKeys.empty(); }
+
+    size_t size() const { return mKeys.size(); }
+
 private:
+    /// Keys are almost always stored in order already, only sort if they aren't.
+    void sortKeys()
+    {
+        if (std::adjacent_find(mTimes.begin(), mTimes.end(), std::greater_equal<float>()) == mTimes.end())
+            return;
+
+        std::vector<size_t> order(mTimes.size());
+        std::iota(order.begin(), order.end(), 0);
+        std::stable_sort(order.begin(), order.end(), [this] (size_t a, size_t b) { return mTimes[a] < mTimes[b]; });
+
+        std::vector<float> times;
+        std::vector<KeyType> keys;
+        times.reserve(order.size());
+        keys.reserve(order.size());
+        for (size_t index : order)
+        {
+            // The sort is stable, so a later key with the same time replaces the previous one
+            if (!times.empty() && times.back() == mTimes[index])
+                keys.back() = mKeys[index];
+            else
+            {
+                times.push_back(mTimes[index]);
+                keys.push_back(mKeys[index]);
+            }
+        }
+        mTimes.swap(times);
+        mKeys.swap(keys);
+    }
+
     static void readValue(NIFStream &nif, KeyT<T> &key)
     {
         key.mValue = (nif.*getValue)();
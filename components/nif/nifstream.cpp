@@ -2,12 +2,52 @@
 //For error reporting
 #include "niffile.hpp"
 
+#include <sstream>
+
 namespace Nif
 {
+    NIFStream::NIFStream(NIFFile *file, Files::IStreamPtr inp)
+        : mCursor(nullptr)
+        , mEnd(nullptr)
+        , file(file)
+    {
+        // Read the whole file in one go, the stream might be a BSA entry that we can't map directly.
+        inp->seekg(0, std::ios_base::end);
+        std::streamoff size = inp->tellg();
+        inp->seekg(0, std::ios_base::beg);
+        if (size > 0 && inp->good())
+        {
+            mBuffer.resize(static_cast<size_t>(size));
+            inp->read(mBuffer.data(), size);
+            mBuffer.resize(static_cast<size_t>(inp->gcount()));
+        }
+        else
+        {
+            // Not seekable, fall back to reading in chunks.
+            inp->clear();
+            char chunk[16384];
+            while (inp->read(chunk, sizeof(chunk)) || inp->gcount() > 0)
+                mBuffer.insert(mBuffer.end(), chunk, chunk + inp->gcount());
+        }
+
+        mCursor = mBuffer.data();
+        mEnd = mCursor + mBuffer.size();
+    }
+
+    void NIFStream::failEndOfFile(size_t size) const
+    {
+        std::stringstream error;
+        error << "Unexpected end of file: tried to read " << size << " bytes at offset " << (mCursor - mBuffer.data())
+              << ", " << (mEnd - mCursor) << " bytes left";
+        file->fail(error.str());
+        // fail() always throws, this is only to satisfy [[noreturn]]
+        throw std::runtime_error(error.str());
+    }
+
     osg::Quat NIFStream::getQuaternion()
     {
         float f[4];
-        readLittleEndianBufferOfType<4, float,uint32_t>(inp, (float*)&f);
+        readLittleEndianBuffer<4,uint32_t>(f);
         osg::Quat quat;
         quat.w() = f[0];
         quat.x() = f[1];
@@ -64,9 +64,10 @@ void fillTriangleMesh(btTriangleMesh& mesh, const Nif::NiTriShapeData& data)
 namespace NifBullet
 {
 
-osg::ref_ptr<Resource::BulletShape> BulletNifLoader::load(const Nif::File& nif)
+osg::ref_ptr<Resource::BulletShape> BulletNifLoader::load(const Nif::File& nif, bool buildBvh)
 {
     mShape = new Resource::BulletShape;
+    mBuildBvh = buildBvh;
 
     mCompoundShape.reset();
     mStaticMesh.reset();
@@ -118,7 +119,7 @@ osg::ref_ptr<Resource::BulletShape> BulletNifLoader::load(const Nif::File& nif)
             {
                 btTransform trans;
                 trans.setIdentity();
-                std::unique_ptr<btCollisionShape> child(new Resource::TriangleMeshShape(mStaticMesh.get(), true));
+                std::unique_ptr<btCollisionShape> child(new Resource::TriangleMeshShape(mStaticMesh.get(), true, mBuildBvh));
                 mCompoundShape->addChildShape(trans, child.get());
                 child.release();
                 mStaticMesh.release();
@@ -127,13 +128,13 @@ osg::ref_ptr<Resource::BulletShape> BulletNifLoader::load(const Nif::File& nif)
         }
         else if (mStaticMesh)
         {
-            mShape->mCollisionShape = new Resource::TriangleMeshShape(mStaticMesh.get(), true);
+            mShape->mCollisionShape = new Resource::TriangleMeshShape(mStaticMesh.get(), true, mBuildBvh);
             mStaticMesh.release();
         }
 
         if (mAvoidStaticMesh)
         {
-            mShape->mAvoidCollisionShape = new Resource::TriangleMeshShape(mAvoidStaticMesh.get(), false);
+            mShape->mAvoidCollisionShape = new Resource::TriangleMeshShape(mAvoidStaticMesh.get(), false, mBuildBvh);
             mAvoidStaticMesh.release();
         }
 
@@ -292,7 +293,7 @@ void BulletNifLoader::handleNiTriShape(const Nif::NiTriShape *shape, int flags,
 
         fillTriangleMesh(*childMesh, shape->data.get());
 
-        std::unique_ptr<Resource::TriangleMeshShape> childShape(new Resource::TriangleMeshShape(childMesh.get(), true));
+        std::unique_ptr<Resource::TriangleMeshShape> childShape(new Resource::TriangleMeshShape(childMesh.get(), true, mBuildBvh));
         childMesh.release();
 
         float scale = shape->trafo.scale;
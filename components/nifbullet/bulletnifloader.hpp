@@ -48,7 +48,9 @@ public:
         abort();
     }
 
-    osg::ref_ptr<Resource::BulletShape> load(const Nif::File& file);
+    /// @param buildBvh If false, the triangle mesh shapes are created without their BVH, which then has to be built or
+    /// assigned by the caller before the shape can be used, see Resource::TriangleMeshShape.
+    osg::ref_ptr<Resource::BulletShape> load(const Nif::File& file, bool buildBvh = true);
 
 private:
     bool findBoundingBox(const Nif::Node* node);
@@ -67,6 +69,8 @@ private:
     std::unique_ptr<btTriangleMesh> mAvoidStaticMesh;
 
     osg::ref_ptr<Resource::BulletShape> mShape;
+
+    bool mBuildBvh = true;
 };
 
 }
@@ -1,5 +1,8 @@
 #include "controller.hpp"
 
+#include <algorithm>
+#include <cmath>
+
 #include <osg/MatrixTransform>
 #include <osg/TexMat>
 #include <osg/Material>
@@ -75,10 +78,12 @@ KeyframeController::KeyframeController(const KeyframeController &copy, const osg
     : osg::NodeCallback(copy, copyop)
     , Controller(copy)
     , mRotations(copy.mRotations)
+    , mQuantizedRotations(copy.mQuantizedRotations)
     , mXRotations(copy.mXRotations)
     , mYRotations(copy.mYRotations)
     , mZRotations(copy.mZRotations)
     , mTranslations(copy.mTranslations)
+    , mQuantizedTranslations(copy.mQuantizedTranslations)
     , mScales(copy.mScales)
 {
 }
@@ -110,11 +115,144 @@ osg::Quat KeyframeController::getXYZRotation(float time) const
 
 osg::Vec3f KeyframeController::getTranslation(float time) const
 {
+    if(!mQuantizedTranslations.empty())
+        return mQuantizedTranslations.interpKey(time);
     if(!mTranslations.empty())
         return mTranslations.interpKey(time);
     return osg::Vec3f();
 }
 
+namespace
+{
+    template <class MapT>
+    size_t getTrackMemoryUsage(const std::shared_ptr<const MapT>& keys)
+    {
+        if (!keys)
+            return 0;
+        return sizeof(MapT) + keys->mTimes.capacity() * sizeof(float) + keys->mKeys.capacity() * sizeof(typename MapT::KeyType);
+    }
+
+    template <class T>
+    size_t getQuantizedTrackMemoryUsage(const std::shared_ptr<const T>& keys)
+    {
+        return keys ? keys->getMemoryUsage() : 0;
+    }
+
+    /// Get the indices of the keys that can not be reproduced by interpolating between the previous kept key and
+    /// the following key within the given tolerance. The first and last keys are always kept.
+    template <class MapT, class InterpolationFunc, class DistanceFunc>
+    std::vector<size_t> findRequiredKeys(const MapT& keys, float tolerance, DistanceFunc distance)
+    {
+        std::vector<size_t> required;
+        const size_t count = keys.size();
+        if (count == 0)
+            return required;
+
+        required.push_back(0);
+        for (size_t candidate = 1; candidate + 1 < count; ++candidate)
+        {
+            // check all keys between the last kept key and the next one, including the ones dropped before
+            const size_t first = required.back();
+            const size_t next = candidate + 1;
+            const float startTime = keys.mTimes[first];
+            const float duration = keys.mTimes[next] - startTime;
+            for (size_t i = first + 1; i < next; ++i)
+            {
+                float a = (keys.mTimes[i] - startTime) / duration;
+                if (distance(InterpolationFunc()(keys.getValue(first), keys.getValue(next), a), keys.getValue(i)) > tolerance)
+                {
+                    required.push_back(candidate);
+                    break;
+                }
+            }
+        }
+        if (count > 1)
+            required.push_back(count - 1);
+        return required;
+    }
+
+    float getQuaternionDistance(const osg::Quat& a, const osg::Quat& b)
+    {
+        double dot = std::abs(a.asVec4() * b.asVec4());
+        return static_cast<float>(2.0 * std::acos(std::min(1.0, dot)));
+    }
+
+    float getVec3Distance(const osg::Vec3f& a, const osg::Vec3f& b)
+    {
+        return (a - b).length();
+    }
+
+    float getFloatDistance(float a, float b)
+    {
+        return std::abs(a - b);
+    }
+
+    std::shared_ptr<const Nif::FloatKeyMap> reduceFloatKeys(const std::shared_ptr<const Nif::FloatKeyMap>& keys, float tolerance)
+    {
+        if (!keys || keys->empty())
+            return keys;
+        std::vector<size_t> required = findRequiredKeys<Nif::FloatKeyMap, LerpFunc>(*keys, tolerance, getFloatDistance);
+
+        std::shared_ptr<Nif::FloatKeyMap> reduced = std::make_shared<Nif::FloatKeyMap>();
+        reduced->mInterpolationType = keys->mInterpolationType;
+        reduced->mTimes.reserve(required.size());
+        reduced->mKeys.reserve(required.size());
+        for (size_t index : required)
+        {
+            reduced->mTimes.push_back(keys->mTimes[index]);
+            reduced->mKeys.push_back(keys->mKeys[index]);
+        }
+        return reduced;
+    }
+}
+
+void KeyframeController::compress(const KeyframeCompression& compression)
+{
+    const float rotationTolerance = compression.mRotationTolerance;
+    if (!mRotations.empty())
+    {
+        const Nif::QuaternionKeyMap& keys = *mRotations.getKeys();
+        std::shared_ptr<QuantizedQuaternionKeyMap> quantized = std::make_shared<QuantizedQuaternionKeyMap>();
+        for (size_t index : findRequiredKeys<Nif::QuaternionKeyMap, QuaternionSlerpFunc>(keys, rotationTolerance, getQuaternionDistance))
+            quantized->addKey(keys.mTimes[index], keys.getValue(index));
+        mQuantizedRotations = QuantizedQuaternionInterpolator(quantized);
+        mRotations = QuaternionInterpolator();
+    }
+
+    if (!mTranslations.empty())
+    {
+        const Nif::Vector3KeyMap& keys = *mTranslations.getKeys();
+        std::vector<float> times;
+        std::vector<osg::Vec3f> values;
+        for (size_t index : findRequiredKeys<Nif::Vector3KeyMap, LerpFunc>(keys, compression.mTranslationTolerance, getVec3Distance))
+        {
+            times.push_back(keys.mTimes[index]);
+            values.push_back(keys.getValue(index));
+        }
+        std::shared_ptr<QuantizedVec3KeyMap> quantized = std::make_shared<QuantizedVec3KeyMap>();
+        quantized->assign(times, values);
+        mQuantizedTranslations = QuantizedVec3Interpolator(quantized);
+        mTranslations = Vec3Interpolator();
+    }
+
+    mXRotations = FloatInterpolator(reduceFloatKeys(mXRotations.getKeys(), rotationTolerance), 0.f);
+    mYRotations = FloatInterpolator(reduceFloatKeys(mYRotations.getKeys(), rotationTolerance), 0.f);
+    mZRotations = FloatInterpolator(reduceFloatKeys(mZRotations.getKeys(), rotationTolerance), 0.f);
+    mScales = FloatInterpolator(reduceFloatKeys(mScales.getKeys(), compression.mScaleTolerance), 1.f);
+}
+
+size_t KeyframeController::getMemoryUsage() const
+{
+    return getTrackMemoryUsage(mRotations.getKeys())
+            + getQuantizedTrackMemoryUsage(mQuantizedRotations.getKeys())
+            + getTrackMemoryUsage(mXRotations.getKeys())
+            + getTrackMemoryUsage(mYRotations.getKeys())
+            + getTrackMemoryUsage(mZRotations.getKeys())
+            + getTrackMemoryUsage(mTranslations.getKeys())
+            + getQuantizedTrackMemoryUsage(mQuantizedTranslations.getKeys())
+            + getTrackMemoryUsage(mScales.getKeys());
+}
+
 void KeyframeController::operator() (osg::Node* node, osg::NodeVisitor* nv)
 {
     if (hasInput())
@@ -128,7 +266,12 @@ void KeyframeController::operator() (osg::Node* node, osg::NodeVisitor* nv)
         Nif::Matrix3& rot = userdata->mRotationScale;
 
         bool setRot = false;
-        if(!mRotations.empty())
+        if(!mQuantizedRotations.empty())
+        {
+            mat.setRotate(mQuantizedRotations.interpKey(time));
+            setRot = true;
+        }
+        else if(!mRotations.empty())
         {
             mat.setRotate(mRotations.interpKey(time));
             setRot = true;
@@ -159,7 +302,9 @@ void KeyframeController::operator() (osg::Node* node, osg::NodeVisitor* nv)
             for (int j=0;j<3;++j)
                 mat(i,j) *= scale;
 
-        if(!mTranslations.empty())
+        if(!mQuantizedTranslations.empty())
+            mat.setTrans(mQuantizedTranslations.interpKey(time));
+        else if(!mTranslations.empty())
             mat.setTrans(mTranslations.interpKey(time));
 
         trans->setMatrix(mat);
@@ -9,6 +9,8 @@
 #include <components/sceneutil/controller.hpp>
 #include <components/sceneutil/statesetupdater.hpp>
 
+#include "quantizedkeys.hpp"
+
 #include <set> //UVController
 
 // FlipController
@@ -42,19 +44,16 @@ namespace NifOsg
         typedef typename MapT::ValueType ValueT;
 
         ValueInterpolator()
-            : mDefaultVal(ValueT())
+            : mLastHighKey(0)
+            , mDefaultVal(ValueT())
         {
         }
 
         ValueInterpolator(std::shared_ptr<const MapT> keys, ValueT defaultVal = ValueT())
-            : mKeys(keys)
+            : mLastHighKey(0)
+            , mKeys(keys)
             , mDefaultVal(defaultVal)
         {
-            if (keys)
-            {
-                mLastLowKey = mKeys->mKeys.end();
-                mLastHighKey = mKeys->mKeys.end();
-            }
         }
 
         ValueT interpKey(float time) const
@@ -62,59 +61,48 @@ namespace NifOsg
             if (empty())
                 return mDefaultVal;
 
-            const typename MapT::MapType & keys = mKeys->mKeys;
+            const std::vector<float>& times = mKeys->mTimes;
 
-            if(time <= keys.begin()->first)
-                return keys.begin()->second.mValue;
+            if(time <= times.front())
+                return mKeys->getValue(0);
+            if(time >= times.back())
+                return mKeys->getValue(times.size() - 1);
 
-            // retrieve the current position in the map, optimized for the most common case
-            // where time moves linearly along the keyframe track
-            typename MapT::MapType::const_iterator it = mLastHighKey;
-            if (mLastHighKey != keys.end())
+            // At this point there are at least two keys and time lies strictly between the first and the last one.
+            // Find the first key at or after the given time, starting from the cached position; this is optimized
+            // for the most common case where time moves linearly along the keyframe track
+            size_t high = mLastHighKey;
+            if (high == 0 || !(times[high-1] < time && time <= times[high]))
             {
-                if (time > mLastHighKey->first)
-                {
-                    // try if we're there by incrementing one
-                    ++mLastLowKey;
-                    ++mLastHighKey;
-                    it = mLastHighKey;
-                }
-                if (mLastHighKey == keys.end() || (time < mLastLowKey->first || time > mLastHighKey->first))
-                    it = keys.lower_bound(time); // still not there, reorient by performing lower_bound check on the whole map
+                // try if we're there by incrementing one
+                if (high != 0 && high + 1 < times.size() && times[high] < time && time <= times[high+1])
+                    ++high;
+                else // still not there, reorient by performing a binary search on the whole track
+                    high = std::lower_bound(times.begin(), times.end(), time) - times.begin();
             }
-            else
-                it = keys.lower_bound(time);
-
-            // now do the actual interpolation
-            if (it != keys.end())
-            {
-                float aTime = it->first;
-                const typename MapT::KeyType* aKey = &it->second;
-
-                // cache for next time
-                mLastHighKey = it;
 
-                typename MapT::MapType::const_iterator last = --it;
-                mLastLowKey = last;
-                float aLastTime = last->first;
-                const typename MapT::KeyType* aLastKey = &last->second;
+            // cache for next time
+            mLastHighKey = high;
 
-                float a = (time - aLastTime) / (aTime - aLastTime);
+            size_t low = high - 1;
+            float a = (time - times[low]) / (times[high] - times[low]);
 
-                return InterpolationFunc()(aLastKey->mValue, aKey->mValue, a);
-            }
-            else
-                return keys.rbegin()->second.mValue;
+            return InterpolationFunc()(mKeys->getValue(low), mKeys->getValue(high), a);
         }
 
         bool empty() const
         {
-            return !mKeys || mKeys->mKeys.empty();
+            return !mKeys || mKeys->empty();
+        }
+
+        const std::shared_ptr<const MapT>& getKeys() const
+        {
+            return mKeys;
         }
 
     private:
-        mutable typename MapT::MapType::const_iterator mLastLowKey;
-        mutable typename MapT::MapType::const_iterator mLastHighKey;
+        /// Index of the key used as upper bound during the last lookup, 0 if there was none
+        mutable size_t mLastHighKey;
 
         std::shared_ptr<const MapT> mKeys;
 
@@ -143,6 +131,8 @@ namespace NifOsg
     typedef ValueInterpolator<Nif::QuaternionKeyMap, QuaternionSlerpFunc> QuaternionInterpolator;
     typedef ValueInterpolator<Nif::FloatKeyMap, LerpFunc> FloatInterpolator;
     typedef ValueInterpolator<Nif::Vector3KeyMap, LerpFunc> Vec3Interpolator;
+    typedef ValueInterpolator<QuantizedQuaternionKeyMap, QuaternionSlerpFunc> QuantizedQuaternionInterpolator;
+    typedef ValueInterpolator<QuantizedVec3KeyMap, LerpFunc> QuantizedVec3Interpolator;
 
     class ControllerFunction : public SceneUtil::ControllerFunction
     {
@@ -183,6 +173,16 @@ namespace NifOsg
         std::vector<FloatInterpolator> mKeyFrames;
     };
 
+    /// Tolerances for dropping redundant keys in KeyframeController::compress.
+    struct KeyframeCompression
+    {
+        KeyframeCompression() : mRotationTolerance(0.001f), mTranslationTolerance(0.01f), mScaleTolerance(0.0001f) {}
+
+        float mRotationTolerance; // radians
+        float mTranslationTolerance; // units
+        float mScaleTolerance;
+    };
+
     class KeyframeController : public osg::NodeCallback, public SceneUtil::Controller
     {
     public:
@@ -196,14 +196,24 @@ namespace NifOsg
 
         virtual void operator() (osg::Node*, osg::NodeVisitor*);
 
+        /// Replace the keyframe tracks with quantized copies, dropping keys that linear interpolation between their
+        /// neighbours reproduces within the given tolerances.
+        /// @note Must be called before the controller is shared with other threads.
+        void compress(const KeyframeCompression& compression);
+
+        /// Get the approximate size of the keyframe tracks in bytes.
+        size_t getMemoryUsage() const;
+
     private:
         QuaternionInterpolator mRotations;
+        QuantizedQuaternionInterpolator mQuantizedRotations;
 
         FloatInterpolator mXRotations;
         FloatInterpolator mYRotations;
         FloatInterpolator mZRotations;
 
         Vec3Interpolator mTranslations;
+        QuantizedVec3Interpolator mQuantizedTranslations;
         FloatInterpolator mScales;
 
         osg::Quat getXYZRotation(float time) const;
@@ -193,7 +193,7 @@ namespace NifOsg
         size_t mFirstRootTextureIndex;
         bool mFoundFirstRootTexturingProperty;
 
-        static void loadKf(Nif::NIFFilePtr nif, KeyframeHolder& target)
+        static void loadKf(Nif::NIFFilePtr nif, KeyframeHolder& target, const KeyframeCompression* compression)
         {
             if(nif->numRoots() < 1)
             {
@@ -245,8 +245,20 @@ namespace NifOsg
                 callback->setFunction(std::shared_ptr<NifOsg::ControllerFunction>(new NifOsg::ControllerFunction(key)));
 
                 if (!target.mKeyframeControllers.emplace(strdata->string, callback).second)
+                {
                     Log(Debug::Verbose) << "Controller " << strdata->string << " present more than once in " << nif->getFilename() << ", ignoring later version";
+                    continue;
+                }
+
+                target.mUncompressedMemoryUsage += callback->getMemoryUsage();
+                if (compression)
+                    callback->compress(*compression);
+                target.mMemoryUsage += callback->getMemoryUsage();
             }
+
+            if (compression)
+                Log(Debug::Verbose) << "Compressed keyframes in " << nif->getFilename() << " from "
+                                    << target.mUncompressedMemoryUsage << " to " << target.mMemoryUsage << " bytes";
         }
 
         osg::ref_ptr<osg::Node> load(Nif::NIFFilePtr nif, Resource::ImageManager* imageManager)
@@ -784,7 +796,7 @@ namespace NifOsg
 
         void handleParticlePrograms(Nif::ExtraPtr affectors, Nif::ExtraPtr colliders, osg::Group *attachTo, osgParticle::ParticleSystem* partsys, osgParticle::ParticleProcessor::ReferenceFrame rf)
         {
-            osgParticle::ModularProgram* program = new osgParticle::ModularProgram;
+            osgParticle::ModularProgram* program = new ParticleProgram;
             attachTo->addChild(program);
             program->setParticleSystem(partsys);
             program->setReferenceFrame(rf);
@@ -1720,10 +1732,10 @@ namespace NifOsg
         return impl.load(file, imageManager);
     }
 
-    void Loader::loadKf(Nif::NIFFilePtr kf, KeyframeHolder& target)
+    void Loader::loadKf(Nif::NIFFilePtr kf, KeyframeHolder& target, const KeyframeCompression* compression)
     {
         LoaderImpl impl(kf->getFilename());
-        impl.loadKf(kf, target);
+        impl.loadKf(kf, target, compression);
     }
 
 }
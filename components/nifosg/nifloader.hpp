@@ -40,10 +40,12 @@ namespace NifOsg
     class KeyframeHolder : public osg::Object
     {
     public:
-        KeyframeHolder() {}
+        KeyframeHolder() : mMemoryUsage(0), mUncompressedMemoryUsage(0) {}
         KeyframeHolder(const KeyframeHolder& copy, const osg::CopyOp& copyop)
             : mTextKeys(copy.mTextKeys)
             , mKeyframeControllers(copy.mKeyframeControllers)
+            , mMemoryUsage(copy.mMemoryUsage)
+            , mUncompressedMemoryUsage(copy.mUncompressedMemoryUsage)
         {
         }
 
@@ -53,6 +55,10 @@ namespace NifOsg
 
         typedef std::map<std::string, osg::ref_ptr<const KeyframeController> > KeyframeControllerMap;
         KeyframeControllerMap mKeyframeControllers;
+
+        /// Approximate size of the keyframe tracks in bytes, before and after compression.
+        size_t mMemoryUsage;
+        size_t mUncompressedMemoryUsage;
     };
 
     /// The main class responsible for loading NIF files into an OSG-Scenegraph.
@@ -65,7 +71,8 @@ namespace NifOsg
         static osg::ref_ptr<osg::Node> load(Nif::NIFFilePtr file, Resource::ImageManager* imageManager);
 
         /// Load keyframe controllers from the given kf file.
-        static void loadKf(Nif::NIFFilePtr kf, KeyframeHolder& target);
+        /// @param compression If not null, the keyframe tracks are compressed with the given tolerances.
+        static void loadKf(Nif::NIFFilePtr kf, KeyframeHolder& target, const KeyframeCompression* compression = nullptr);
 
         /// Set whether or not nodes marked as "MRK" should be shown.
         /// These should be hidden ingame, but visible in the editor.
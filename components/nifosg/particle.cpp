@@ -12,6 +12,23 @@
 
 #include "userdata.hpp"
 
+namespace
+{
+    /// Apply an operator to the live particles of a particle system, without a virtual call for each particle.
+    template <class T>
+    void operateAlive(T& op, osgParticle::ParticleSystem* ps, double dt)
+    {
+        if (!op.isEnabled())
+            return;
+        for (int i=0, n=ps->numParticles(); i<n; ++i)
+        {
+            osgParticle::Particle* particle = ps->getParticle(i);
+            if (particle->isAlive())
+                op.T::operate(particle, dt);
+        }
+    }
+}
+
 namespace NifOsg
 {
 
@@ -59,6 +76,35 @@ void InverseWorldMatrix::operator()(osg::Node *node, osg::NodeVisitor *nv)
     traverse(node,nv);
 }
 
+ParticleProgram::ParticleProgram()
+    : mFrameNumber(0)
+{
+}
+
+ParticleProgram::ParticleProgram(const ParticleProgram &copy, const osg::CopyOp &copyop)
+    : osgParticle::ModularProgram(copy, copyop)
+    , mFrameNumber(0)
+{
+}
+
+void ParticleProgram::traverse(osg::NodeVisitor &nv)
+{
+    if (nv.getVisitorType() == osg::NodeVisitor::UPDATE_VISITOR && nv.getFrameStamp())
+        mFrameNumber = nv.getFrameStamp()->getFrameNumber();
+
+    osgParticle::ModularProgram::traverse(nv);
+}
+
+void ParticleProgram::execute(double dt)
+{
+    // same test as osgParticle::ParticleProcessor uses for FreezeOnCull, the frame number is set when the particles are drawn
+    osgParticle::ParticleSystem* ps = getParticleSystem();
+    if (ps && ps->getLastFrameNumber() + 2 < mFrameNumber)
+        return;
+
+    osgParticle::ModularProgram::execute(dt);
+}
+
 ParticleShooter::ParticleShooter(float minSpeed, float maxSpeed, float horizontalDir, float horizontalAngle, float verticalDir, float verticalAngle, float lifetime, float lifetimeRandom)
     : mMinSpeed(minSpeed), mMaxSpeed(maxSpeed), mHorizontalDir(horizontalDir)
     , mHorizontalAngle(horizontalAngle), mVerticalDir(verticalDir), mVerticalAngle(verticalAngle)
@@ -130,6 +176,11 @@ void GrowFadeAffector::operate(osgParticle::Particle* particle, double /* dt */)
     particle->setSizeRange(osgParticle::rangef(size, size));
 }
 
+void GrowFadeAffector::operateParticles(osgParticle::ParticleSystem *ps, double dt)
+{
+    operateAlive(*this, ps, dt);
+}
+
 ParticleColorAffector::ParticleColorAffector(const Nif::NiColorData *clrdata)
     : mData(clrdata->mKeyMap, osg::Vec4f(1,1,1,1))
 {
@@ -154,6 +205,11 @@ void ParticleColorAffector::operate(osgParticle::Particle* particle, double /* d
     particle->setColorRange(osgParticle::rangev4(color, color));
 }
 
+void ParticleColorAffector::operateParticles(osgParticle::ParticleSystem *ps, double dt)
+{
+    operateAlive(*this, ps, dt);
+}
+
 GravityAffector::GravityAffector(const Nif::NiGravity *gravity)
     : mForce(gravity->mForce)
     , mType(static_cast<ForceType>(gravity->mType))
@@ -221,6 +277,25 @@ void GravityAffector::operate(osgParticle::Particle *particle, double dt)
     }
 }
 
+void GravityAffector::operateParticles(osgParticle::ParticleSystem *ps, double dt)
+{
+    if (mType == Type_Wind && mDecay == 0.f && isEnabled())
+    {
+        // the same for every particle
+        const float magic = 1.6f;
+        osg::Vec3f velocity = mCachedWorldDirection * mForce * dt * magic;
+        for (int i=0, n=ps->numParticles(); i<n; ++i)
+        {
+            osgParticle::Particle* particle = ps->getParticle(i);
+            if (particle->isAlive())
+                particle->addVelocity(velocity);
+        }
+        return;
+    }
+
+    operateAlive(*this, ps, dt);
+}
+
 Emitter::Emitter()
     : osgParticle::Emitter()
 {
@@ -394,6 +469,11 @@ void PlanarCollider::operate(osgParticle::Particle *particle, double dt)
     }
 }
 
+void PlanarCollider::operateParticles(osgParticle::ParticleSystem *ps, double dt)
+{
+    operateAlive(*this, ps, dt);
+}
+
 SphericalCollider::SphericalCollider(const Nif::NiSphericalCollider* collider)
     : mBounceFactor(collider->mBounceFactor),
       mSphere(collider->mCenter, collider->mRadius)
@@ -463,4 +543,9 @@ void SphericalCollider::operate(osgParticle::Particle* particle, double dt)
     }
 }
 
+void SphericalCollider::operateParticles(osgParticle::ParticleSystem* ps, double dt)
+{
+    operateAlive(*this, ps, dt);
+}
+
 }
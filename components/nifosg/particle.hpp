@@ -7,6 +7,7 @@
 #include <osgParticle/Emitter>
 #include <osgParticle/Placer>
 #include <osgParticle/Counter>
+#include <osgParticle/ModularProgram>
 
 #include <osg/NodeCallback>
 
@@ -70,6 +71,26 @@ namespace NifOsg
         void operator()(osg::Node* node, osg::NodeVisitor* nv);
     };
 
+    // Subclass ModularProgram to skip the operators of particle systems that are not drawn, like osgParticle does for
+    // particle systems with FreezeOnCull, but without freezing them. The particles keep aging and moving and the emitters
+    // keep firing, only affectors and colliders are left out until the particle system is visible again.
+    class ParticleProgram : public osgParticle::ModularProgram
+    {
+    public:
+        ParticleProgram();
+        ParticleProgram(const ParticleProgram& copy, const osg::CopyOp& copyop = osg::CopyOp::SHALLOW_COPY);
+
+        META_Node(NifOsg, ParticleProgram)
+
+        virtual void traverse(osg::NodeVisitor& nv);
+
+    protected:
+        virtual void execute(double dt);
+
+    private:
+        unsigned int mFrameNumber;
+    };
+
     class ParticleShooter : public osgParticle::Shooter
     {
     public:
@@ -104,6 +125,7 @@ namespace NifOsg
 
         virtual void beginOperate(osgParticle::Program* program);
         virtual void operate(osgParticle::Particle* particle, double dt);
+        virtual void operateParticles(osgParticle::ParticleSystem* ps, double dt);
 
     private:
         float mBounceFactor;
@@ -122,6 +144,7 @@ namespace NifOsg
 
         virtual void beginOperate(osgParticle::Program* program);
         virtual void operate(osgParticle::Particle* particle, double dt);
+        virtual void operateParticles(osgParticle::ParticleSystem* ps, double dt);
     private:
         float mBounceFactor;
         osg::BoundingSphere mSphere;
@@ -139,6 +162,7 @@ namespace NifOsg
 
         virtual void beginOperate(osgParticle::Program* program);
         virtual void operate(osgParticle::Particle* particle, double dt);
+        virtual void operateParticles(osgParticle::ParticleSystem* ps, double dt);
 
     private:
         float mGrowTime;
@@ -158,6 +182,7 @@ namespace NifOsg
         META_Object(NifOsg, ParticleColorAffector)
 
         virtual void operate(osgParticle::Particle* particle, double dt);
+        virtual void operateParticles(osgParticle::ParticleSystem* ps, double dt);
 
     private:
         Vec4Interpolator mData;
@@ -173,6 +198,7 @@ namespace NifOsg
         META_Object(NifOsg, GravityAffector)
 
         virtual void operate(osgParticle::Particle* particle, double dt);
+        virtual void operateParticles(osgParticle::ParticleSystem* ps, double dt);
         virtual void beginOperate(osgParticle::Program *);
 
     private:
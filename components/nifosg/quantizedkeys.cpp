@@ -0,0 +1,124 @@
+#include "quantizedkeys.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+    const float sMaxSmallComponent = 0.70710678f; // 1/sqrt(2), the largest value the three smaller components can have
+    const float sSmallComponentSteps = 32767.f; // 15 bits per component, the top bit of each value is used for the index
+
+    std::uint16_t encodeSmallComponent(float value)
+    {
+        float normalized = (std::min(sMaxSmallComponent, std::max(-sMaxSmallComponent, value)) / sMaxSmallComponent + 1.f) * 0.5f;
+        return static_cast<std::uint16_t>(std::lround(normalized * sSmallComponentSteps));
+    }
+
+    float decodeSmallComponent(std::uint16_t value)
+    {
+        return ((value & 0x7fff) / sSmallComponentSteps * 2.f - 1.f) * sMaxSmallComponent;
+    }
+}
+
+namespace NifOsg
+{
+
+    void QuantizedQuaternionKeyMap::addKey(float time, const osg::Quat &value)
+    {
+        osg::Quat quat = value;
+        double length = quat.length();
+        if (length > 0)
+            quat /= length;
+
+        int largest = 0;
+        for (int i=1; i<4; ++i)
+            if (std::abs(quat[i]) > std::abs(quat[largest]))
+                largest = i;
+
+        // q and -q are the same rotation, flip the sign so that the dropped component is positive
+        if (quat[largest] < 0)
+            quat = -quat;
+
+        std::uint16_t packed[3];
+        for (int i=0, j=0; i<4; ++i)
+        {
+            if (i != largest)
+                packed[j++] = encodeSmallComponent(static_cast<float>(quat[i]));
+        }
+
+        // store the two bit index of the dropped component in the top bits of the first two values
+        packed[0] |= static_cast<std::uint16_t>((largest & 0x1) << 15);
+        packed[1] |= static_cast<std::uint16_t>((largest & 0x2) << 14);
+
+        mTimes.push_back(time);
+        mValues.insert(mValues.end(), packed, packed+3);
+    }
+
+    osg::Quat QuantizedQuaternionKeyMap::getValue(size_t index) const
+    {
+        const std::uint16_t* packed = &mValues[index * 3];
+        int largest = (packed[0] >> 15) | ((packed[1] >> 14) & 0x2);
+
+        float small[3];
+        float sumSquares = 0.f;
+        for (int i=0; i<3; ++i)
+        {
+            small[i] = decodeSmallComponent(packed[i]);
+            sumSquares += small[i] * small[i];
+        }
+
+        osg::Quat result;
+        for (int i=0, j=0; i<4; ++i)
+        {
+            if (i == largest)
+                result[i] = std::sqrt(std::max(0.f, 1.f - sumSquares));
+            else
+                result[i] = small[j++];
+        }
+        return result;
+    }
+
+    size_t QuantizedQuaternionKeyMap::getMemoryUsage() const
+    {
+        return sizeof(*this) + mTimes.capacity() * sizeof(float) + mValues.capacity() * sizeof(std::uint16_t);
+    }
+
+    void QuantizedVec3KeyMap::assign(const std::vector<float> &times, const std::vector<osg::Vec3f> &values)
+    {
+        mTimes = times;
+        mValues.clear();
+        mValues.reserve(values.size() * 3);
+        if (values.empty())
+            return;
+
+        osg::Vec3f min = values.front();
+        osg::Vec3f max = values.front();
+        for (const osg::Vec3f& value : values)
+        {
+            for (int i=0; i<3; ++i)
+            {
+                min[i] = std::min(min[i], value[i]);
+                max[i] = std::max(max[i], value[i]);
+            }
+        }
+
+        mMin = min;
+        for (int i=0; i<3; ++i)
+            mScale[i] = (max[i] - min[i]) / 65535.f;
+
+        for (const osg::Vec3f& value : values)
+        {
+            for (int i=0; i<3; ++i)
+            {
+                float step = mScale[i] > 0.f ? std::round((value[i] - min[i]) / mScale[i]) : 0.f;
+                mValues.push_back(static_cast<std::uint16_t>(std::min(65535.f, std::max(0.f, step))));
+            }
+        }
+    }
+
+    size_t QuantizedVec3KeyMap::getMemoryUsage() const
+    {
+        return sizeof(*this) + mTimes.capacity() * sizeof(float) + mValues.capacity() * sizeof(std::uint16_t);
+    }
+
+}
@@ -0,0 +1,65 @@
+#ifndef OPENMW_COMPONENTS_NIFOSG_QUANTIZEDKEYS_H
+#define OPENMW_COMPONENTS_NIFOSG_QUANTIZEDKEYS_H
+
+#include <cstdint>
+#include <vector>
+
+#include <osg/Quat>
+#include <osg/Vec3f>
+
+namespace NifOsg
+{
+
+    /// Rotation track with each key packed into 48 bits using the "smallest three" encoding: the largest quaternion
+    /// component is dropped and recovered from the unit length constraint, the other three are stored as 15 bit values
+    /// in the range [-1/sqrt(2), 1/sqrt(2)], and the index of the dropped component goes into the spare top bits.
+    /// @note Provides the same interface as Nif::KeyMapT for use with ValueInterpolator.
+    struct QuantizedQuaternionKeyMap
+    {
+        typedef osg::Quat ValueType;
+
+        std::vector<float> mTimes;
+        std::vector<std::uint16_t> mValues; // 3 per key
+
+        void addKey(float time, const osg::Quat& value);
+
+        osg::Quat getValue(size_t index) const;
+
+        bool empty() const { return mTimes.empty(); }
+        size_t size() const { return mTimes.size(); }
+
+        size_t getMemoryUsage() const;
+    };
+
+    /// Vector track with each component stored as a 16 bit fraction of the track's bounding box.
+    /// @note Provides the same interface as Nif::KeyMapT for use with ValueInterpolator.
+    struct QuantizedVec3KeyMap
+    {
+        typedef osg::Vec3f ValueType;
+
+        QuantizedVec3KeyMap() : mScale(0.f, 0.f, 0.f) {}
+
+        osg::Vec3f mMin;
+        osg::Vec3f mScale;
+
+        std::vector<float> mTimes;
+        std::vector<std::uint16_t> mValues; // 3 per key
+
+        /// Quantize the given keys. The track's range is computed from all values, so they have to be passed at once.
+        void assign(const std::vector<float>& times, const std::vector<osg::Vec3f>& values);
+
+        osg::Vec3f getValue(size_t index) const
+        {
+            const std::uint16_t* value = &mValues[index * 3];
+            return osg::Vec3f(mMin.x() + value[0] * mScale.x(), mMin.y() + value[1] * mScale.y(), mMin.z() + value[2] * mScale.z());
+        }
+
+        bool empty() const { return mTimes.empty(); }
+        size_t size() const { return mTimes.size(); }
+
+        size_t getMemoryUsage() const;
+    };
+
+}
+
+#endif
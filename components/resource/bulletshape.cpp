@@ -1,11 +1,13 @@
 #include "bulletshape.hpp"
 
+#include <cstring>
 #include <stdexcept>
 #include <string>
 
 #include <BulletCollision/CollisionShapes/btBoxShape.h>
 #include <BulletCollision/CollisionShapes/btScaledBvhTriangleMeshShape.h>
 #include <BulletCollision/CollisionShapes/btCompoundShape.h>
+#include <BulletCollision/CollisionShapes/btOptimizedBvh.h>
 
 namespace Resource
 {
@@ -96,6 +98,49 @@ void BulletShape::setLocalScaling(const btVector3& scale)
         mAvoidCollisionShape->setLocalScaling(scale);
 }
 
+size_t BulletShape::getMemoryUsage() const
+{
+    return getShapeMemoryUsage(mCollisionShape) + getShapeMemoryUsage(mAvoidCollisionShape);
+}
+
+size_t BulletShape::getShapeMemoryUsage(btCollisionShape* shape) const
+{
+    if (shape == nullptr)
+        return 0;
+
+    if (shape->isCompound())
+    {
+        btCompoundShape* compound = static_cast<btCompoundShape*>(shape);
+        size_t size = sizeof(btCompoundShape) + compound->getNumChildShapes() * sizeof(btCompoundShapeChild);
+        for (int i = 0; i < compound->getNumChildShapes(); ++i)
+            size += getShapeMemoryUsage(compound->getChildShape(i));
+        return size;
+    }
+
+    if (btBvhTriangleMeshShape* trishape = dynamic_cast<btBvhTriangleMeshShape*>(shape))
+    {
+        size_t size = sizeof(TriangleMeshShape);
+
+        const btStridingMeshInterface* meshInterface = trishape->getMeshInterface();
+        for (int part = 0; part < meshInterface->getNumSubParts(); ++part)
+        {
+            const unsigned char* vertexBase = nullptr;
+            const unsigned char* indexBase = nullptr;
+            int numVerts = 0, vertexStride = 0, numFaces = 0, indexStride = 0;
+            PHY_ScalarType vertexType, indexType;
+            meshInterface->getLockedReadOnlyVertexIndexBase(&vertexBase, numVerts, vertexType, vertexStride, &indexBase, indexStride, numFaces, indexType, part);
+            size += static_cast<size_t>(numVerts) * vertexStride + static_cast<size_t>(numFaces) * indexStride;
+            meshInterface->unLockReadOnlyVertexBase(part);
+        }
+
+        if (trishape->getOptimizedBvh())
+            size += trishape->getOptimizedBvh()->calculateSerializeBufferSize();
+        return size;
+    }
+
+    return sizeof(btBoxShape);
+}
+
 osg::ref_ptr<BulletShapeInstance> BulletShape::makeInstance() const
 {
     osg::ref_ptr<BulletShapeInstance> instance (new BulletShapeInstance(this));
@@ -118,4 +163,52 @@ BulletShapeInstance::BulletShapeInstance(osg::ref_ptr<const BulletShape> source)
         mAvoidCollisionShape = duplicateCollisionShape(source->mAvoidCollisionShape);
 }
 
+TriangleMeshShape::~TriangleMeshShape()
+{
+    delete getTriangleInfoMap();
+    delete m_meshInterface;
+
+    if (mSerializedBvh)
+    {
+        // not owned by the base class, see setOptimizedBvh
+        m_bvh->~btOptimizedBvh();
+        m_bvh = nullptr;
+        btAlignedFree(mSerializedBvh);
+    }
+}
+
+bool TriangleMeshShape::setSerializedBvh(const char* data, size_t size)
+{
+    if (m_bvh || size < sizeof(btQuantizedBvh))
+        return false;
+
+    // deserialization requires 16 byte alignment
+    void* buffer = btAlignedAlloc(static_cast<int>(size), 16);
+    std::memcpy(buffer, data, size);
+    btOptimizedBvh* bvh = btOptimizedBvh::deSerializeInPlace(buffer, static_cast<unsigned int>(size), false);
+    if (!bvh)
+    {
+        btAlignedFree(buffer);
+        return false;
+    }
+
+    mSerializedBvh = buffer;
+    setOptimizedBvh(bvh, getLocalScaling());
+    return true;
+}
+
+bool TriangleMeshShape::serializeBvh(std::string& out) const
+{
+    if (!m_bvh)
+        return false;
+
+    unsigned int size = m_bvh->calculateSerializeBufferSize();
+    void* buffer = btAlignedAlloc(static_cast<int>(size), 16);
+    bool serialized = m_bvh->serializeInPlace(buffer, size, false);
+    if (serialized)
+        out.append(static_cast<const char*>(buffer), size);
+    btAlignedFree(buffer);
+    return serialized;
+}
+
 }
@@ -2,6 +2,7 @@
 #define OPENMW_COMPONENTS_RESOURCE_BULLETSHAPE_H
 
 #include <map>
+#include <string>
 
 #include <osg/Object>
 #include <osg/ref_ptr>
@@ -48,9 +49,14 @@ namespace Resource
 
         void setLocalScaling(const btVector3& scale);
 
+        /// Get an estimate of the memory used by the collision shapes in bytes, including triangle meshes and BVHs.
+        size_t getMemoryUsage() const;
+
     private:
 
         void deleteShape(btCollisionShape* shape);
+
+        size_t getShapeMemoryUsage(btCollisionShape* shape) const;
     };
 
 
@@ -70,14 +76,24 @@ namespace Resource
     {
         TriangleMeshShape(btStridingMeshInterface* meshInterface, bool useQuantizedAabbCompression, bool buildBvh = true)
             : btBvhTriangleMeshShape(meshInterface, useQuantizedAabbCompression, buildBvh)
+            , mSerializedBvh(nullptr)
         {
         }
 
-        virtual ~TriangleMeshShape()
-        {
-            delete getTriangleInfoMap();
-            delete m_meshInterface;
-        }
+        virtual ~TriangleMeshShape();
+
+        /// Use a BVH that was serialized with serializeBvh() instead of building it. Only valid for shapes created without a BVH.
+        /// @note The data is copied, the shape owns the BVH.
+        /// @return False if the data does not hold a valid BVH, in that case the shape still has no BVH.
+        bool setSerializedBvh(const char* data, size_t size);
+
+        /// Append the serialized BVH to \a out, in the native byte order.
+        /// @return False if the shape has no BVH.
+        bool serializeBvh(std::string& out) const;
+
+    private:
+        // The BVH is deserialized in place, so it lives in this buffer
+        void* mSerializedBvh;
     };
 
 
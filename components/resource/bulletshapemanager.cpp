@@ -1,11 +1,17 @@
 #include "bulletshapemanager.hpp"
 
+#include <cstdint>
+#include <cstring>
+#include <sstream>
+#include <vector>
+
 #include <osg/NodeVisitor>
 #include <osg/TriangleFunctor>
 #include <osg/Transform>
 #include <osg/Drawable>
 #include <osg/Version>
 
+#include <BulletCollision/CollisionShapes/btCompoundShape.h>
 #include <BulletCollision/CollisionShapes/btTriangleMesh.h>
 
 #include <components/vfs/manager.hpp>
@@ -13,11 +19,93 @@
 #include <components/nifbullet/bulletnifloader.hpp>
 
 #include "bulletshape.hpp"
+#include "diskcache.hpp"
 #include "scenemanager.hpp"
 #include "niffilemanager.hpp"
 #include "objectcache.hpp"
 #include "multiobjectcache.hpp"
 
+namespace
+{
+    /// Bump when changing anything about the way collision shapes or their cached BVHs are produced.
+    const unsigned int sDiskCacheVersion = 1;
+
+    std::string readAll(std::istream& stream)
+    {
+        std::ostringstream buffer;
+        buffer << stream.rdbuf();
+        return buffer.str();
+    }
+
+    /// Collect the triangle mesh shapes that still need a BVH, in a stable order.
+    void getShapesWithoutBvh(btCollisionShape* shape, std::vector<Resource::TriangleMeshShape*>& out)
+    {
+        if (!shape)
+            return;
+
+        if (shape->isCompound())
+        {
+            btCompoundShape* compound = static_cast<btCompoundShape*>(shape);
+            for (int i = 0; i < compound->getNumChildShapes(); ++i)
+                getShapesWithoutBvh(compound->getChildShape(i), out);
+        }
+        else if (Resource::TriangleMeshShape* trishape = dynamic_cast<Resource::TriangleMeshShape*>(shape))
+        {
+            if (!trishape->getOptimizedBvh())
+                out.push_back(trishape);
+        }
+    }
+
+    void appendUInt32(std::string& out, std::uint32_t value)
+    {
+        out.append(reinterpret_cast<const char*>(&value), sizeof(value));
+    }
+
+    bool readUInt32(const std::string& data, size_t& offset, std::uint32_t& value)
+    {
+        if (data.size() - offset < sizeof(value))
+            return false;
+        std::memcpy(&value, data.data() + offset, sizeof(value));
+        offset += sizeof(value);
+        return true;
+    }
+
+    // Layout: number of shapes, followed by the size and data of each serialized BVH
+    std::string serializeBvhs(const std::vector<Resource::TriangleMeshShape*>& shapes)
+    {
+        std::string out;
+        appendUInt32(out, static_cast<std::uint32_t>(shapes.size()));
+        for (const Resource::TriangleMeshShape* shape : shapes)
+        {
+            std::string bvh;
+            shape->serializeBvh(bvh);
+            appendUInt32(out, static_cast<std::uint32_t>(bvh.size()));
+            out += bvh;
+        }
+        return out;
+    }
+
+    /// @return False if the data does not match the shapes, some of them may have been assigned a BVH anyway.
+    bool deserializeBvhs(const std::string& data, const std::vector<Resource::TriangleMeshShape*>& shapes)
+    {
+        size_t offset = 0;
+        std::uint32_t count = 0;
+        if (!readUInt32(data, offset, count) || count != shapes.size())
+            return false;
+
+        for (Resource::TriangleMeshShape* shape : shapes)
+        {
+            std::uint32_t size = 0;
+            if (!readUInt32(data, offset, size) || data.size() - offset < size)
+                return false;
+            if (!shape->setSerializedBvh(data.data() + offset, size))
+                return false;
+            offset += size;
+        }
+        return offset == data.size();
+    }
+}
+
 namespace Resource
 {
 
@@ -125,10 +213,7 @@ osg::ref_ptr<const BulletShape> BulletShapeManager::getShape(const std::string &
             ext = normalized.substr(extPos+1);
 
         if (ext == "nif")
-        {
-            NifBullet::BulletNifLoader loader;
-            shape = loader.load(*mNifFileManager->get(normalized));
-        }
+            shape = loadNif(normalized);
         else
         {
             // TODO: support .bullet shape files
@@ -142,11 +227,57 @@ osg::ref_ptr<const BulletShape> BulletShapeManager::getShape(const std::string &
                 return osg::ref_ptr<BulletShape>();
         }
 
-        mCache->addEntryToObjectCache(normalized, shape);
+        mCache->addEntryToObjectCache(normalized, shape, 0.0, shape->getMemoryUsage());
+    }
+    return shape;
+}
+
+osg::ref_ptr<BulletShape> BulletShapeManager::loadNif(const std::string &normalized)
+{
+    Nif::NIFFilePtr file = mNifFileManager->get(normalized);
+    NifBullet::BulletNifLoader loader;
+    if (!mDiskCache)
+        return loader.load(*file);
+
+    // Building the BVHs is the expensive part, so only these are cached, the shapes are still created from the NIF
+    osg::ref_ptr<BulletShape> shape = loader.load(*file, false);
+    std::vector<TriangleMeshShape*> shapes;
+    getShapesWithoutBvh(shape->mCollisionShape, shapes);
+    getShapesWithoutBvh(shape->mAvoidCollisionShape, shapes);
+    if (shapes.empty())
+        return shape;
+
+    // The source data is part of the key, so that modified files don't pick up stale entries.
+    // The serialized BVHs are in the native memory layout, so the layout is part of the key as well.
+    DiskCacheKey key;
+    key.add(sDiskCacheVersion)
+       .add(btGetVersion())
+       .add(static_cast<unsigned int>(sizeof(btScalar)))
+       .add(static_cast<unsigned int>(sizeof(void*)))
+       .add(normalized)
+       .add(readAll(*mVFS->get(normalized)));
+
+    std::string data;
+    if (mDiskCache->read(key, data) && deserializeBvhs(data, shapes))
+        return shape;
+
+    for (TriangleMeshShape* trishape : shapes)
+    {
+        if (!trishape->getOptimizedBvh())
+            trishape->buildOptimizedBvh();
     }
+    mDiskCache->write(key, serializeBvhs(shapes));
     return shape;
 }
 
+void BulletShapeManager::setDiskCachePath(const std::string &path)
+{
+    if (path.empty())
+        mDiskCache.reset();
+    else
+        mDiskCache.reset(new DiskCache(path));
+}
+
 osg::ref_ptr<BulletShapeInstance> BulletShapeManager::cacheInstance(const std::string &name)
 {
     std::string normalized = name;
@@ -196,6 +327,7 @@ void BulletShapeManager::clearCache()
 void BulletShapeManager::reportStats(unsigned int frameNumber, osg::Stats *stats) const
 {
     stats->setAttribute(frameNumber, "Shape", mCache->getCacheSize());
+    stats->setAttribute(frameNumber, "Shape KiB", mCache->getMemoryUsage() / 1024.0);
     stats->setAttribute(frameNumber, "Shape Instance", mInstanceCache->getCacheSize());
 }
 
@@ -2,6 +2,7 @@
 #define OPENMW_COMPONENTS_BULLETSHAPEMANAGER_H
 
 #include <map>
+#include <memory>
 #include <string>
 
 #include <osg/ref_ptr>
@@ -18,6 +19,7 @@ namespace Resource
     class BulletShapeInstance;
 
     class MultiObjectCache;
+    class DiskCache;
 
     /// Handles loading, caching and "instancing" of bullet shapes.
     /// A shape 'instance' is a clone of another shape, with the goal of setting a different scale on this instance.
@@ -39,6 +41,10 @@ namespace Resource
         /// @note May return a null pointer if the object has no shape.
         osg::ref_ptr<BulletShapeInstance> getInstance(const std::string& name);
 
+        /// Store the BVHs of NIF collision shapes in the given directory and load them from there instead of building them
+        /// in later sessions. Pass an empty path to disable the disk cache (the default).
+        void setDiskCachePath(const std::string& path);
+
         /// @see ResourceManager::updateCache
         virtual void updateCache(double referenceTime);
 
@@ -49,9 +55,13 @@ namespace Resource
     private:
         osg::ref_ptr<BulletShapeInstance> createInstance(const std::string& name);
 
+        osg::ref_ptr<BulletShape> loadNif(const std::string& normalized);
+
         osg::ref_ptr<MultiObjectCache> mInstanceCache;
         SceneManager* mSceneManager;
         NifFileManager* mNifFileManager;
+
+        std::unique_ptr<DiskCache> mDiskCache;
     };
 
 }
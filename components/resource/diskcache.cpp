@@ -0,0 +1,125 @@
+#include "diskcache.hpp"
+
+#include <iomanip>
+#include <sstream>
+
+#include <boost/filesystem/fstream.hpp>
+#include <boost/filesystem/operations.hpp>
+
+#include <components/debug/debuglog.hpp>
+
+namespace Resource
+{
+
+    DiskCacheKey::DiskCacheKey()
+        : mHash(14695981039346656037ull)
+    {
+    }
+
+    DiskCacheKey& DiskCacheKey::add(const void* data, size_t size)
+    {
+        const unsigned char* bytes = static_cast<const unsigned char*>(data);
+        for (size_t i=0; i<size; ++i)
+        {
+            mHash ^= bytes[i];
+            mHash *= 1099511628211ull;
+        }
+        return *this;
+    }
+
+    DiskCacheKey& DiskCacheKey::add(const std::string& value)
+    {
+        // Include the length so that consecutive strings can't alias each other
+        add(static_cast<unsigned int>(value.size()));
+        return add(value.data(), value.size());
+    }
+
+    DiskCacheKey& DiskCacheKey::add(const char* value)
+    {
+        return add(std::string(value));
+    }
+
+    DiskCacheKey& DiskCacheKey::add(bool value)
+    {
+        unsigned char byte = value ? 1 : 0;
+        return add(&byte, 1);
+    }
+
+    DiskCacheKey& DiskCacheKey::add(int value)
+    {
+        return add(&value, sizeof(value));
+    }
+
+    DiskCacheKey& DiskCacheKey::add(unsigned int value)
+    {
+        return add(&value, sizeof(value));
+    }
+
+    DiskCacheKey& DiskCacheKey::add(float value)
+    {
+        return add(&value, sizeof(value));
+    }
+
+    std::string DiskCacheKey::toString() const
+    {
+        std::ostringstream stream;
+        stream << std::hex << std::setw(16) << std::setfill('0') << mHash;
+        return stream.str();
+    }
+
+    DiskCache::DiskCache(const boost::filesystem::path& directory)
+        : mDirectory(directory)
+    {
+    }
+
+    bool DiskCache::read(const DiskCacheKey& key, std::string& data) const
+    {
+        boost::filesystem::path path = mDirectory / key.toString();
+
+        boost::filesystem::ifstream stream(path, std::ios::binary);
+        if (!stream.is_open())
+            return false;
+
+        std::ostringstream buffer;
+        buffer << stream.rdbuf();
+        if (stream.bad())
+        {
+            Log(Debug::Warning) << "Failed to read cache entry " << path;
+            return false;
+        }
+
+        data = buffer.str();
+        return true;
+    }
+
+    bool DiskCache::contains(const DiskCacheKey& key) const
+    {
+        boost::system::error_code ec;
+        return boost::filesystem::is_regular_file(mDirectory / key.toString(), ec);
+    }
+
+    void DiskCache::write(const DiskCacheKey& key, const std::string& data) const
+    {
+        // Write to a temporary file first, so concurrent readers never see a partially written entry
+        boost::filesystem::path path = mDirectory / key.toString();
+        boost::filesystem::path tempPath = mDirectory / (key.toString() + "-" + boost::filesystem::unique_path().string() + ".tmp");
+        try
+        {
+            boost::filesystem::create_directories(mDirectory);
+            {
+                boost::filesystem::ofstream stream(tempPath, std::ios::binary);
+                stream.write(data.data(), data.size());
+                if (stream.fail())
+                    throw std::runtime_error("write operation failed");
+            }
+            boost::filesystem::rename(tempPath, path);
+        }
+        catch (std::exception& e)
+        {
+            boost::system::error_code ec;
+            boost::filesystem::remove(tempPath, ec);
+            Log(Debug::Warning) << "Failed to write cache entry " << key.toString() << " to " << mDirectory << ": " << e.what();
+        }
+    }
+
+}
@@ -0,0 +1,64 @@
+#ifndef OPENMW_COMPONENTS_RESOURCE_DISKCACHE_H
+#define OPENMW_COMPONENTS_RESOURCE_DISKCACHE_H
+
+#include <cstdint>
+#include <string>
+
+#include <boost/filesystem/path.hpp>
+
+namespace Resource
+{
+
+    /// @brief Builds a cache key out of everything a cached result depends on (source path, source data, settings).
+    /// @note Uses 64-bit FNV-1a, which is fast and good enough to detect changes, but is not a cryptographic hash.
+    class DiskCacheKey
+    {
+    public:
+        DiskCacheKey();
+
+        DiskCacheKey& add(const void* data, size_t size);
+        DiskCacheKey& add(const std::string& value);
+        DiskCacheKey& add(const char* value);
+        DiskCacheKey& add(bool value);
+        DiskCacheKey& add(int value);
+        DiskCacheKey& add(unsigned int value);
+        DiskCacheKey& add(float value);
+
+        uint64_t getHash() const { return mHash; }
+
+        /// Hexadecimal representation of the hash, usable as a file name.
+        std::string toString() const;
+
+    private:
+        uint64_t mHash;
+    };
+
+    /// @brief Persistent storage for resources derived from game data, so they don't have to be regenerated in later sessions.
+    /// @par Entries are plain files named after their key. The cache does not care about the content format.
+    /// @note Thread safe, multiple threads may read and write entries concurrently.
+    class DiskCache
+    {
+    public:
+        /// @param directory Where to store the entries. Created on the first write if it does not exist.
+        DiskCache(const boost::filesystem::path& directory);
+
+        /// Read the entry for \a key into \a data.
+        /// @return false if there is no such entry or it could not be read.
+        bool read(const DiskCacheKey& key, std::string& data) const;
+
+        /// Check if there is an entry for \a key, without reading it.
+        bool contains(const DiskCacheKey& key) const;
+
+        /// Store \a data as the entry for \a key, replacing an existing entry.
+        /// @note Errors are logged and otherwise ignored, the cache is only an optimization.
+        void write(const DiskCacheKey& key, const std::string& data) const;
+
+        const boost::filesystem::path& getDirectory() const { return mDirectory; }
+
+    private:
+        boost::filesystem::path mDirectory;
+    };
+
+}
+
+#endif
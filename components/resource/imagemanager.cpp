@@ -1,11 +1,21 @@
 #include "imagemanager.hpp"
 
+#include <algorithm>
 #include <cassert>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+
+#include <osg/GraphicsContext>
+#include <osg/OperationThread>
+#include <osg/ValueObject>
 #include <osgDB/Registry>
 
 #include <components/debug/debuglog.hpp>
+#include <components/sceneutil/workqueue.hpp>
 #include <components/vfs/manager.hpp>
 
+#include "memoryusage.hpp"
 #include "objectcache.hpp"
 
 #ifdef OSG_LIBRARY_STATIC
@@ -39,6 +49,177 @@ namespace
         return warningImage;
     }
 
+    std::string getFileExtension(const std::string& file)
+    {
+        size_t extPos = file.find_last_of('.');
+        if (extPos != std::string::npos && extPos+1 < file.size())
+            return file.substr(extPos+1);
+        return std::string();
+    }
+
+    /// Distance passed to ImageManager::getImage by the current thread, see ImageManager::DistanceHint
+    thread_local float sDistanceHint = 0.f;
+
+    /// User value set on images that are still previews, see ImageManager::isPreview
+    const std::string sPreviewUserValue = "ProgressivePreview";
+
+    std::uint32_t readUInt32(const unsigned char* data)
+    {
+        return data[0] | (data[1] << 8) | (data[2] << 16) | (static_cast<std::uint32_t>(data[3]) << 24);
+    }
+
+    std::uint32_t makeFourCC(char a, char b, char c, char d)
+    {
+        return static_cast<std::uint32_t>(a) | (b << 8) | (c << 16) | (static_cast<std::uint32_t>(d) << 24);
+    }
+
+    /// Check whether any DXT1 block uses the transparent color, like the "dds_dxt1_detect_rgba" option of the DDS plugin.
+    bool hasDXT1Alpha(const unsigned char* data, size_t size)
+    {
+        for (size_t block = 0; block + 8 <= size; block += 8)
+        {
+            unsigned int color0 = data[block] | (data[block+1] << 8);
+            unsigned int color1 = data[block+2] | (data[block+3] << 8);
+            if (color0 > color1)
+                continue;
+            std::uint32_t indices = readUInt32(data + block + 4);
+            for (int i = 0; i < 16; ++i)
+                if (((indices >> (2 * i)) & 0x3) == 0x3)
+                    return true;
+        }
+        return false;
+    }
+
+    /// Read the mipmaps of a DXT compressed DDS image that are no larger than maxSize, so that a lower resolution version
+    /// of the image is available without reading the whole file.
+    /// @return nullptr if the image has no such mipmaps or uses a format that is not supported here.
+    osg::ref_ptr<osg::Image> readDDSPreview(std::istream& stream, unsigned int maxSize)
+    {
+        // see https://docs.microsoft.com/en-us/windows/win32/direct3ddds/dds-header
+        const size_t headerSize = 124;
+        const std::uint32_t ddsdMipmapCount = 0x20000;
+        const std::uint32_t ddpfFourCC = 0x4;
+
+        unsigned char header[4 + headerSize];
+        if (!stream.read(reinterpret_cast<char*>(header), sizeof(header)) || std::memcmp(header, "DDS ", 4) != 0
+                || readUInt32(header + 4) != headerSize)
+            return nullptr;
+
+        const unsigned char* fields = header + 4;
+        const std::uint32_t flags = readUInt32(fields + 1*4);
+        const unsigned int height = readUInt32(fields + 2*4);
+        const unsigned int width = readUInt32(fields + 3*4);
+        const unsigned int mipmapCount = readUInt32(fields + 6*4);
+        const std::uint32_t pixelFormatFlags = readUInt32(fields + 19*4);
+        const std::uint32_t fourCC = readUInt32(fields + 20*4);
+        const std::uint32_t caps2 = readUInt32(fields + 27*4);
+
+        // no cube maps or volume textures
+        if (!(flags & ddsdMipmapCount) || mipmapCount < 2 || caps2 != 0 || !(pixelFormatFlags & ddpfFourCC) || width == 0 || height == 0)
+            return nullptr;
+
+        GLenum pixelFormat;
+        size_t blockSize;
+        if (fourCC == makeFourCC('D', 'X', 'T', '1'))
+        {
+            pixelFormat = GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+            blockSize = 8;
+        }
+        else if (fourCC == makeFourCC('D', 'X', 'T', '3'))
+        {
+            pixelFormat = GL_COMPRESSED_RGBA_S3TC_DXT3_EXT;
+            blockSize = 16;
+        }
+        else if (fourCC == makeFourCC('D', 'X', 'T', '5'))
+        {
+            pixelFormat = GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+            blockSize = 16;
+        }
+        else
+            return nullptr;
+
+        auto getLevelWidth = [&] (unsigned int level) { return std::max(1u, width >> std::min(level, 31u)); };
+        auto getLevelHeight = [&] (unsigned int level) { return std::max(1u, height >> std::min(level, 31u)); };
+        auto getLevelSize = [&] (unsigned int level) { return ((getLevelWidth(level) + 3) / 4) * ((getLevelHeight(level) + 3) / 4) * blockSize; };
+
+        unsigned int firstLevel = 0;
+        while (firstLevel < mipmapCount && std::max(getLevelWidth(firstLevel), getLevelHeight(firstLevel)) > maxSize)
+            ++firstLevel;
+        // nothing to gain if the image is small already, and the mipmap chain has to reach the preview size
+        if (firstLevel == 0 || firstLevel == mipmapCount)
+            return nullptr;
+
+        size_t offset = sizeof(header);
+        for (unsigned int level = 0; level < firstLevel; ++level)
+            offset += getLevelSize(level);
+
+        size_t dataSize = 0;
+        osg::Image::MipmapDataType mipmapOffsets;
+        for (unsigned int level = firstLevel; level < mipmapCount; ++level)
+        {
+            if (level != firstLevel)
+                mipmapOffsets.push_back(dataSize);
+            dataSize += getLevelSize(level);
+        }
+
+        std::unique_ptr<unsigned char[]> data (new unsigned char[dataSize]);
+        if (!stream.seekg(offset) || !stream.read(reinterpret_cast<char*>(data.get()), dataSize))
+            return nullptr;
+
+        if (pixelFormat == GL_COMPRESSED_RGB_S3TC_DXT1_EXT && hasDXT1Alpha(data.get(), dataSize))
+            pixelFormat = GL_COMPRESSED_RGBA_S3TC_DXT1_EXT;
+
+        osg::ref_ptr<osg::Image> image (new osg::Image);
+        image->setImage(getLevelWidth(firstLevel), getLevelHeight(firstLevel), 1, pixelFormat, pixelFormat, GL_UNSIGNED_BYTE,
+                        data.release(), osg::Image::USE_NEW_DELETE);
+        image->setMipmapLevels(mipmapOffsets);
+        // match the "dds_flip" option used for loading the full image
+        image->flipVertical();
+        return image;
+    }
+
+    /// Replace the data of an image with the data of another one. Runs as an operation of the graphics context, so that
+    /// the data does not change while the image is being drawn or uploaded.
+    class SwapImageDataOperation : public osg::Operation
+    {
+    public:
+        SwapImageDataOperation(osg::Image* target, osg::Image* source)
+            : osg::Operation("SwapImageDataOperation", false)
+            , mTarget(target)
+            , mSource(source)
+        {
+        }
+
+        void operator()(osg::Object*) override
+        {
+            osg::Image& source = *mSource;
+            unsigned char* data = source.data();
+            osg::Image::AllocationMode mode = source.getAllocationMode();
+            if (mode == osg::Image::USE_NEW_DELETE || mode == osg::Image::USE_MALLOC_FREE)
+            {
+                // hand the data over, the source image is not used anymore
+                source.setAllocationMode(osg::Image::NO_DELETE);
+            }
+            else
+            {
+                size_t size = source.getTotalSizeInBytesIncludingMipmaps();
+                data = new unsigned char[size];
+                std::memcpy(data, source.data(), size);
+                mode = osg::Image::USE_NEW_DELETE;
+            }
+
+            mTarget->setImage(source.s(), source.t(), source.r(), source.getInternalTextureFormat(), source.getPixelFormat(),
+                              source.getDataType(), data, mode, source.getPacking());
+            mTarget->setMipmapLevels(source.getMipmapLevels());
+            mTarget->setUserValue(sPreviewUserValue, false);
+            mTarget->dirty();
+        }
+
+    private:
+        osg::ref_ptr<osg::Image> mTarget;
+        osg::ref_ptr<osg::Image> mSource;
+    };
+
 }
 
 namespace Resource
@@ -48,12 +229,21 @@ namespace Resource
         : ResourceManager(vfs)
         , mWarningImage(createWarningImage())
         , mOptions(new osgDB::Options("dds_flip dds_dxt1_detect_rgba"))
+        , mPreviewSize(64)
     {
     }
 
     ImageManager::~ImageManager()
     {
-
+        osg::ref_ptr<StreamImagesWorkItem> item;
+        {
+            OpenThreads::ScopedLock<OpenThreads::Mutex> lock(mPendingImagesMutex);
+            mPendingImages.clear();
+            item = mStreamImagesWorkItem;
+        }
+        // a dropped item never completes, so only wait while the queue is still processing items
+        if (item && mWorkQueue.valid())
+            item->waitTillDone();
     }
 
     bool checkSupported(osg::Image* image, const std::string& filename)
@@ -81,80 +271,233 @@ namespace Resource
         return true;
     }
 
+    ImageManager::DistanceHint::DistanceHint(float distance)
+        : mPreviousDistance(sDistanceHint)
+    {
+        sDistanceHint = distance;
+    }
+
+    ImageManager::DistanceHint::~DistanceHint()
+    {
+        sDistanceHint = mPreviousDistance;
+    }
+
+    /// Worker thread item: load the full images of previews, nearest first, until there are none left.
+    class ImageManager::StreamImagesWorkItem : public SceneUtil::WorkItem
+    {
+    public:
+        StreamImagesWorkItem(ImageManager* imageManager)
+            : mImageManager(imageManager)
+        {
+        }
+
+        virtual void doWork()
+        {
+            osg::ref_ptr<osg::Image> preview;
+            while (mImageManager->takePendingImage(preview))
+            {
+                // no longer used or cached, don't bother
+                if (preview->referenceCount() == 1)
+                    continue;
+
+                osg::ref_ptr<osg::Image> full = mImageManager->loadImage(preview->getFileName());
+                if (full)
+                    mImageManager->swapInFullImage(preview, full);
+            }
+        }
+
+    private:
+        ImageManager* mImageManager;
+    };
+
+    void ImageManager::setProgressiveLoading(SceneUtil::WorkQueue *workQueue, osg::GraphicsContext *context, unsigned int previewSize)
+    {
+        mWorkQueue = workQueue;
+        mGraphicsContext = context;
+        mPreviewSize = previewSize;
+    }
+
     osg::ref_ptr<osg::Image> ImageManager::getImage(const std::string &filename)
+    {
+        return getImage(filename, sDistanceHint);
+    }
+
+    osg::ref_ptr<osg::Image> ImageManager::getImage(const std::string &filename, float distance)
     {
         std::string normalized = filename;
         mVFS->normalizeFilename(normalized);
 
         osg::ref_ptr<osg::Object> obj = mCache->getRefFromObjectCache(normalized);
         if (obj)
-            return osg::ref_ptr<osg::Image>(static_cast<osg::Image*>(obj.get()));
-        else
         {
-            Files::IStreamPtr stream;
-            try
+            osg::ref_ptr<osg::Image> image (static_cast<osg::Image*>(obj.get()));
+            if (mWorkQueue.valid())
             {
-                stream = mVFS->get(normalized.c_str());
+                // move up in the queue if the image is still being streamed in and is now needed closer
+                OpenThreads::ScopedLock<OpenThreads::Mutex> lock(mPendingImagesMutex);
+                auto found = mPendingImages.find(image.get());
+                if (found != mPendingImages.end())
+                    found->second.second = std::min(found->second.second, distance);
             }
-            catch (std::exception& e)
+            return image;
+        }
+
+        if (mWorkQueue.valid() && distance > 0.f)
+        {
+            osg::ref_ptr<osg::Image> preview = loadPreview(normalized);
+            if (preview)
             {
-                Log(Debug::Error) << "Failed to open image: " << e.what();
-                mCache->addEntryToObjectCache(normalized, mWarningImage);
-                return mWarningImage;
+                mCache->addEntryToObjectCache(normalized, preview, 0.0, getImageMemoryUsage(*preview));
+                requestFullImage(preview, distance);
+                return preview;
             }
+        }
+
+        osg::ref_ptr<osg::Image> image = loadImage(normalized);
+        if (!image)
+        {
+            mCache->addEntryToObjectCache(normalized, mWarningImage);
+            return mWarningImage;
+        }
 
-            size_t extPos = normalized.find_last_of('.');
-            std::string ext;
-            if (extPos != std::string::npos && extPos+1 < normalized.size())
-                ext = normalized.substr(extPos+1);
-            osgDB::ReaderWriter* reader = osgDB::Registry::instance()->getReaderWriterForExtension(ext);
-            if (!reader)
+        mCache->addEntryToObjectCache(normalized, image, 0.0, getImageMemoryUsage(*image));
+        return image;
+    }
+
+    osg::ref_ptr<osg::Image> ImageManager::loadImage(const std::string &normalized)
+    {
+        Files::IStreamPtr stream;
+        try
+        {
+            stream = mVFS->get(normalized.c_str());
+        }
+        catch (std::exception& e)
+        {
+            Log(Debug::Error) << "Failed to open image: " << e.what();
+            return nullptr;
+        }
+
+        std::string ext = getFileExtension(normalized);
+        osgDB::ReaderWriter* reader = osgDB::Registry::instance()->getReaderWriterForExtension(ext);
+        if (!reader)
+        {
+            Log(Debug::Error) << "Error loading " << normalized << ": no readerwriter for '" << ext << "' found";
+            return nullptr;
+        }
+
+        osgDB::ReaderWriter::ReadResult result = reader->readImage(*stream, mOptions);
+        if (!result.success())
+        {
+            Log(Debug::Error) << "Error loading " << normalized << ": " << result.message() << " code " << result.status();
+            return nullptr;
+        }
+
+        osg::ref_ptr<osg::Image> image = result.getImage();
+
+        image->setFileName(normalized);
+        if (!checkSupported(image, normalized))
+        {
+            static bool uncompress = (getenv("OPENMW_DECOMPRESS_TEXTURES") != 0);
+            if (!uncompress)
             {
-                Log(Debug::Error) << "Error loading " << filename << ": no readerwriter for '" << ext << "' found";
-                mCache->addEntryToObjectCache(normalized, mWarningImage);
-                return mWarningImage;
+                Log(Debug::Error) << "Error loading " << normalized << ": no S3TC texture compression support installed";
+                return nullptr;
             }
-
-            osgDB::ReaderWriter::ReadResult result = reader->readImage(*stream, mOptions);
-            if (!result.success())
+            else
             {
-                Log(Debug::Error) << "Error loading " << filename << ": " << result.message() << " code " << result.status();
-                mCache->addEntryToObjectCache(normalized, mWarningImage);
-                return mWarningImage;
+                // decompress texture in software if not supported by GPU
+                // requires update to getColor() to be released with OSG 3.6
+                osg::ref_ptr<osg::Image> newImage = new osg::Image;
+                newImage->setFileName(image->getFileName());
+                newImage->allocateImage(image->s(), image->t(), image->r(), image->isImageTranslucent() ? GL_RGBA : GL_RGB, GL_UNSIGNED_BYTE);
+                for (int s=0; s<image->s(); ++s)
+                    for (int t=0; t<image->t(); ++t)
+                        for (int r=0; r<image->r(); ++r)
+                            newImage->setColor(image->getColor(s,t,r), s,t,r);
+                image = newImage;
             }
+        }
+        return image;
+    }
 
-            osg::ref_ptr<osg::Image> image = result.getImage();
+    osg::ref_ptr<osg::Image> ImageManager::loadPreview(const std::string &normalized)
+    {
+        if (getFileExtension(normalized) != "dds")
+            return nullptr;
 
-            image->setFileName(normalized);
-            if (!checkSupported(image, filename))
-            {
-                static bool uncompress = (getenv("OPENMW_DECOMPRESS_TEXTURES") != 0);
-                if (!uncompress)
-                {
-                    Log(Debug::Error) << "Error loading " << filename << ": no S3TC texture compression support installed";
-                    mCache->addEntryToObjectCache(normalized, mWarningImage);
-                    return mWarningImage;
-                }
-                else
-                {
-                    // decompress texture in software if not supported by GPU
-                    // requires update to getColor() to be released with OSG 3.6
-                    osg::ref_ptr<osg::Image> newImage = new osg::Image;
-                    newImage->setFileName(image->getFileName());
-                    newImage->allocateImage(image->s(), image->t(), image->r(), image->isImageTranslucent() ? GL_RGBA : GL_RGB, GL_UNSIGNED_BYTE);
-                    for (int s=0; s<image->s(); ++s)
-                        for (int t=0; t<image->t(); ++t)
-                            for (int r=0; r<image->r(); ++r)
-                                newImage->setColor(image->getColor(s,t,r), s,t,r);
-                    image = newImage;
-                }
-            }
+        osg::ref_ptr<osg::Image> preview;
+        try
+        {
+            Files::IStreamPtr stream = mVFS->get(normalized);
+            preview = readDDSPreview(*stream, mPreviewSize);
+        }
+        catch (std::exception&)
+        {
+            // loading the full image reports the error
+            return nullptr;
+        }
 
-            mCache->addEntryToObjectCache(normalized, image);
-            return image;
+        // formats that need to be decompressed in software are handled by loadImage
+        if (!preview || !checkSupported(preview, normalized))
+            return nullptr;
+
+        preview->setFileName(normalized);
+        preview->setUserValue(sPreviewUserValue, true);
+        return preview;
+    }
+
+    void ImageManager::requestFullImage(osg::Image *preview, float distance)
+    {
+        OpenThreads::ScopedLock<OpenThreads::Mutex> lock(mPendingImagesMutex);
+        auto inserted = mPendingImages.emplace(preview, std::make_pair(osg::ref_ptr<osg::Image>(preview), distance));
+        if (!inserted.second)
+            inserted.first->second.second = std::min(inserted.first->second.second, distance);
+
+        osg::ref_ptr<SceneUtil::WorkQueue> workQueue;
+        if (!mStreamImagesWorkItem && mWorkQueue.lock(workQueue))
+        {
+            mStreamImagesWorkItem = new StreamImagesWorkItem(this);
+            workQueue->addWorkItem(mStreamImagesWorkItem);
         }
     }
 
+    bool ImageManager::takePendingImage(osg::ref_ptr<osg::Image> &preview)
+    {
+        OpenThreads::ScopedLock<OpenThreads::Mutex> lock(mPendingImagesMutex);
+        if (mPendingImages.empty())
+        {
+            // the next request has to start a new work item
+            mStreamImagesWorkItem = nullptr;
+            return false;
+        }
+
+        auto nearest = std::min_element(mPendingImages.begin(), mPendingImages.end(),
+            [] (const PendingImageMap::value_type& lhs, const PendingImageMap::value_type& rhs) { return lhs.second.second < rhs.second.second; });
+        preview = nearest->second.first;
+        mPendingImages.erase(nearest);
+        return true;
+    }
+
+    void ImageManager::swapInFullImage(osg::Image *preview, osg::Image *full)
+    {
+        osg::ref_ptr<osg::GraphicsContext> context;
+        if (!mGraphicsContext.lock(context))
+            return;
+        context->add(new SwapImageDataOperation(preview, full));
+
+        // update the size used for the memory budget
+        const std::string& normalized = preview->getFileName();
+        if (mCache->getRefFromObjectCache(normalized).get() == preview)
+            mCache->addEntryToObjectCache(normalized, preview, 0.0, getImageMemoryUsage(*full));
+    }
+
+    bool ImageManager::isPreview(const osg::Image &image)
+    {
+        bool preview = false;
+        image.getUserValue(sPreviewUserValue, preview);
+        return preview;
+    }
+
     osg::Image *ImageManager::getWarningImage()
     {
         return mWarningImage;
@@ -163,6 +506,7 @@ namespace Resource
     void ImageManager::reportStats(unsigned int frameNumber, osg::Stats *stats) const
     {
         stats->setAttribute(frameNumber, "Image", mCache->getCacheSize());
+        stats->setAttribute(frameNumber, "Image KiB", mCache->getMemoryUsage() / 1024.0);
     }
 
 }
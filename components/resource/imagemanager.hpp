@@ -3,18 +3,32 @@
 
 #include <string>
 #include <map>
+#include <unordered_map>
+
+#include <OpenThreads/Mutex>
 
 #include <osg/ref_ptr>
+#include <osg/observer_ptr>
 #include <osg/Image>
 #include <osg/Texture2D>
 
 #include "resourcemanager.hpp"
 
+namespace osg
+{
+    class GraphicsContext;
+}
+
 namespace osgDB
 {
     class Options;
 }
 
+namespace SceneUtil
+{
+    class WorkQueue;
+}
+
 namespace Resource
 {
 
@@ -28,16 +42,71 @@ namespace Resource
 
         /// Create or retrieve an Image
         /// Returns the dummy image if the given image is not found.
+        /// @note Uses the distance hint of the calling thread, see DistanceHint.
         osg::ref_ptr<osg::Image> getImage(const std::string& filename);
 
+        /// Create or retrieve an Image that is going to be used at the given distance from the camera.
+        /// If progressive loading is enabled and the distance is greater than 0, DDS images with mipmaps initially only contain
+        /// their smallest mipmaps. The full image is then loaded in the background, nearest images first, and swapped in.
+        /// Returns the dummy image if the given image is not found.
+        osg::ref_ptr<osg::Image> getImage(const std::string& filename, float distance);
+
+        /// @brief Sets the distance passed to getImage(filename, distance) for images requested by the current thread through
+        /// getImage(filename), e.g. indirectly while loading meshes.
+        /// @note Restores the previous distance when going out of scope.
+        class DistanceHint
+        {
+        public:
+            explicit DistanceHint(float distance);
+            ~DistanceHint();
+
+        private:
+            float mPreviousDistance;
+        };
+
+        /// Enable progressive loading, see getImage(filename, distance).
+        /// @param workQueue Used to load the full images in the background.
+        /// @param context The full images are swapped in from this context's thread, so that image data never changes while being drawn.
+        /// @param previewSize Maximum width and height of the mipmaps loaded up front.
+        void setProgressiveLoading(SceneUtil::WorkQueue* workQueue, osg::GraphicsContext* context, unsigned int previewSize = 64);
+
+        /// Does the image only contain the smallest mipmaps of its file, because the full image has not been swapped in yet?
+        /// @note Only reliable in the thread of the graphics context passed to setProgressiveLoading.
+        static bool isPreview(const osg::Image& image);
+
         osg::Image* getWarningImage();
 
         void reportStats(unsigned int frameNumber, osg::Stats* stats) const;
 
     private:
+        class StreamImagesWorkItem;
+
+        /// Load the given image completely, returns nullptr if that fails.
+        osg::ref_ptr<osg::Image> loadImage(const std::string& normalized);
+
+        /// Load the smallest mipmaps of a DDS image, returns nullptr if the image is not suitable for progressive loading.
+        osg::ref_ptr<osg::Image> loadPreview(const std::string& normalized);
+
+        void requestFullImage(osg::Image* preview, float distance);
+
+        /// Get the nearest image waiting to be streamed in.
+        /// @return False when there are none left, in that case the StreamImagesWorkItem has to finish.
+        bool takePendingImage(osg::ref_ptr<osg::Image>& preview);
+
+        void swapInFullImage(osg::Image* preview, osg::Image* full);
+
         osg::ref_ptr<osg::Image> mWarningImage;
         osg::ref_ptr<osgDB::Options> mOptions;
 
+        osg::observer_ptr<SceneUtil::WorkQueue> mWorkQueue;
+        osg::observer_ptr<osg::GraphicsContext> mGraphicsContext;
+        unsigned int mPreviewSize;
+
+        OpenThreads::Mutex mPendingImagesMutex;
+        typedef std::unordered_map<osg::Image*, std::pair<osg::ref_ptr<osg::Image>, float> > PendingImageMap; // with distance
+        PendingImageMap mPendingImages;
+        osg::ref_ptr<StreamImagesWorkItem> mStreamImagesWorkItem;
+
         ImageManager(const ImageManager&);
         void operator = (const ImageManager&);
     };
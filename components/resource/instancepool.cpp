@@ -0,0 +1,104 @@
+#include "instancepool.hpp"
+
+#include <osg/Node>
+
+namespace Resource
+{
+
+    void InstancePool::setPoolSize(const std::string &normalized, unsigned int size)
+    {
+        std::vector<osg::ref_ptr<osg::Node> > instancesToRemove;
+        {
+            OpenThreads::ScopedLock<OpenThreads::Mutex> lock(mMutex);
+            if (size == 0)
+            {
+                auto found = mPools.find(normalized);
+                if (found == mPools.end())
+                    return;
+                instancesToRemove.swap(found->second.mInstances);
+                mPools.erase(found);
+            }
+            else
+            {
+                Pool& pool = mPools[normalized];
+                pool.mSize = size;
+                while (pool.mInstances.size() > size)
+                {
+                    instancesToRemove.push_back(pool.mInstances.back());
+                    pool.mInstances.pop_back();
+                }
+            }
+        }
+
+        // note, actual unref happens outside of the lock
+        instancesToRemove.clear();
+    }
+
+    osg::ref_ptr<osg::Node> InstancePool::take(const std::string &normalized)
+    {
+        OpenThreads::ScopedLock<OpenThreads::Mutex> lock(mMutex);
+        auto found = mPools.find(normalized);
+        if (found == mPools.end() || found->second.mInstances.empty())
+            return osg::ref_ptr<osg::Node>();
+
+        osg::ref_ptr<osg::Node> instance = found->second.mInstances.back();
+        found->second.mInstances.pop_back();
+        return instance;
+    }
+
+    bool InstancePool::add(const std::string &normalized, osg::Node *instance)
+    {
+        OpenThreads::ScopedLock<OpenThreads::Mutex> lock(mMutex);
+        auto found = mPools.find(normalized);
+        if (found == mPools.end() || found->second.mInstances.size() >= found->second.mSize)
+            return false;
+
+        found->second.mInstances.push_back(instance);
+        return true;
+    }
+
+    std::vector<std::pair<std::string, unsigned int> > InstancePool::getMissingInstances() const
+    {
+        std::vector<std::pair<std::string, unsigned int> > missing;
+        OpenThreads::ScopedLock<OpenThreads::Mutex> lock(mMutex);
+        for (const auto& pool : mPools)
+        {
+            if (pool.second.mInstances.size() < pool.second.mSize)
+                missing.emplace_back(pool.first, pool.second.mSize - pool.second.mInstances.size());
+        }
+        return missing;
+    }
+
+    void InstancePool::clear()
+    {
+        std::vector<osg::ref_ptr<osg::Node> > instancesToRemove;
+        {
+            OpenThreads::ScopedLock<OpenThreads::Mutex> lock(mMutex);
+            for (auto& pool : mPools)
+            {
+                instancesToRemove.insert(instancesToRemove.end(), pool.second.mInstances.begin(), pool.second.mInstances.end());
+                pool.second.mInstances.clear();
+            }
+        }
+    }
+
+    void InstancePool::releaseGLObjects(osg::State *state)
+    {
+        OpenThreads::ScopedLock<OpenThreads::Mutex> lock(mMutex);
+        for (const auto& pool : mPools)
+        {
+            for (const osg::ref_ptr<osg::Node>& instance : pool.second.mInstances)
+                instance->releaseGLObjects(state);
+        }
+    }
+
+    unsigned int InstancePool::getCacheSize() const
+    {
+        OpenThreads::ScopedLock<OpenThreads::Mutex> lock(mMutex);
+        unsigned int size = 0;
+        for (const auto& pool : mPools)
+            size += pool.second.mInstances.size();
+        return size;
+    }
+
+}
@@ -0,0 +1,63 @@
+#ifndef OPENMW_COMPONENTS_RESOURCE_INSTANCEPOOL_H
+#define OPENMW_COMPONENTS_RESOURCE_INSTANCEPOOL_H
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include <OpenThreads/Mutex>
+
+#include <osg/ref_ptr>
+#include <osg/Referenced>
+
+namespace osg
+{
+    class Node;
+    class State;
+}
+
+namespace Resource
+{
+
+    /// @brief Keeps a configurable number of ready-made instances of selected scene templates, so that frequently spawned
+    /// objects don't have to be cloned at the time they are needed.
+    /// @note Unlike MultiObjectCache, the pooled instances are kept until they are taken out, and the pool can tell which templates need more instances.
+    /// @note Thread safe.
+    class InstancePool : public osg::Referenced
+    {
+    public:
+        /// Set the number of instances to keep for the given template. A size of 0 removes the pool.
+        void setPoolSize(const std::string& normalized, unsigned int size);
+
+        /// Take an instance of the given template out of its pool. Returns nullptr if there is none.
+        osg::ref_ptr<osg::Node> take(const std::string& normalized);
+
+        /// Add an instance of the given template to its pool.
+        /// @return False if there is no pool for that template or it is full already.
+        bool add(const std::string& normalized, osg::Node* instance);
+
+        /// Get the templates whose pools are not full, with the number of missing instances.
+        std::vector<std::pair<std::string, unsigned int> > getMissingInstances() const;
+
+        /// Remove all pooled instances, the pool sizes are kept.
+        void clear();
+
+        void releaseGLObjects(osg::State* state);
+
+        /// Number of pooled instances.
+        unsigned int getCacheSize() const;
+
+    private:
+        struct Pool
+        {
+            unsigned int mSize;
+            std::vector<osg::ref_ptr<osg::Node> > mInstances;
+        };
+
+        std::map<std::string, Pool> mPools;
+        mutable OpenThreads::Mutex mMutex;
+    };
+
+}
+
+#endif
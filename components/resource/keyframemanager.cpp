@@ -9,6 +9,7 @@ namespace Resource
 
     KeyframeManager::KeyframeManager(const VFS::Manager* vfs)
         : ResourceManager(vfs)
+        , mCompressKeyframes(false)
     {
     }
 
@@ -27,18 +28,46 @@ namespace Resource
         else
         {
             osg::ref_ptr<NifOsg::KeyframeHolder> loaded (new NifOsg::KeyframeHolder);
-            NifOsg::Loader::loadKf(Nif::NIFFilePtr(new Nif::NIFFile(mVFS->getNormalized(normalized), normalized)), *loaded.get());
+            NifOsg::KeyframeCompression compression;
+            NifOsg::Loader::loadKf(Nif::NIFFilePtr(new Nif::NIFFile(mVFS->getNormalized(normalized), normalized)), *loaded.get(),
+                                   mCompressKeyframes ? &compression : nullptr);
 
-            mCache->addEntryToObjectCache(normalized, loaded);
+            mCache->addEntryToObjectCache(normalized, loaded, 0.0, loaded->mMemoryUsage);
             return loaded;
         }
     }
 
+    void KeyframeManager::setCompressKeyframes(bool compress)
+    {
+        mCompressKeyframes = compress;
+    }
+
+    namespace
+    {
+        struct SumSavedMemory
+        {
+            SumSavedMemory() : mSavedMemory(0.0) {}
+
+            void operator()(osg::Object* object)
+            {
+                const NifOsg::KeyframeHolder* keyframes = static_cast<const NifOsg::KeyframeHolder*>(object);
+                // may be negative for tiny tracks, which quantization gives a bit of overhead
+                mSavedMemory += static_cast<double>(keyframes->mUncompressedMemoryUsage) - static_cast<double>(keyframes->mMemoryUsage);
+            }
+
+            double mSavedMemory;
+        };
+    }
+
     void KeyframeManager::reportStats(unsigned int frameNumber, osg::Stats *stats) const
     {
         stats->setAttribute(frameNumber, "Keyframe", mCache->getCacheSize());
-    }
 
+        stats->setAttribute(frameNumber, "Keyframe KiB", mCache->getMemoryUsage() / 1024.0);
 
+        SumSavedMemory sum;
+        mCache->call(sum);
+        stats->setAttribute(frameNumber, "Kf Saved KiB", sum.mSavedMemory / 1024.0);
+    }
 
 }
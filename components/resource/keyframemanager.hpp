@@ -23,7 +23,15 @@ namespace Resource
         /// @note Throws an exception if the resource is not found.
         osg::ref_ptr<const NifOsg::KeyframeHolder> get(const std::string& name);
 
+        /// Store keyframe tracks in a quantized form with redundant keys removed, which reduces their memory
+        /// usage at the cost of a small loss of precision.
+        /// @note Only affects keyframes loaded after this call, so it should be set up before any loading starts.
+        void setCompressKeyframes(bool compress);
+
         void reportStats(unsigned int frameNumber, osg::Stats* stats) const;
+
+    private:
+        bool mCompressKeyframes;
     };
 
 }
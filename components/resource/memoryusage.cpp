@@ -0,0 +1,104 @@
+#include "memoryusage.hpp"
+
+#include <set>
+
+#include <osg/Geometry>
+#include <osg/Image>
+#include <osg/NodeVisitor>
+#include <osg/Texture>
+
+namespace
+{
+
+    class MemoryUsageVisitor : public osg::NodeVisitor
+    {
+    public:
+        MemoryUsageVisitor()
+            : osg::NodeVisitor(TRAVERSE_ALL_CHILDREN)
+            , mMemoryUsage(0)
+        {
+        }
+
+        void apply(osg::Node& node) override
+        {
+            mMemoryUsage += sizeof(osg::Group);
+            applyStateSet(node.getStateSet());
+            traverse(node);
+        }
+
+        void apply(osg::Drawable& drawable) override
+        {
+            applyStateSet(drawable.getStateSet());
+
+            osg::Geometry* geometry = drawable.asGeometry();
+            if (!geometry)
+            {
+                mMemoryUsage += sizeof(osg::Drawable);
+                return;
+            }
+
+            mMemoryUsage += sizeof(osg::Geometry);
+
+            osg::Geometry::ArrayList arrays;
+            geometry->getArrayList(arrays);
+            for (const osg::ref_ptr<osg::Array>& array : arrays)
+            {
+                if (mVisited.insert(array.get()).second)
+                    mMemoryUsage += array->getTotalDataSize();
+            }
+
+            for (unsigned int i = 0; i < geometry->getNumPrimitiveSets(); ++i)
+            {
+                const osg::PrimitiveSet* primitiveSet = geometry->getPrimitiveSet(i);
+                if (mVisited.insert(primitiveSet).second)
+                    mMemoryUsage += primitiveSet->getTotalDataSize();
+            }
+        }
+
+        std::size_t getMemoryUsage() const { return mMemoryUsage; }
+
+    private:
+        void applyStateSet(const osg::StateSet* stateset)
+        {
+            if (!stateset || !mVisited.insert(stateset).second)
+                return;
+
+            for (const osg::StateSet::AttributeList& attributes : stateset->getTextureAttributeList())
+            {
+                for (const auto& attribute : attributes)
+                {
+                    const osg::Texture* texture = attribute.second.first->asTexture();
+                    if (!texture)
+                        continue;
+                    for (unsigned int i = 0; i < texture->getNumImages(); ++i)
+                    {
+                        const osg::Image* image = texture->getImage(i);
+                        if (image && image->getFileName().empty() && mVisited.insert(image).second)
+                            mMemoryUsage += Resource::getImageMemoryUsage(*image);
+                    }
+                }
+            }
+        }
+
+        std::size_t mMemoryUsage;
+        std::set<const osg::Referenced*> mVisited;
+    };
+
+}
+
+namespace Resource
+{
+
+    std::size_t getImageMemoryUsage(const osg::Image& image)
+    {
+        return sizeof(osg::Image) + image.getTotalSizeInBytesIncludingMipmaps();
+    }
+
+    std::size_t getNodeMemoryUsage(osg::Node& node)
+    {
+        MemoryUsageVisitor visitor;
+        node.accept(visitor);
+        return visitor.getMemoryUsage();
+    }
+
+}
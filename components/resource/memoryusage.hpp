@@ -0,0 +1,24 @@
+#ifndef OPENMW_COMPONENTS_RESOURCE_MEMORYUSAGE_H
+#define OPENMW_COMPONENTS_RESOURCE_MEMORYUSAGE_H
+
+#include <cstddef>
+
+namespace osg
+{
+    class Image;
+    class Node;
+}
+
+namespace Resource
+{
+
+    /// Estimate the memory used by the pixel data of an image in bytes.
+    std::size_t getImageMemoryUsage(const osg::Image& image);
+
+    /// Estimate the memory used by a scene graph in bytes, counting nodes, vertex arrays, primitive sets and images.
+    /// @note Images that have a file name are owned by the ImageManager and not included.
+    std::size_t getNodeMemoryUsage(osg::Node& node);
+
+}
+
+#endif
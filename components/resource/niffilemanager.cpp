@@ -51,7 +51,7 @@ namespace Resource
         {
             Nif::NIFFilePtr file (new Nif::NIFFile(mVFS->get(name), name));
             obj = new NifFileHolder(file);
-            mCache->addEntryToObjectCache(name, obj);
+            mCache->addEntryToObjectCache(name, obj, 0.0, file->getMemoryUsage());
             return file;
         }
     }
@@ -59,6 +59,7 @@ namespace Resource
     void NifFileManager::reportStats(unsigned int frameNumber, osg::Stats *stats) const
     {
         stats->setAttribute(frameNumber, "Nif", mCache->getCacheSize());
+        stats->setAttribute(frameNumber, "Nif KiB", mCache->getMemoryUsage() / 1024.0);
     }
 
 }
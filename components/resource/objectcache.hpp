@@ -3,6 +3,9 @@
 // - removeExpiredObjectsInCache no longer keeps a lock while the unref happens.
 // - template allows customized KeyType.
 // - objects with uninitialized time stamp are not removed.
+// - objects are spread over hashed shards with separate locks to reduce contention.
+// - updateCache expires objects incrementally, a part of the shards at a time.
+// - optional memory budget, exceeding it removes the least recently used objects.
 
 /* -*-c++-*- OpenSceneGraph - Copyright (C) 1998-2006 Robert Osfield
  *
@@ -23,9 +26,22 @@
 #include <osg/Referenced>
 #include <osg/ref_ptr>
 #include <osg/Node>
+#include <osg/Vec2f>
+#include <osg/Vec4i>
 
+#include <OpenThreads/Mutex>
+#include <OpenThreads/ScopedLock>
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <list>
 #include <string>
-#include <map>
+#include <tuple>
+#include <unordered_map>
+#include <utility>
+#include <vector>
 
 namespace osg
 {
@@ -36,54 +52,148 @@ namespace osg
 
 namespace Resource {
 
+inline void hashCombine(std::size_t& seed, std::size_t value)
+{
+    seed ^= value + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+}
+
+/** Scramble all bits of a hash value (splitmix64 finalizer), for hashes such as std::hash<int> that are the identity.*/
+inline std::uint64_t mixHash(std::uint64_t value)
+{
+    value = (value ^ (value >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    value = (value ^ (value >> 27)) * 0x94d049bb133111ebULL;
+    return value ^ (value >> 31);
+}
+
+/** Get a value for tracking object usage that increases with every call, shared by all object caches so that
+  * usage can be compared between them.*/
+inline std::uint64_t getNextObjectCacheTick()
+{
+    static std::atomic<std::uint64_t> tick(0);
+    return ++tick;
+}
+
+/** An object that could be removed to free memory, see GenericObjectCache::getEvictionCandidates.
+  * Holds the usage tick and the size in bytes of the object.*/
+typedef std::pair<std::uint64_t, std::size_t> EvictionCandidate;
+
+/** Hash function for object cache keys, supports the key types used by the resource managers. */
+template <typename KeyType>
+struct ObjectCacheKeyHash
+{
+    std::size_t operator()(const KeyType& key) const { return std::hash<KeyType>()(key); }
+};
+
+template <>
+struct ObjectCacheKeyHash<osg::Vec2f>
+{
+    std::size_t operator()(const osg::Vec2f& key) const
+    {
+        std::size_t seed = std::hash<float>()(key.x());
+        hashCombine(seed, std::hash<float>()(key.y()));
+        return seed;
+    }
+};
+
+template <>
+struct ObjectCacheKeyHash<osg::Vec4i>
+{
+    std::size_t operator()(const osg::Vec4i& key) const
+    {
+        std::size_t seed = std::hash<int>()(key.x());
+        for (int i=1; i<4; ++i)
+            hashCombine(seed, std::hash<int>()(key[i]));
+        return seed;
+    }
+};
+
+template <typename First, typename Second>
+struct ObjectCacheKeyHash<std::pair<First, Second> >
+{
+    std::size_t operator()(const std::pair<First, Second>& key) const
+    {
+        std::size_t seed = ObjectCacheKeyHash<First>()(key.first);
+        hashCombine(seed, ObjectCacheKeyHash<Second>()(key.second));
+        return seed;
+    }
+};
+
+template <typename... Types>
+struct ObjectCacheKeyHash<std::tuple<Types...> >
+{
+    std::size_t operator()(const std::tuple<Types...>& key) const
+    {
+        return hash(key, std::index_sequence_for<Types...>());
+    }
+
+private:
+    template <std::size_t... Indices>
+    static std::size_t hash(const std::tuple<Types...>& key, std::index_sequence<Indices...>)
+    {
+        std::size_t seed = 0;
+        int expand[] = { 0, (hashCombine(seed, ObjectCacheKeyHash<Types>()(std::get<Indices>(key))), 0)... };
+        (void)expand;
+        return seed;
+    }
+};
+
 template <typename KeyType>
 class GenericObjectCache : public osg::Referenced
 {
     public:
 
         GenericObjectCache()
-            : osg::Referenced(true) {}
+            : osg::Referenced(true)
+            , _memoryBudget(0)
+            , _nextShardToUpdate(0) {}
+
+        /** Set the maximum total size in bytes of the objects in the cache, 0 for no limit.
+          * When adding an object exceeds the limit, the least recently used objects without external references are removed.
+          * The budget is split evenly between the shards, so objects may be removed slightly before the total reaches it.*/
+        void setMemoryBudget(std::size_t bytes)
+        {
+            _memoryBudget = bytes;
+        }
 
         /** For each object in the cache which has an reference count greater than 1
           * (and therefore referenced by elsewhere in the application) set the time stamp
           * for that object in the cache to specified time.
-          * This would typically be called once per frame by applications which are doing database paging,
-          * and need to prune objects that are no longer required.
           * The time used should be taken from the FrameStamp::getReferenceTime().*/
         void updateTimeStampOfObjectsInCacheWithExternalReferences(double referenceTime)
         {
-            // look for objects with external references and update their time stamp.
-            OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_objectCacheMutex);
-            for(typename ObjectCacheMap::iterator itr=_objectCache.begin(); itr!=_objectCache.end(); ++itr)
+            for (Shard& shard : _shards)
             {
-                // If ref count is greater than 1, the object has an external reference.
-                // If the timestamp is yet to be initialized, it needs to be updated too.
-                if (itr->second.first->referenceCount()>1 || itr->second.second == 0.0)
-                    itr->second.second = referenceTime;
+                OpenThreads::ScopedLock<OpenThreads::Mutex> lock(shard._mutex);
+                updateTimeStamps(shard, referenceTime);
             }
         }
 
-        /** Removed object in the cache which have a time stamp at or before the specified expiry time.
-          * This would typically be called once per frame by applications which are doing database paging,
-          * and need to prune objects that are no longer required, and called after the a called
-          * after the call to updateTimeStampOfObjectsInCacheWithExternalReferences(expirtyTime).*/
+        /** Removed object in the cache which have a time stamp at or before the specified expiry time.*/
         void removeExpiredObjectsInCache(double expiryTime)
         {
             std::vector<osg::ref_ptr<osg::Object> > objectsToRemove;
+            for (Shard& shard : _shards)
             {
-                OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_objectCacheMutex);
-                // Remove expired entries from object cache
-                typename ObjectCacheMap::iterator oitr = _objectCache.begin();
-                while(oitr != _objectCache.end())
-                {
-                    if (oitr->second.second<=expiryTime)
-                    {
-                        objectsToRemove.push_back(oitr->second.first);
-                        _objectCache.erase(oitr++);
-                    }
-                    else
-                        ++oitr;
-                }
+                OpenThreads::ScopedLock<OpenThreads::Mutex> lock(shard._mutex);
+                removeExpired(shard, expiryTime, objectsToRemove);
+            }
+            // note, actual unref happens outside of the lock
+            objectsToRemove.clear();
+        }
+
+        /** Update the time stamps of objects with external references and remove expired objects, as done by
+          * updateTimeStampOfObjectsInCacheWithExternalReferences and removeExpiredObjectsInCache, for a part of the shards.
+          * Consecutive calls move on to the next shards, so the whole cache is covered every sNumShards/sShardsPerUpdate calls.
+          * This would typically be called periodically by applications which are doing database paging.*/
+        void updateCache(double referenceTime, double expiryTime)
+        {
+            std::vector<osg::ref_ptr<osg::Object> > objectsToRemove;
+            for (unsigned int i = 0; i < sShardsPerUpdate; ++i)
+            {
+                Shard& shard = _shards[_nextShardToUpdate++ % sNumShards];
+                OpenThreads::ScopedLock<OpenThreads::Mutex> lock(shard._mutex);
+                updateTimeStamps(shard, referenceTime);
+                removeExpired(shard, expiryTime, objectsToRemove);
             }
             // note, actual unref happens outside of the lock
             objectsToRemove.clear();
@@ -92,43 +202,113 @@ class GenericObjectCache : public osg::Referenced
         /** Remove all objects in the cache regardless of having external references or expiry times.*/
         void clear()
         {
-            OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_objectCacheMutex);
-            _objectCache.clear();
+            std::vector<osg::ref_ptr<osg::Object> > objectsToRemove;
+            for (Shard& shard : _shards)
+            {
+                OpenThreads::ScopedLock<OpenThreads::Mutex> lock(shard._mutex);
+                for (typename ItemMap::iterator itr = shard._items.begin(); itr != shard._items.end(); ++itr)
+                    objectsToRemove.push_back(itr->second._object);
+                shard._items.clear();
+                shard._lru.clear();
+                shard._size = 0;
+            }
+            objectsToRemove.clear();
         }
 
-        /** Add a key,object,timestamp triple to the Registry::ObjectCache.*/
-        void addEntryToObjectCache(const KeyType& key, osg::Object* object, double timestamp = 0.0)
+        /** Add a key,object,timestamp triple to the Registry::ObjectCache.
+          * @param size Estimated memory used by the object in bytes, counted against the memory budget.*/
+        void addEntryToObjectCache(const KeyType& key, osg::Object* object, double timestamp = 0.0, std::size_t size = 0)
         {
-            OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_objectCacheMutex);
-            _objectCache[key]=ObjectTimeStampPair(object,timestamp);
+            std::vector<osg::ref_ptr<osg::Object> > objectsToRemove;
+            {
+                Shard& shard = getShard(key);
+                OpenThreads::ScopedLock<OpenThreads::Mutex> lock(shard._mutex);
+                std::pair<typename ItemMap::iterator, bool> inserted = shard._items.emplace(key, Item());
+                Item& item = inserted.first->second;
+                if (inserted.second)
+                {
+                    shard._lru.push_front(&inserted.first->first);
+                    item._lruPosition = shard._lru.begin();
+                }
+                else
+                {
+                    objectsToRemove.push_back(item._object);
+                    shard._size -= item._size;
+                    touch(shard, item);
+                }
+                item._object = object;
+                item._lastUsed = getNextObjectCacheTick();
+                item._timeStamp = timestamp;
+                item._size = size;
+                shard._size += size;
+
+                evictLeastRecentlyUsed(shard, objectsToRemove);
+            }
+            objectsToRemove.clear();
         }
 
         /** Remove Object from cache.*/
         void removeFromObjectCache(const KeyType& key)
         {
-            OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_objectCacheMutex);
-            typename ObjectCacheMap::iterator itr = _objectCache.find(key);
-            if (itr!=_objectCache.end()) _objectCache.erase(itr);
+            osg::ref_ptr<osg::Object> objectToRemove;
+            {
+                Shard& shard = getShard(key);
+                OpenThreads::ScopedLock<OpenThreads::Mutex> lock(shard._mutex);
+                typename ItemMap::iterator itr = shard._items.find(key);
+                if (itr != shard._items.end())
+                {
+                    objectToRemove = itr->second._object;
+                    erase(shard, itr);
+                }
+            }
+        }
+
+        /** Remove the objects whose keys match the given predicate. */
+        template <class Predicate>
+        void removeFromObjectCacheIf(Predicate predicate)
+        {
+            std::vector<osg::ref_ptr<osg::Object> > objectsToRemove;
+            for (Shard& shard : _shards)
+            {
+                OpenThreads::ScopedLock<OpenThreads::Mutex> lock(shard._mutex);
+                for (typename ItemMap::iterator itr = shard._items.begin(); itr != shard._items.end(); )
+                {
+                    if (predicate(itr->first))
+                    {
+                        objectsToRemove.push_back(itr->second._object);
+                        erase(shard, itr++);
+                    }
+                    else
+                        ++itr;
+                }
+            }
+            objectsToRemove.clear();
         }
 
         /** Get an ref_ptr<Object> from the object cache*/
         osg::ref_ptr<osg::Object> getRefFromObjectCache(const KeyType& key)
         {
-            OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_objectCacheMutex);
-            typename ObjectCacheMap::iterator itr = _objectCache.find(key);
-            if (itr!=_objectCache.end())
-                return itr->second.first;
+            Shard& shard = getShard(key);
+            OpenThreads::ScopedLock<OpenThreads::Mutex> lock(shard._mutex);
+            typename ItemMap::iterator itr = shard._items.find(key);
+            if (itr != shard._items.end())
+            {
+                touch(shard, itr->second);
+                return itr->second._object;
+            }
             else return 0;
         }
 
         /** Check if an object is in the cache, and if it is, update its usage time stamp. */
         bool checkInObjectCache(const KeyType& key, double timeStamp)
         {
-            OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_objectCacheMutex);
-            typename ObjectCacheMap::iterator itr = _objectCache.find(key);
-            if (itr!=_objectCache.end())
+            Shard& shard = getShard(key);
+            OpenThreads::ScopedLock<OpenThreads::Mutex> lock(shard._mutex);
+            typename ItemMap::iterator itr = shard._items.find(key);
+            if (itr != shard._items.end())
             {
-                itr->second.second = timeStamp;
+                itr->second._timeStamp = timeStamp;
+                touch(shard, itr->second);
                 return true;
             }
             else return false;
@@ -137,26 +317,32 @@ class GenericObjectCache : public osg::Referenced
         /** call releaseGLObjects on all objects attached to the object cache.*/
         void releaseGLObjects(osg::State* state)
         {
-            OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_objectCacheMutex);
-            for(typename ObjectCacheMap::iterator itr = _objectCache.begin(); itr != _objectCache.end(); ++itr)
+            for (Shard& shard : _shards)
             {
-                osg::Object* object = itr->second.first.get();
-                object->releaseGLObjects(state);
+                OpenThreads::ScopedLock<OpenThreads::Mutex> lock(shard._mutex);
+                for (typename ItemMap::iterator itr = shard._items.begin(); itr != shard._items.end(); ++itr)
+                {
+                    osg::Object* object = itr->second._object.get();
+                    object->releaseGLObjects(state);
+                }
             }
         }
 
         /** call node->accept(nv); for all nodes in the objectCache. */
         void accept(osg::NodeVisitor& nv)
         {
-            OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_objectCacheMutex);
-            for(typename ObjectCacheMap::iterator itr = _objectCache.begin(); itr != _objectCache.end(); ++itr)
+            for (Shard& shard : _shards)
             {
-                osg::Object* object = itr->second.first.get();
-                if (object)
+                OpenThreads::ScopedLock<OpenThreads::Mutex> lock(shard._mutex);
+                for (typename ItemMap::iterator itr = shard._items.begin(); itr != shard._items.end(); ++itr)
                 {
-                    osg::Node* node = dynamic_cast<osg::Node*>(object);
-                    if (node)
-                        node->accept(nv);
+                    osg::Object* object = itr->second._object.get();
+                    if (object)
+                    {
+                        osg::Node* node = dynamic_cast<osg::Node*>(object);
+                        if (node)
+                            node->accept(nv);
+                    }
                 }
             }
         }
@@ -165,27 +351,210 @@ class GenericObjectCache : public osg::Referenced
         template <class Functor>
         void call(Functor& f)
         {
-            OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_objectCacheMutex);
-            for (typename ObjectCacheMap::iterator it = _objectCache.begin(); it != _objectCache.end(); ++it)
-                f(it->second.first.get());
+            for (Shard& shard : _shards)
+            {
+                OpenThreads::ScopedLock<OpenThreads::Mutex> lock(shard._mutex);
+                for (typename ItemMap::iterator it = shard._items.begin(); it != shard._items.end(); ++it)
+                    f(it->second._object.get());
+            }
         }
 
         /** Get the number of objects in the cache. */
         unsigned int getCacheSize() const
         {
-            OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_objectCacheMutex);
-            return _objectCache.size();
+            unsigned int size = 0;
+            for (const Shard& shard : _shards)
+            {
+                OpenThreads::ScopedLock<OpenThreads::Mutex> lock(shard._mutex);
+                size += shard._items.size();
+            }
+            return size;
+        }
+
+        /** Add the least recently used objects that could be removed to free memory, i.e. have no external references
+          * and a known size, to candidates. Each shard adds objects until their sizes add up to bytes, as none of the
+          * more recently used ones would be removed before them.*/
+        void getEvictionCandidates(std::size_t bytes, std::vector<EvictionCandidate>& candidates) const
+        {
+            for (const Shard& shard : _shards)
+            {
+                OpenThreads::ScopedLock<OpenThreads::Mutex> lock(shard._mutex);
+                std::size_t found = 0;
+                for (typename LruList::const_reverse_iterator lruItr = shard._lru.rbegin(); lruItr != shard._lru.rend() && found < bytes; ++lruItr)
+                {
+                    const Item& item = shard._items.find(**lruItr)->second;
+                    if (canEvict(item))
+                    {
+                        candidates.emplace_back(item._lastUsed, item._size);
+                        found += item._size;
+                    }
+                }
+            }
+        }
+
+        /** Remove the objects that could be removed to free memory and were last used at or before the usage tick lastUsed,
+          * e.g. the oldest of the candidates found by getEvictionCandidates. Returns the freed size in bytes.*/
+        std::size_t removeLeastRecentlyUsed(std::uint64_t lastUsed)
+        {
+            std::vector<osg::ref_ptr<osg::Object> > objectsToRemove;
+            std::size_t freed = 0;
+            for (Shard& shard : _shards)
+            {
+                OpenThreads::ScopedLock<OpenThreads::Mutex> lock(shard._mutex);
+                typename LruList::iterator lruItr = shard._lru.end();
+                while (lruItr != shard._lru.begin())
+                {
+                    typename LruList::iterator current = std::prev(lruItr);
+                    typename ItemMap::iterator itr = shard._items.find(**current);
+                    // The list is ordered by usage, so the remaining objects are all used more recently
+                    if (itr->second._lastUsed > lastUsed)
+                        break;
+                    if (canEvict(itr->second))
+                    {
+                        objectsToRemove.push_back(itr->second._object);
+                        freed += itr->second._size;
+                        erase(shard, itr);
+                    }
+                    else
+                        lruItr = current;
+                }
+            }
+            // note, actual unref happens outside of the lock
+            objectsToRemove.clear();
+            return freed;
+        }
+
+        /** Get the total estimated size of the objects in the cache in bytes. */
+        std::size_t getMemoryUsage() const
+        {
+            std::size_t size = 0;
+            for (const Shard& shard : _shards)
+            {
+                OpenThreads::ScopedLock<OpenThreads::Mutex> lock(shard._mutex);
+                size += shard._size;
+            }
+            return size;
         }
 
     protected:
 
         virtual ~GenericObjectCache() {}
 
-        typedef std::pair<osg::ref_ptr<osg::Object>, double >           ObjectTimeStampPair;
-        typedef std::map<KeyType, ObjectTimeStampPair >             ObjectCacheMap;
+        static const unsigned int sNumShards = 16;
+        static const unsigned int sShardsPerUpdate = 4;
+
+        typedef std::list<const KeyType*> LruList; // most recently used first
+
+        struct Item
+        {
+            Item() : _timeStamp(0.0), _size(0), _lastUsed(0) {}
+
+            osg::ref_ptr<osg::Object> _object;
+            double _timeStamp;
+            std::size_t _size;
+            std::uint64_t _lastUsed;
+            typename LruList::iterator _lruPosition;
+        };
+
+        typedef std::unordered_map<KeyType, Item, ObjectCacheKeyHash<KeyType> > ItemMap;
+
+        struct Shard
+        {
+            Shard() : _size(0) {}
+
+            ItemMap _items;
+            LruList _lru;
+            std::size_t _size;
+            mutable OpenThreads::Mutex _mutex;
+        };
+
+        Shard& getShard(const KeyType& key)
+        {
+            // the key hashes barely mix integer keys, so mix them before picking a shard,
+            // and use the upper bits, which don't correlate with the buckets of the map within the shard
+            std::uint64_t hash = mixHash(ObjectCacheKeyHash<KeyType>()(key));
+            return _shards[(hash >> 32) % sNumShards];
+        }
+
+        void touch(Shard& shard, Item& item)
+        {
+            item._lastUsed = getNextObjectCacheTick();
+            shard._lru.splice(shard._lru.begin(), shard._lru, item._lruPosition);
+        }
+
+        static bool canEvict(const Item& item)
+        {
+            // Objects that are still in use elsewhere would not be freed, only lose their sharing
+            return item._object->referenceCount() == 1 && item._size > 0;
+        }
+
+        /** Get the least recently used item that has no external references and a known size, nullptr if there is none.*/
+        const Item* findEvictionCandidate(const Shard& shard) const
+        {
+            for (typename LruList::const_reverse_iterator lruItr = shard._lru.rbegin(); lruItr != shard._lru.rend(); ++lruItr)
+            {
+                const Item& item = shard._items.find(**lruItr)->second;
+                if (canEvict(item))
+                    return &item;
+            }
+            return nullptr;
+        }
+
+        void erase(Shard& shard, typename ItemMap::iterator itr)
+        {
+            shard._size -= itr->second._size;
+            shard._lru.erase(itr->second._lruPosition);
+            shard._items.erase(itr);
+        }
+
+        void updateTimeStamps(Shard& shard, double referenceTime)
+        {
+            for (typename ItemMap::iterator itr = shard._items.begin(); itr != shard._items.end(); ++itr)
+            {
+                // If ref count is greater than 1, the object has an external reference.
+                // If the timestamp is yet to be initialized, it needs to be updated too.
+                if (itr->second._object->referenceCount()>1 || itr->second._timeStamp == 0.0)
+                    itr->second._timeStamp = referenceTime;
+                // Keep objects that are in use at the front, so that eviction finds unused ones quickly
+                if (itr->second._object->referenceCount()>1)
+                    touch(shard, itr->second);
+            }
+        }
+
+        void removeExpired(Shard& shard, double expiryTime, std::vector<osg::ref_ptr<osg::Object> >& objectsToRemove)
+        {
+            typename ItemMap::iterator itr = shard._items.begin();
+            while (itr != shard._items.end())
+            {
+                if (itr->second._timeStamp <= expiryTime)
+                {
+                    objectsToRemove.push_back(itr->second._object);
+                    erase(shard, itr++);
+                }
+                else
+                    ++itr;
+            }
+        }
+
+        void evictLeastRecentlyUsed(Shard& shard, std::vector<osg::ref_ptr<osg::Object> >& objectsToRemove)
+        {
+            std::size_t budget = _memoryBudget / sNumShards;
+            if (budget == 0)
+                return;
+            while (shard._size > budget)
+            {
+                const Item* item = findEvictionCandidate(shard);
+                if (!item)
+                    break;
+                typename ItemMap::iterator itr = shard._items.find(**item->_lruPosition);
+                objectsToRemove.push_back(itr->second._object);
+                erase(shard, itr);
+            }
+        }
 
-        ObjectCacheMap                          _objectCache;
-        mutable OpenThreads::Mutex              _objectCacheMutex;
+        Shard _shards[sNumShards];
+        std::atomic<std::size_t> _memoryBudget;
+        std::atomic<unsigned int> _nextShardToUpdate;
 
 };
 
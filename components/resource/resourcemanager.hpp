@@ -28,6 +28,13 @@ namespace Resource
         virtual void setExpiryDelay(double expiryDelay) {}
         virtual void reportStats(unsigned int frameNumber, osg::Stats* stats) const {}
         virtual void releaseGLObjects(osg::State* state) {}
+
+        /// Estimated memory used by the cached objects in bytes.
+        virtual size_t getMemoryUsage() const { return 0; }
+        /// @see GenericObjectCache::getEvictionCandidates
+        virtual void getEvictionCandidates(size_t bytes, std::vector<EvictionCandidate>& candidates) const {}
+        /// @see GenericObjectCache::removeLeastRecentlyUsed
+        virtual size_t removeLeastRecentlyUsed(std::uint64_t lastUsed) { return 0; }
     };
 
     /// @brief Base class for managers that require a virtual file system and object cache.
@@ -48,10 +55,10 @@ namespace Resource
         virtual ~GenericResourceManager() {}
 
         /// Clear cache entries that have not been referenced for longer than expiryDelay.
+        /// @note Works incrementally, see GenericObjectCache::updateCache.
         virtual void updateCache(double referenceTime)
         {
-            mCache->updateTimeStampOfObjectsInCacheWithExternalReferences(referenceTime);
-            mCache->removeExpiredObjectsInCache(referenceTime - mExpiryDelay);
+            mCache->updateCache(referenceTime, referenceTime - mExpiryDelay);
         }
 
         /// Clear all cache entries.
@@ -66,6 +73,10 @@ namespace Resource
 
         virtual void releaseGLObjects(osg::State* state) { mCache->releaseGLObjects(state); }
 
+        virtual size_t getMemoryUsage() const { return mCache->getMemoryUsage(); }
+        virtual void getEvictionCandidates(size_t bytes, std::vector<EvictionCandidate>& candidates) const { mCache->getEvictionCandidates(bytes, candidates); }
+        virtual size_t removeLeastRecentlyUsed(std::uint64_t lastUsed) { return mCache->removeLeastRecentlyUsed(lastUsed); }
+
     protected:
         const VFS::Manager* mVFS;
         osg::ref_ptr<CacheType> mCache;
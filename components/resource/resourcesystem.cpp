@@ -1,6 +1,10 @@
 #include "resourcesystem.hpp"
 
 #include <algorithm>
+#include <cstdint>
+#include <functional>
+
+#include <osg/Stats>
 
 #include "scenemanager.hpp"
 #include "imagemanager.hpp"
@@ -12,6 +16,9 @@ namespace Resource
 
     ResourceSystem::ResourceSystem(const VFS::Manager *vfs)
         : mVFS(vfs)
+        , mMemoryBudget(0)
+        , mUnevictableMemoryUsage(0)
+        , mNextEvictionTime(0.0)
     {
         mNifFileManager.reset(new NifFileManager(vfs));
         mKeyframeManager.reset(new KeyframeManager(vfs));
@@ -62,10 +69,71 @@ namespace Resource
         mNifFileManager->setExpiryDelay(0.0);
     }
 
+    void ResourceSystem::setMemoryBudget(size_t bytes)
+    {
+        mMemoryBudget = bytes;
+    }
+
     void ResourceSystem::updateCache(double referenceTime)
     {
         for (std::vector<BaseResourceManager*>::iterator it = mResourceManagers.begin(); it != mResourceManagers.end(); ++it)
             (*it)->updateCache(referenceTime);
+
+        enforceMemoryBudget(referenceTime);
+    }
+
+    void ResourceSystem::enforceMemoryBudget(double referenceTime)
+    {
+        const size_t budget = mMemoryBudget;
+        if (budget == 0)
+            return;
+
+        size_t memoryUsage = 0;
+        for (std::vector<BaseResourceManager*>::const_iterator it = mResourceManagers.begin(); it != mResourceManagers.end(); ++it)
+            memoryUsage += (*it)->getMemoryUsage();
+
+        if (memoryUsage <= budget)
+        {
+            mUnevictableMemoryUsage = 0;
+            return;
+        }
+
+        // Don't search all caches every frame while the objects over budget are in use, unless more were added
+        if (memoryUsage <= mUnevictableMemoryUsage && referenceTime < mNextEvictionTime)
+            return;
+
+        const size_t excess = memoryUsage - budget;
+        std::vector<EvictionCandidate> candidates;
+        for (std::vector<BaseResourceManager*>::const_iterator it = mResourceManagers.begin(); it != mResourceManagers.end(); ++it)
+            (*it)->getEvictionCandidates(excess, candidates);
+
+        // Pick the least recently used candidates of all managers until they free enough memory, then remove them in one go
+        std::greater<EvictionCandidate> newer;
+        std::make_heap(candidates.begin(), candidates.end(), newer);
+        std::uint64_t lastUsed = 0;
+        size_t evictable = 0;
+        while (!candidates.empty() && evictable < excess)
+        {
+            std::pop_heap(candidates.begin(), candidates.end(), newer);
+            lastUsed = candidates.back().first;
+            evictable += candidates.back().second;
+            candidates.pop_back();
+        }
+
+        size_t freed = 0;
+        if (evictable > 0)
+        {
+            for (std::vector<BaseResourceManager*>::iterator it = mResourceManagers.begin(); it != mResourceManagers.end(); ++it)
+                freed += (*it)->removeLeastRecentlyUsed(lastUsed);
+        }
+
+        if (freed < excess)
+        {
+            mUnevictableMemoryUsage = memoryUsage - std::min(freed, memoryUsage);
+            mNextEvictionTime = referenceTime + 1.0;
+        }
+        else
+            mUnevictableMemoryUsage = 0;
     }
 
     void ResourceSystem::clearCache()
@@ -93,8 +161,13 @@ namespace Resource
 
     void ResourceSystem::reportStats(unsigned int frameNumber, osg::Stats *stats) const
     {
+        size_t memoryUsage = 0;
         for (std::vector<BaseResourceManager*>::const_iterator it = mResourceManagers.begin(); it != mResourceManagers.end(); ++it)
+        {
             (*it)->reportStats(frameNumber, stats);
+            memoryUsage += (*it)->getMemoryUsage();
+        }
+        stats->setAttribute(frameNumber, "Cache KiB", memoryUsage / 1024.0);
     }
 
     void ResourceSystem::releaseGLObjects(osg::State *state)
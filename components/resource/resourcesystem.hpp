@@ -1,6 +1,7 @@
 #ifndef OPENMW_COMPONENTS_RESOURCE_RESOURCESYSTEM_H
 #define OPENMW_COMPONENTS_RESOURCE_RESOURCESYSTEM_H
 
+#include <atomic>
 #include <memory>
 #include <vector>
 
@@ -56,6 +57,10 @@ namespace Resource
         /// How long to keep objects in cache after no longer being referenced.
         void setExpiryDelay(double expiryDelay);
 
+        /// Maximum estimated memory used by the objects in all resource manager caches in bytes, 0 for no limit.
+        /// When exceeded, updateCache removes unreferenced objects in least recently used order across all managers.
+        void setMemoryBudget(size_t bytes);
+
         /// @note May be called from any thread.
         const VFS::Manager* getVFS() const;
 
@@ -65,6 +70,8 @@ namespace Resource
         void releaseGLObjects(osg::State* state);
 
     private:
+        void enforceMemoryBudget(double referenceTime);
+
         std::unique_ptr<SceneManager> mSceneManager;
         std::unique_ptr<ImageManager> mImageManager;
         std::unique_ptr<NifFileManager> mNifFileManager;
@@ -76,6 +83,12 @@ namespace Resource
 
         const VFS::Manager* mVFS;
 
+        std::atomic<size_t> mMemoryBudget;
+
+        // Memory usage left over budget by the last enforceMemoryBudget, as the remaining objects were in use
+        size_t mUnevictableMemoryUsage;
+        double mNextEvictionTime;
+
         ResourceSystem(const ResourceSystem&);
         void operator = (const ResourceSystem&);
     };
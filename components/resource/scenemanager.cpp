@@ -1,9 +1,14 @@
 #include "scenemanager.hpp"
 
 #include <cstdlib>
+#include <cstring>
+#include <sstream>
 
+#include <osg/Group>
 #include <osg/Node>
+#include <osg/Program>
 #include <osg/UserDataContainer>
+#include <osg/Version>
 
 #include <osgParticle/ParticleSystem>
 
@@ -15,6 +20,7 @@
 #include <components/debug/debuglog.hpp>
 
 #include <components/nifosg/nifloader.hpp>
+#include <components/nifosg/userdata.hpp>
 #include <components/nif/niffile.hpp>
 
 #include <components/misc/stringops.hpp>
@@ -25,14 +31,18 @@
 #include <components/sceneutil/util.hpp>
 #include <components/sceneutil/controller.hpp>
 #include <components/sceneutil/optimizer.hpp>
+#include <components/sceneutil/serialize.hpp>
 
 #include <components/shader/shadervisitor.hpp>
 #include <components/shader/shadermanager.hpp>
 
+#include "diskcache.hpp"
 #include "imagemanager.hpp"
+#include "memoryusage.hpp"
 #include "niffilemanager.hpp"
 #include "objectcache.hpp"
 #include "multiobjectcache.hpp"
+#include "instancepool.hpp"
 
 namespace
 {
@@ -106,6 +116,145 @@ namespace
     private:
         unsigned int mMask;
     };
+
+    /// Undoes the changes that users commonly make to an instance, so that it can be handed out again.
+    /// Particle systems can't be reset, their particles and emitter state would carry over.
+    class ResetInstanceVisitor : public SceneUtil::ControllerVisitor
+    {
+    public:
+        ResetInstanceVisitor()
+            : mCanReset(true)
+        {
+        }
+
+        void apply(osg::Node& node) override
+        {
+            if (dynamic_cast<osgParticle::ParticleSystem*>(&node))
+            {
+                mCanReset = false;
+                return;
+            }
+            SceneUtil::ControllerVisitor::apply(node);
+        }
+
+        void visit(osg::Node&, SceneUtil::Controller& ctrl) override
+        {
+            // Sources assigned by the user, e.g. through AssignControllerSourcesVisitor. Auto-playing controllers
+            // already get a FrameTimeSource when the template is loaded.
+            if (!dynamic_cast<SceneUtil::FrameTimeSource*>(ctrl.getSource().get()))
+                ctrl.setSource(nullptr);
+        }
+
+        bool mCanReset;
+    };
+
+    /// Checks whether a scene graph can be stored in the disk cache, i.e. whether all of its objects
+    /// survive a round trip through the osgDB serializers. Custom classes and callbacks don't.
+    class CanCacheVisitor : public osg::NodeVisitor
+    {
+    public:
+        CanCacheVisitor()
+            : osg::NodeVisitor(TRAVERSE_ALL_CHILDREN)
+            , mCanCache(true)
+        {
+        }
+
+        void apply(osg::Node& node) override
+        {
+            if (!mCanCache)
+                return;
+
+            if (!isStandardObject(node) || node.getUpdateCallback() || node.getEventCallback() || node.getCullCallback()
+                    || !checkUserData(node) || !checkStateSet(node.getStateSet()))
+            {
+                mCanCache = false;
+                return;
+            }
+
+            traverse(node);
+        }
+
+        void apply(osg::Drawable& drawable) override
+        {
+            if (!mCanCache)
+                return;
+
+            if (!drawable.asGeometry() || drawable.getDrawCallback() || drawable.getComputeBoundingBoxCallback())
+            {
+                mCanCache = false;
+                return;
+            }
+
+            apply(static_cast<osg::Node&>(drawable));
+        }
+
+        bool isStandardObject(const osg::Object& object) const
+        {
+            return std::strcmp(object.libraryName(), "osg") == 0;
+        }
+
+        bool checkUserData(const osg::Object& object) const
+        {
+            const osg::UserDataContainer* container = object.getUserDataContainer();
+            if (!container)
+                return true;
+            if (!isStandardObject(*container) || container->getUserData())
+                return false;
+            // NodeUserData is the only custom object with a serializer, see SceneUtil::registerSerializers
+            for (unsigned int i=0; i<container->getNumUserObjects(); ++i)
+                if (!dynamic_cast<const NifOsg::NodeUserData*>(container->getUserObject(i)))
+                    return false;
+            return true;
+        }
+
+        bool checkAttribute(const osg::StateAttribute* attribute) const
+        {
+            if (!isStandardObject(*attribute) || attribute->getUpdateCallback() || attribute->getEventCallback())
+                return false;
+            if (const osg::Texture* texture = attribute->asTexture())
+            {
+                // Images are stored as references to be loaded through the ImageManager, which needs a file name
+                for (unsigned int i=0; i<texture->getNumImages(); ++i)
+                    if (texture->getImage(i) && texture->getImage(i)->getFileName().empty())
+                        return false;
+            }
+            return true;
+        }
+
+        bool checkStateSet(const osg::StateSet* stateset) const
+        {
+            if (!stateset)
+                return true;
+            if (stateset->getUpdateCallback() || stateset->getEventCallback() || !checkUserData(*stateset))
+                return false;
+
+            for (const auto& attribute : stateset->getAttributeList())
+                if (!checkAttribute(attribute.second.first.get()))
+                    return false;
+            for (const auto& unit : stateset->getTextureAttributeList())
+                for (const auto& attribute : unit)
+                    if (!checkAttribute(attribute.second.first.get()))
+                        return false;
+            for (const auto& uniform : stateset->getUniformList())
+            {
+                if (uniform.second.first->getUpdateCallback() || uniform.second.first->getEventCallback())
+                    return false;
+            }
+            return true;
+        }
+
+        bool mCanCache;
+    };
+
+    std::string readAll(std::istream& stream)
+    {
+        std::ostringstream buffer;
+        buffer << stream.rdbuf();
+        return buffer.str();
+    }
+
+    /// Bump when changing anything about the way cached scenes are produced.
+    const unsigned int sDiskCacheVersion = 1;
 }
 
 namespace Resource
@@ -221,6 +370,7 @@ namespace Resource
         , mAutoUseNormalMaps(false)
         , mAutoUseSpecularMaps(false)
         , mInstanceCache(new MultiObjectCache)
+        , mInstancePool(new InstancePool)
         , mSharedStateManager(new SharedStateManager)
         , mImageManager(imageManager)
         , mNifFileManager(nifFileManager)
@@ -477,14 +627,33 @@ namespace Resource
         else
         {
             osg::ref_ptr<osg::Node> loaded;
+            bool useDiskCache = false;
+            bool loadedFromDiskCache = false;
+            DiskCacheKey diskCacheKey;
             try
             {
                 Files::IStreamPtr file = mVFS->get(normalized);
 
-                loaded = load(file, normalized, mImageManager, mNifFileManager);
+                if (mDiskCache)
+                {
+                    // The source data is part of the key, so that modified files don't pick up stale entries
+                    std::string data = readAll(*file);
+                    diskCacheKey = makeDiskCacheKey(normalized, data);
+                    useDiskCache = true;
+
+                    loaded = loadFromDiskCache(normalized, diskCacheKey);
+                    loadedFromDiskCache = loaded != nullptr;
+                    if (!loaded)
+                        file.reset(new std::istringstream(data));
+                }
+
+                if (!loaded)
+                    loaded = load(file, normalized, mImageManager, mNifFileManager);
             }
             catch (std::exception& e)
             {
+                useDiskCache = false;
+
                 static const char * const sMeshTypes[] = { "nif", "osg", "osgt", "osgb", "osgx", "osg2" };
 
                 for (unsigned int i=0; i<sizeof(sMeshTypes)/sizeof(sMeshTypes[0]); ++i)
@@ -503,42 +672,155 @@ namespace Resource
                     throw;
             }
 
-            // set filtering settings
-            SetFilterSettingsVisitor setFilterSettingsVisitor(mMinFilter, mMagFilter, mMaxAnisotropy);
-            loaded->accept(setFilterSettingsVisitor);
-            SetFilterSettingsControllerVisitor setFilterSettingsControllerVisitor(mMinFilter, mMagFilter, mMaxAnisotropy);
-            loaded->accept(setFilterSettingsControllerVisitor);
-
-            osg::ref_ptr<Shader::ShaderVisitor> shaderVisitor (createShaderVisitor());
-            loaded->accept(*shaderVisitor);
-
-            // share state
-            // do this before optimizing so the optimizer will be able to combine nodes more aggressively
-            // note, because StateSets will be shared at this point, StateSets can not be modified inside the optimizer
-            mSharedStateMutex.lock();
-            mSharedStateManager->share(loaded.get());
-            mSharedStateMutex.unlock();
-
-            if (canOptimize(normalized))
-            {
-                SceneUtil::Optimizer optimizer;
-                optimizer.setIsOperationPermissibleForObjectCallback(new CanOptimizeCallback);
-
-                static const unsigned int options = getOptimizationOptions();
+            // a cached scene has been optimized before it was written
+            postProcess(loaded, normalized, !loadedFromDiskCache);
 
-                optimizer.optimize(loaded, options);
-            }
+            if (useDiskCache && !loadedFromDiskCache)
+                writeToDiskCache(loaded, normalized, diskCacheKey);
 
             if (mIncrementalCompileOperation)
                 mIncrementalCompileOperation->add(loaded);
             else
                 loaded->getBound();
 
-            mCache->addEntryToObjectCache(normalized, loaded);
+            mCache->addEntryToObjectCache(normalized, loaded, 0.0, getNodeMemoryUsage(*loaded));
             return loaded;
         }
     }
 
+    void SceneManager::postProcess(osg::Node* loaded, const std::string &normalizedFilename, bool optimize)
+    {
+        // set filtering settings
+        SetFilterSettingsVisitor setFilterSettingsVisitor(mMinFilter, mMagFilter, mMaxAnisotropy);
+        loaded->accept(setFilterSettingsVisitor);
+        SetFilterSettingsControllerVisitor setFilterSettingsControllerVisitor(mMinFilter, mMagFilter, mMaxAnisotropy);
+        loaded->accept(setFilterSettingsControllerVisitor);
+
+        osg::ref_ptr<Shader::ShaderVisitor> shaderVisitor (createShaderVisitor());
+        loaded->accept(*shaderVisitor);
+
+        // share state
+        // do this before optimizing so the optimizer will be able to combine nodes more aggressively
+        // note, because StateSets will be shared at this point, StateSets can not be modified inside the optimizer
+        mSharedStateMutex.lock();
+        mSharedStateManager->share(loaded);
+        mSharedStateMutex.unlock();
+
+        if (optimize && canOptimize(normalizedFilename))
+        {
+            SceneUtil::Optimizer optimizer;
+            optimizer.setIsOperationPermissibleForObjectCallback(new CanOptimizeCallback);
+
+            static const unsigned int options = getOptimizationOptions();
+
+            optimizer.optimize(loaded, options);
+        }
+    }
+
+    bool SceneManager::writeDiskCacheEntry(const std::string &name)
+    {
+        if (!mDiskCache)
+            return false;
+
+        std::string normalized = name;
+        mVFS->normalizeFilename(normalized);
+
+        Files::IStreamPtr file = mVFS->get(normalized);
+        std::string data = readAll(*file);
+        DiskCacheKey diskCacheKey = makeDiskCacheKey(normalized, data);
+        if (mDiskCache->contains(diskCacheKey))
+            return false;
+
+        file.reset(new std::istringstream(data));
+        osg::ref_ptr<osg::Node> loaded = load(file, normalized, mImageManager, mNifFileManager);
+        postProcess(loaded, normalized, true);
+        return writeToDiskCache(loaded, normalized, diskCacheKey);
+    }
+
+    void SceneManager::setDiskCachePath(const std::string &path)
+    {
+        if (path.empty())
+        {
+            mDiskCache.reset();
+            return;
+        }
+
+        SceneUtil::registerSerializers();
+        mDiskCache.reset(new DiskCache(path));
+    }
+
+    DiskCacheKey SceneManager::makeDiskCacheKey(const std::string &normalizedFilename, const std::string &data) const
+    {
+        DiskCacheKey key;
+        key.add(sDiskCacheVersion)
+           .add(osgGetVersion())
+           .add(normalizedFilename)
+           .add(data)
+           .add(mForceShaders)
+           .add(mClampLighting)
+           .add(mAutoUseNormalMaps)
+           .add(mNormalMapPattern)
+           .add(mNormalHeightMapPattern)
+           .add(mAutoUseSpecularMaps)
+           .add(mSpecularMapPattern)
+           .add(getOptimizationOptions());
+        // the shaders are baked into the cached scene
+        for (const auto& define : mShaderManager->getGlobalDefines())
+            key.add(define.first).add(define.second);
+        return key;
+    }
+
+    osg::ref_ptr<osg::Node> SceneManager::loadFromDiskCache(const std::string &normalizedFilename, const DiskCacheKey &key)
+    {
+        std::string data;
+        if (!mDiskCache->read(key, data))
+            return nullptr;
+
+        osgDB::ReaderWriter* reader = osgDB::Registry::instance()->getReaderWriterForExtension("osgb");
+        if (!reader)
+            return nullptr;
+
+        osg::ref_ptr<osgDB::Options> options (new osgDB::Options);
+        // Textures are stored as references, load them through our VFS so they get shared with everything else
+        options->setReadFileCallback(new ImageReadCallback(mImageManager));
+
+        std::istringstream stream(data);
+        osgDB::ReaderWriter::ReadResult result = reader->readNode(stream, options);
+        if (!result.success() || !result.getNode())
+        {
+            Log(Debug::Warning) << "Failed to read cached scene for '" << normalizedFilename << "': " << result.message() << ", loading it from the source file";
+            return nullptr;
+        }
+        return result.getNode();
+    }
+
+    bool SceneManager::writeToDiskCache(osg::Node *node, const std::string &normalizedFilename, const DiskCacheKey &key)
+    {
+        CanCacheVisitor visitor;
+        node->accept(visitor);
+        if (!visitor.mCanCache)
+            return false;
+
+        osgDB::ReaderWriter* writer = osgDB::Registry::instance()->getReaderWriterForExtension("osgb");
+        if (!writer)
+            return false;
+
+        osg::ref_ptr<osgDB::Options> options (new osgDB::Options);
+        options->setPluginStringData("fileType", "Binary");
+        options->setOptionString("WriteImageHint=UseExternal");
+
+        std::ostringstream stream;
+        osgDB::ReaderWriter::WriteResult result = writer->writeNode(*node, stream, options);
+        if (!result.success())
+        {
+            Log(Debug::Warning) << "Failed to write cached scene for '" << normalizedFilename << "': " << result.message();
+            return false;
+        }
+
+        mDiskCache->write(key, stream.str());
+        return true;
+    }
+
     osg::ref_ptr<osg::Node> SceneManager::cacheInstance(const std::string &name)
     {
         std::string normalized = name;
@@ -565,6 +847,8 @@ namespace Resource
 
         META_Object(Resource, TemplateRef)
 
+        const Object* getTemplate() const { return mObject.get(); }
+
     private:
         osg::ref_ptr<const Object> mObject;
     };
@@ -601,10 +885,67 @@ namespace Resource
         if (obj.get())
             return static_cast<osg::Node*>(obj.get());
 
+        osg::ref_ptr<osg::Node> pooled = mInstancePool->take(normalized);
+        if (pooled)
+            return pooled;
+
         return createInstance(normalized);
 
     }
 
+    void SceneManager::setInstancePoolSize(const std::string &name, unsigned int size)
+    {
+        std::string normalized = name;
+        mVFS->normalizeFilename(normalized);
+
+        mInstancePool->setPoolSize(normalized, size);
+    }
+
+    void SceneManager::recycleInstance(const std::string &name, osg::ref_ptr<osg::Node> instance)
+    {
+        // still in use
+        if (instance->getNumParents() != 0)
+            return;
+
+        const osg::Node* base = nullptr;
+        if (const osg::UserDataContainer* userData = instance->getUserDataContainer())
+        {
+            for (unsigned int i=0; i<userData->getNumUserObjects() && !base; ++i)
+            {
+                if (const TemplateRef* templateRef = dynamic_cast<const TemplateRef*>(userData->getUserObject(i)))
+                    base = dynamic_cast<const osg::Node*>(templateRef->getTemplate());
+            }
+        }
+        // not created by us
+        if (!base)
+            return;
+
+        ResetInstanceVisitor visitor;
+        instance->accept(visitor);
+        if (!visitor.mCanReset)
+            return;
+        instance->setNodeMask(base->getNodeMask());
+
+        std::string normalized = name;
+        mVFS->normalizeFilename(normalized);
+        mInstancePool->add(normalized, instance);
+    }
+
+    void SceneManager::refillInstancePools()
+    {
+        for (const auto& missing : mInstancePool->getMissingInstances())
+        {
+            for (unsigned int i=0; i<missing.second; ++i)
+            {
+                osg::ref_ptr<osg::Node> instance = createInstance(missing.first);
+                // see cacheInstance
+                instance->getBound();
+                if (!mInstancePool->add(missing.first, instance))
+                    break;
+            }
+        }
+    }
+
     osg::ref_ptr<osg::Node> SceneManager::getInstance(const std::string &name, osg::Group* parentNode)
     {
         osg::ref_ptr<osg::Node> cloned = getInstance(name);
@@ -621,6 +962,7 @@ namespace Resource
     {
         mCache->releaseGLObjects(state);
         mInstanceCache->releaseGLObjects(state);
+        mInstancePool->releaseGLObjects(state);
 
         mShaderManager->releaseGLObjects(state);
 
@@ -633,6 +975,22 @@ namespace Resource
         mIncrementalCompileOperation = ico;
     }
 
+    void SceneManager::compilePrograms(const std::vector<osg::ref_ptr<osg::Program> > &programs)
+    {
+        if (!mIncrementalCompileOperation || programs.empty())
+            return;
+
+        // The compile operation finds programs through the state sets of the scene graphs it is given
+        osg::ref_ptr<osg::Group> group (new osg::Group);
+        for (const osg::ref_ptr<osg::Program>& program : programs)
+        {
+            osg::ref_ptr<osg::Node> node (new osg::Node);
+            node->getOrCreateStateSet()->setAttributeAndModes(program, osg::StateAttribute::ON);
+            group->addChild(node);
+        }
+        mIncrementalCompileOperation->add(group);
+    }
+
     osgUtil::IncrementalCompileOperation *SceneManager::getIncrementalCompileOperation()
     {
         return mIncrementalCompileOperation.get();
@@ -710,6 +1068,8 @@ namespace Resource
 
         mInstanceCache->removeUnreferencedObjectsInCache();
 
+        refillInstancePools();
+
         mSharedStateMutex.lock();
         mSharedStateManager->prune();
         mSharedStateMutex.unlock();
@@ -722,6 +1082,7 @@ namespace Resource
         OpenThreads::ScopedLock<OpenThreads::Mutex> lock(mSharedStateMutex);
         mSharedStateManager->clearCache();
         mInstanceCache->clear();
+        mInstancePool->clear();
     }
 
     void SceneManager::reportStats(unsigned int frameNumber, osg::Stats *stats) const
@@ -739,7 +1100,9 @@ namespace Resource
         }
 
         stats->setAttribute(frameNumber, "Node", mCache->getCacheSize());
+        stats->setAttribute(frameNumber, "Node KiB", mCache->getMemoryUsage() / 1024.0);
         stats->setAttribute(frameNumber, "Node Instance", mInstanceCache->getCacheSize());
+        stats->setAttribute(frameNumber, "Node Pooled", mInstancePool->getCacheSize());
     }
 
     Shader::ShaderVisitor *SceneManager::createShaderVisitor()
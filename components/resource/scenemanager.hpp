@@ -4,6 +4,7 @@
 #include <string>
 #include <map>
 #include <memory>
+#include <vector>
 
 #include <osg/ref_ptr>
 #include <osg/Node>
@@ -16,6 +17,13 @@ namespace Resource
     class ImageManager;
     class NifFileManager;
     class SharedStateManager;
+    class DiskCache;
+    class DiskCacheKey;
+}
+
+namespace osg
+{
+    class Program;
 }
 
 namespace osgUtil
@@ -38,6 +46,7 @@ namespace Resource
 {
 
     class MultiObjectCache;
+    class InstancePool;
 
     /// @brief Handles loading and caching of scenes, e.g. .nif files or .osg files
     /// @note Some methods of the scene manager can be used from any thread, see the methods documentation for more details.
@@ -74,6 +83,19 @@ namespace Resource
 
         void setShaderPath(const std::string& path);
 
+        /// Store post-processed scene templates in \a path and load them from there in later sessions,
+        /// skipping conversion and optimization. An empty path disables the cache.
+        /// @note Only scenes built from standard OSG classes can be cached, others are always loaded from their source file.
+        /// @note Must be called before any loading takes place.
+        void setDiskCachePath(const std::string& path);
+
+        /// Load and post-process the given scene and write the result to the disk cache, without keeping it in memory.
+        /// Used to fill the cache ahead of time, so that the optimizer doesn't have to run while playing.
+        /// @return false if there is no disk cache, or the scene is cached already or can not be cached.
+        /// @note Throws an exception if the scene can not be loaded.
+        /// @note Thread safe.
+        bool writeDiskCacheEntry(const std::string& name);
+
         /// Check if a given scene is loaded and if so, update its usage timestamp to prevent it from being unloaded
         bool checkLoaded(const std::string& name, double referenceTime);
 
@@ -98,6 +120,23 @@ namespace Resource
         /// @note Thread safe.
         osg::ref_ptr<osg::Node> getInstance(const std::string& name);
 
+        /// Keep up to \a size ready-made instances of the given scene template, which getInstance() hands out before cloning
+        /// the template. The pool is refilled in the background by updateCache(). A size of 0 removes the pool.
+        /// @note Thread safe.
+        void setInstancePoolSize(const std::string& name, unsigned int size);
+
+        /// Give back an instance obtained from getInstance() that is no longer needed, so that it can be handed out again
+        /// if the template has an instance pool with room left. Otherwise the instance is simply dropped.
+        /// @par Controller sources and the node mask are reset. Instances with particle systems are not recycled,
+        /// and the caller must not have made any other changes to the instance.
+        /// @note The instance must be detached from the scene graph, and the caller must not hold other references to it.
+        /// @note Thread safe.
+        void recycleInstance(const std::string& name, osg::ref_ptr<osg::Node> instance);
+
+        /// Create instances for the instance pools that are not full.
+        /// @note Thread safe, usually called by updateCache() in a worker thread.
+        void refillInstancePools();
+
         /// Get an instance of the given scene template and immediately attach it to a parent node
         /// @see getTemplate
         /// @note Not thread safe, unless parentNode is not part of the main scene graph yet.
@@ -119,6 +158,9 @@ namespace Resource
 
         osgUtil::IncrementalCompileOperation* getIncrementalCompileOperation();
 
+        /// Compile the given shader programs in the background, using the IncrementalCompileOperation if there is one.
+        void compilePrograms(const std::vector<osg::ref_ptr<osg::Program> >& programs);
+
         Resource::ImageManager* getImageManager();
 
         /// @param mask The node mask to apply to loaded particle system nodes.
@@ -147,6 +189,18 @@ namespace Resource
 
         Shader::ShaderVisitor* createShaderVisitor();
 
+        /// Apply filter settings and shaders, share state and, if \a optimize is set, run the optimizer.
+        void postProcess(osg::Node* loaded, const std::string& normalizedFilename, bool optimize);
+
+        /// @return nullptr if the scene is not in the disk cache or could not be read.
+        osg::ref_ptr<osg::Node> loadFromDiskCache(const std::string& normalizedFilename, const DiskCacheKey& key);
+
+        /// @return false if the scene can not be cached.
+        bool writeToDiskCache(osg::Node* node, const std::string& normalizedFilename, const DiskCacheKey& key);
+
+        /// Build the disk cache key for the given source file, including all settings that affect post-processing.
+        DiskCacheKey makeDiskCacheKey(const std::string& normalizedFilename, const std::string& data) const;
+
         std::unique_ptr<Shader::ShaderManager> mShaderManager;
         bool mForceShaders;
         bool mClampLighting;
@@ -157,6 +211,7 @@ namespace Resource
         std::string mSpecularMapPattern;
 
         osg::ref_ptr<MultiObjectCache> mInstanceCache;
+        osg::ref_ptr<InstancePool> mInstancePool;
 
         osg::ref_ptr<Resource::SharedStateManager> mSharedStateManager;
         mutable OpenThreads::Mutex mSharedStateMutex;
@@ -173,6 +228,8 @@ namespace Resource
 
         unsigned int mParticleSystemMask;
 
+        std::unique_ptr<DiskCache> mDiskCache;
+
         SceneManager(const SceneManager&);
         void operator = (const SceneManager&);
     };
@@ -279,6 +279,7 @@ void StatsHandler::setUpScene(osgViewer::ViewerBase *viewer)
             "StateSet",
             "Node",
             "Node Instance",
+            "Node Pooled",
             "Shape",
             "Shape Instance",
             "Image",
@@ -287,9 +288,19 @@ void StatsHandler::setUpScene(osgViewer::ViewerBase *viewer)
             "",
             "Terrain Chunk",
             "Terrain Texture",
+            "Object Chunk",
             "Land",
             "Composite",
             "",
+            "Node KiB",
+            "Shape KiB",
+            "Image KiB",
+            "Nif KiB",
+            "Keyframe KiB",
+            "Kf Saved KiB",
+            "Chunk KiB",
+            "Cache KiB",
+            "",
             "UnrefQueue",
             "",
             "NavMesh UpdateJobs",
@@ -1,9 +1,21 @@
 #include "lightmanager.hpp"
 
+#include <algorithm>
+#include <cmath>
+
+#include <osg/BoundingBox>
+
 #include <osgUtil/CullVisitor>
 
 #include <components/sceneutil/util.hpp>
 
+namespace
+{
+    // Below this, testing every light is cheaper than building a grid
+    const unsigned int sMinLightsForGrid = 16;
+    const int sMaxGridSize = 16;
+}
+
 namespace SceneUtil
 {
 
@@ -262,14 +274,14 @@ namespace SceneUtil
         return mLights;
     }
 
-    const std::vector<LightManager::LightSourceViewBound>& LightManager::getLightsInViewSpace(osg::Camera *camera, const osg::RefMatrix* viewMatrix)
+    LightManager::ViewSpaceLights& LightManager::getViewSpaceLights(osg::Camera *camera, const osg::RefMatrix* viewMatrix)
     {
         osg::observer_ptr<osg::Camera> camPtr (camera);
-        std::map<osg::observer_ptr<osg::Camera>, LightSourceViewBoundCollection>::iterator it = mLightsInViewSpace.find(camPtr);
+        std::map<osg::observer_ptr<osg::Camera>, ViewSpaceLights>::iterator it = mLightsInViewSpace.find(camPtr);
 
         if (it == mLightsInViewSpace.end())
         {
-            it = mLightsInViewSpace.insert(std::make_pair(camPtr, LightSourceViewBoundCollection())).first;
+            it = mLightsInViewSpace.insert(std::make_pair(camPtr, ViewSpaceLights())).first;
 
             for (std::vector<LightSourceTransform>::iterator lightIt = mLights.begin(); lightIt != mLights.end(); ++lightIt)
             {
@@ -280,12 +292,134 @@ namespace SceneUtil
                 LightSourceViewBound l;
                 l.mLightSource = lightIt->mLightSource;
                 l.mViewBound = viewBound;
-                it->second.push_back(l);
+                it->second.mLights.push_back(l);
             }
+
+            it->second.mGrid.build(it->second.mLights);
         }
         return it->second;
     }
 
+    const std::vector<LightManager::LightSourceViewBound>& LightManager::getLightsInViewSpace(osg::Camera *camera, const osg::RefMatrix* viewMatrix)
+    {
+        return getViewSpaceLights(camera, viewMatrix).mLights;
+    }
+
+    void LightManager::getLightsIntersecting(osg::Camera *camera, const osg::RefMatrix *viewMatrix, const osg::BoundingSphere &viewBound, LightList &lightList)
+    {
+        const ViewSpaceLights& viewSpaceLights = getViewSpaceLights(camera, viewMatrix);
+        const LightSourceViewBoundCollection& lights = viewSpaceLights.mLights;
+        const LightGrid& grid = viewSpaceLights.mGrid;
+
+        int first[3], last[3];
+        if (grid.mSize == 0)
+        {
+            for (const LightSourceViewBound& l : lights)
+                if (l.mViewBound.intersects(viewBound))
+                    lightList.push_back(&l);
+            return;
+        }
+        if (!grid.getCellRange(viewBound, first, last))
+            return;
+
+        unsigned int numCells = (last[0] - first[0] + 1) * (last[1] - first[1] + 1) * (last[2] - first[2] + 1);
+        if (numCells > lights.size())
+        {
+            // large bounds, e.g. of terrain, overlap more cells than there are lights
+            for (const LightSourceViewBound& l : lights)
+                if (l.mViewBound.intersects(viewBound))
+                    lightList.push_back(&l);
+            return;
+        }
+
+        mFoundLights.clear();
+        for (int z=first[2]; z<=last[2]; ++z)
+            for (int y=first[1]; y<=last[1]; ++y)
+                for (int x=first[0]; x<=last[0]; ++x)
+                {
+                    int cell = (z * grid.mSize + y) * grid.mSize + x;
+                    mFoundLights.insert(mFoundLights.end(), grid.mCellLights.begin() + grid.mCellStart[cell], grid.mCellLights.begin() + grid.mCellStart[cell+1]);
+                }
+
+        // lights overlapping several cells are found more than once
+        std::sort(mFoundLights.begin(), mFoundLights.end());
+        mFoundLights.erase(std::unique(mFoundLights.begin(), mFoundLights.end()), mFoundLights.end());
+
+        for (unsigned int index : mFoundLights)
+        {
+            const LightSourceViewBound& l = lights[index];
+            if (l.mViewBound.intersects(viewBound))
+                lightList.push_back(&l);
+        }
+    }
+
+    void LightManager::LightGrid::build(const LightSourceViewBoundCollection& lights)
+    {
+        mCellStart.clear();
+        mCellLights.clear();
+        mSize = 0;
+        if (lights.size() < sMinLightsForGrid)
+            return;
+
+        osg::BoundingBox bounds;
+        for (const LightSourceViewBound& l : lights)
+            bounds.expandBy(l.mViewBound);
+
+        mSize = std::min(sMaxGridSize, static_cast<int>(std::cbrt(lights.size())) * 2);
+        mOrigin = bounds._min;
+        for (int axis=0; axis<3; ++axis)
+            mCellSize[axis] = std::max(bounds._max[axis] - bounds._min[axis], 1.f) / mSize;
+
+        // count the lights of each cell, then fill in the lights in ascending order
+        mCellStart.assign(mSize * mSize * mSize + 1, 0);
+        for (int pass=0; pass<2; ++pass)
+        {
+            for (unsigned int i=0; i<lights.size(); ++i)
+            {
+                int first[3], last[3];
+                getCellRange(lights[i].mViewBound, first, last);
+                for (int z=first[2]; z<=last[2]; ++z)
+                    for (int y=first[1]; y<=last[1]; ++y)
+                        for (int x=first[0]; x<=last[0]; ++x)
+                        {
+                            int cell = (z * mSize + y) * mSize + x;
+                            if (pass == 0)
+                                ++mCellStart[cell+1];
+                            else
+                                mCellLights[mCellStart[cell]++] = i;
+                        }
+            }
+
+            if (pass == 0)
+            {
+                for (unsigned int cell=1; cell<mCellStart.size(); ++cell)
+                    mCellStart[cell] += mCellStart[cell-1];
+                mCellLights.resize(mCellStart.back());
+            }
+            else
+            {
+                // the fill moved each start to the start of the next cell
+                for (unsigned int cell=mCellStart.size()-1; cell>0; --cell)
+                    mCellStart[cell] = mCellStart[cell-1];
+                mCellStart[0] = 0;
+            }
+        }
+    }
+
+    bool LightManager::LightGrid::getCellRange(const osg::BoundingSphere &bound, int first[3], int last[3]) const
+    {
+        for (int axis=0; axis<3; ++axis)
+        {
+            int min = static_cast<int>(std::floor((bound.center()[axis] - bound.radius() - mOrigin[axis]) / mCellSize[axis]));
+            int max = static_cast<int>(std::floor((bound.center()[axis] + bound.radius() - mOrigin[axis]) / mCellSize[axis]));
+            if (max < 0 || min >= mSize)
+                return false;
+            first[axis] = std::max(min, 0);
+            last[axis] = std::min(max, mSize-1);
+        }
+        return true;
+    }
+
     class DisableLight : public osg::StateAttribute
     {
     public:
@@ -402,7 +536,6 @@ namespace SceneUtil
 
         // Possible optimizations:
         // - cull list of lights by the camera frustum
-        // - organize lights in a quad tree
 
 
         // update light list if necessary
@@ -413,7 +546,6 @@ namespace SceneUtil
 
             // Don't use Camera::getViewMatrix, that one might be relative to another camera!
             const osg::RefMatrix* viewMatrix = cv->getCurrentRenderStage()->getInitialViewMatrix();
-            const std::vector<LightManager::LightSourceViewBound>& lights = mLightManager->getLightsInViewSpace(cv->getCurrentCamera(), viewMatrix);
 
             // get the node bounds in view space
             // NB do not node->getBound() * modelView, that would apply the node's transformation twice
@@ -430,15 +562,12 @@ namespace SceneUtil
             transformBoundingSphere(mat, nodeBound);
 
             mLightList.clear();
-            for (unsigned int i=0; i<lights.size(); ++i)
+            mLightManager->getLightsIntersecting(cv->getCurrentCamera(), viewMatrix, nodeBound, mLightList);
+            if (!mIgnoredLightSources.empty())
             {
-                const LightManager::LightSourceViewBound& l = lights[i];
-
-                if (mIgnoredLightSources.count(l.mLightSource))
-                    continue;
-
-                if (l.mViewBound.intersects(nodeBound))
-                    mLightList.push_back(&l);
+                mLightList.erase(std::remove_if(mLightList.begin(), mLightList.end(),
+                    [this] (const LightManager::LightSourceViewBound* l) { return mIgnoredLightSources.count(l->mLightSource) != 0; }),
+                    mLightList.end());
             }
         }
         if (!mLightList.empty())
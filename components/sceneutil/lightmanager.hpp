@@ -127,6 +127,11 @@ namespace SceneUtil
 
         typedef std::vector<const LightSourceViewBound*> LightList;
 
+        /// Get the lights whose view space bounds intersect the given view space bound, in the order of getLightsInViewSpace.
+        /// @par Lights are binned into a grid in view space once per frame and camera, so that only the lights near the
+        /// bound have to be tested.
+        void getLightsIntersecting(osg::Camera* camera, const osg::RefMatrix* viewMatrix, const osg::BoundingSphere& viewBound, LightList& lightList);
+
         osg::ref_ptr<osg::StateSet> getLightListStateSet(const LightList& lightList, unsigned int frameNum);
 
     private:
@@ -134,7 +139,32 @@ namespace SceneUtil
         std::vector<LightSourceTransform> mLights;
 
         typedef std::vector<LightSourceViewBound> LightSourceViewBoundCollection;
-        std::map<osg::observer_ptr<osg::Camera>, LightSourceViewBoundCollection> mLightsInViewSpace;
+
+        /// Uniform grid over the view space bounds of a camera's lights.
+        struct LightGrid
+        {
+            osg::Vec3f mOrigin;
+            osg::Vec3f mCellSize;
+            int mSize; // number of cells along each axis, 0 if there are too few lights to bother
+            std::vector<unsigned int> mCellStart; // first entry of each cell in mCellLights, followed by the end of the last cell
+            std::vector<unsigned int> mCellLights; // indices of the lights overlapping each cell, in ascending order
+
+            LightGrid() : mSize(0) {}
+            void build(const LightSourceViewBoundCollection& lights);
+            /// @return false if the cell range of the bound is outside of the grid.
+            bool getCellRange(const osg::BoundingSphere& bound, int first[3], int last[3]) const;
+        };
+
+        struct ViewSpaceLights
+        {
+            LightSourceViewBoundCollection mLights;
+            LightGrid mGrid;
+        };
+        std::map<osg::observer_ptr<osg::Camera>, ViewSpaceLights> mLightsInViewSpace;
+
+        ViewSpaceLights& getViewSpaceLights(osg::Camera* camera, const osg::RefMatrix* viewMatrix);
+
+        std::vector<unsigned int> mFoundLights; // scratch space for getLightsIntersecting
 
         // < Light list hash , StateSet >
         typedef std::map<size_t, osg::ref_ptr<osg::StateSet> > LightStateSetMap;
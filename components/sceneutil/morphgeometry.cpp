@@ -1,12 +1,47 @@
 #include "morphgeometry.hpp"
 
+#include <algorithm>
 #include <cassert>
 
 #include <osg/Version>
 
+namespace
+{
+    // Gaps of unmoved vertices shorter than this are included in a range, it is cheaper to add a few zero offsets
+    // than to start another loop.
+    const unsigned int sMaxRangeGap = 16;
+
+    /// Add the weighted offsets of a range of vertices to the positions.
+    /// @note Written as a plain loop over the floats of the arrays so that the compiler can vectorize it for the target's
+    /// instruction set.
+    void accumulateOffsets(float* positions, const float* offsets, unsigned int numFloats, float weight)
+    {
+        for (unsigned int i=0; i<numFloats; ++i)
+            positions[i] += offsets[i] * weight;
+    }
+}
+
 namespace SceneUtil
 {
 
+void MorphGeometry::MorphTarget::updateRanges()
+{
+    mRanges.clear();
+    if (!mOffsets)
+        return;
+
+    const osg::Vec3f zero(0.f, 0.f, 0.f);
+    for (unsigned int vertex=0; vertex<mOffsets->size(); ++vertex)
+    {
+        if ((*mOffsets)[vertex] == zero)
+            continue;
+        if (!mRanges.empty() && vertex - mRanges.back().second < sMaxRangeGap)
+            mRanges.back().second = vertex+1;
+        else
+            mRanges.emplace_back(vertex, vertex+1);
+    }
+}
+
 MorphGeometry::MorphGeometry()
     : mLastFrameNumber(0)
     , mDirty(true)
@@ -18,6 +53,7 @@ MorphGeometry::MorphGeometry()
 MorphGeometry::MorphGeometry(const MorphGeometry &copy, const osg::CopyOp &copyop)
     : osg::Drawable(copy, copyop)
     , mMorphTargets(copy.mMorphTargets)
+    , mMorphedRanges(copy.mMorphedRanges)
     , mLastFrameNumber(0)
     , mDirty(true)
     , mMorphedBoundingBox(false)
@@ -57,9 +93,27 @@ void MorphGeometry::addMorphTarget(osg::Vec3Array *offsets, float weight)
 {
     mMorphTargets.push_back(MorphTarget(offsets, weight));
     mMorphedBoundingBox = false;
+    updateMorphedRanges();
     dirty();
 }
 
+void MorphGeometry::updateMorphedRanges()
+{
+    VertexRanges ranges;
+    for (const MorphTarget& target : mMorphTargets)
+        ranges.insert(ranges.end(), target.getRanges().begin(), target.getRanges().end());
+    std::sort(ranges.begin(), ranges.end());
+
+    mMorphedRanges.clear();
+    for (const auto& range : ranges)
+    {
+        if (!mMorphedRanges.empty() && range.first <= mMorphedRanges.back().second)
+            mMorphedRanges.back().second = std::max(mMorphedRanges.back().second, range.second);
+        else
+            mMorphedRanges.push_back(range);
+    }
+}
+
 void MorphGeometry::dirty()
 {
     mDirty = true;
@@ -163,8 +217,15 @@ void MorphGeometry::cull(osg::NodeVisitor *nv)
     const osg::Vec3Array* positionSrc = static_cast<osg::Vec3Array*>(mSourceGeometry->getVertexArray());
     osg::Vec3Array* positionDst = static_cast<osg::Vec3Array*>(geom.getVertexArray());
     assert(positionSrc->size() == positionDst->size());
-    for (unsigned int vertex=0; vertex<positionSrc->size(); ++vertex)
-        (*positionDst)[vertex] = (*positionSrc)[vertex];
+    const unsigned int numVertices = positionSrc->size();
+
+    // The geometry was copied from the source, so only the vertices that any morph target moves need to be reset
+    for (const auto& range : mMorphedRanges)
+    {
+        unsigned int end = std::min(range.second, numVertices);
+        if (range.first < end)
+            std::copy(positionSrc->begin() + range.first, positionSrc->begin() + end, positionDst->begin() + range.first);
+    }
 
     for (unsigned int i=0; i<mMorphTargets.size(); ++i)
     {
@@ -172,8 +233,12 @@ void MorphGeometry::cull(osg::NodeVisitor *nv)
         if (weight == 0.f)
             continue;
         const osg::Vec3Array* offsets = mMorphTargets[i].getOffsets();
-        for (unsigned int vertex=0; vertex<positionSrc->size(); ++vertex)
-            (*positionDst)[vertex] += (*offsets)[vertex] * weight;
+        for (const auto& range : mMorphTargets[i].getRanges())
+        {
+            unsigned int end = std::min(range.second, numVertices);
+            if (range.first < end)
+                accumulateOffsets((*positionDst)[range.first].ptr(), (*offsets)[range.first].ptr(), (end - range.first) * 3, weight);
+        }
     }
 
     positionDst->dirty();
@@ -24,18 +24,27 @@ namespace SceneUtil
         // Currently empty as this is difficult to implement. Technically we would need to compile both internal geometries in separate frames but this method is only called once. Alternatively we could compile just the static parts of the model.
         virtual void compileGLObjects(osg::RenderInfo& renderInfo) const {}
 
+        /// <first vertex, past the last vertex>
+        typedef std::vector<std::pair<unsigned int, unsigned int> > VertexRanges;
+
         class MorphTarget
         {
         protected:
             osg::ref_ptr<osg::Vec3Array> mOffsets;
             float mWeight;
+            VertexRanges mRanges;
+
+            void updateRanges();
         public:
-            MorphTarget(osg::Vec3Array* offsets, float w = 1.0) : mOffsets(offsets), mWeight(w) {}
+            MorphTarget(osg::Vec3Array* offsets, float w = 1.0) : mOffsets(offsets), mWeight(w) { updateRanges(); }
             void setWeight(float weight) { mWeight = weight; }
             float getWeight() const { return mWeight; }
             osg::Vec3Array* getOffsets() { return mOffsets.get(); }
             const osg::Vec3Array* getOffsets() const { return mOffsets.get(); }
-            void setOffsets(osg::Vec3Array* offsets) { mOffsets = offsets; }
+            void setOffsets(osg::Vec3Array* offsets) { mOffsets = offsets; updateRanges(); }
+            /// The vertices this target moves, i.e. those with a non-zero offset (and short gaps between them).
+            /// @note Computed when the offsets are set, modifying the offsets in place is not supported.
+            const VertexRanges& getRanges() const { return mRanges; }
         };
 
         typedef std::vector<MorphTarget> MorphTargetList;
@@ -48,7 +57,8 @@ namespace SceneUtil
         /** Get the list of MorphTargets.*/
         const MorphTargetList& getMorphTargetList() const { return mMorphTargets; }
 
-        /** Get the list of MorphTargets. Warning if you modify this array you will have to call dirty() */
+        /** Get the list of MorphTargets. Warning if you modify this array you will have to call dirty(), and must not add or
+            remove targets or change their offsets. */
         MorphTargetList& getMorphTargetList() { return mMorphTargets; }
 
         /** Return the \c MorphTarget at position \c i.*/
@@ -67,6 +77,7 @@ namespace SceneUtil
 
     private:
         void cull(osg::NodeVisitor* nv);
+        void updateMorphedRanges();
 
         MorphTargetList mMorphTargets;
 
@@ -75,6 +86,8 @@ namespace SceneUtil
         osg::ref_ptr<osg::Geometry> mGeometry[2];
         osg::Geometry* getGeometry(unsigned int frame) const;
 
+        VertexRanges mMorphedRanges; // of all morph targets, merged. Vertices outside of them never change.
+
         unsigned int mLastFrameNumber;
         bool mDirty; // Have any morph targets changed?
 
@@ -1,11 +1,14 @@
 #include "riggeometry.hpp"
 
+#include <atomic>
+
 #include <osg/Version>
 
 #include <components/debug/debuglog.hpp>
 
 #include "skeleton.hpp"
 #include "util.hpp"
+#include "workqueue.hpp"
 
 namespace
 {
@@ -30,13 +33,137 @@ namespace
         ptrresult[13] += ptr[13] * weight;
         ptrresult[14] += ptr[14] * weight;
     }
+
+    /// Transform vectors given as separate component arrays by an affine matrix, like osg::Matrixf::preMult or transform3x3.
+    /// @note Written as a plain loop over contiguous arrays so that the compiler can vectorize it for the target's instruction set.
+    /// The arrays must not overlap, otherwise the compiler would have to check for that before using vector instructions.
+    void transformPacked(const float* __restrict x, const float* __restrict y, const float* __restrict z, unsigned int count,
+                         const osg::Matrixf& matrix, bool translate, float* __restrict outX, float* __restrict outY, float* __restrict outZ)
+    {
+        const float* m = matrix.ptr();
+        const float m00 = m[0], m01 = m[1], m02 = m[2];
+        const float m10 = m[4], m11 = m[5], m12 = m[6];
+        const float m20 = m[8], m21 = m[9], m22 = m[10];
+        const float m30 = translate ? m[12] : 0.f, m31 = translate ? m[13] : 0.f, m32 = translate ? m[14] : 0.f;
+        for (unsigned int i=0; i<count; ++i)
+        {
+            outX[i] = x[i] * m00 + y[i] * m10 + z[i] * m20 + m30;
+            outY[i] = x[i] * m01 + y[i] * m11 + z[i] * m21 + m31;
+            outZ[i] = x[i] * m02 + y[i] * m12 + z[i] * m22 + m32;
+        }
+    }
+
+    // Below this, handing the skinning to another thread costs more than it saves
+    const unsigned int sMinVerticesToSkinInParallel = 256;
+
+    osg::ref_ptr<SceneUtil::WorkQueue>& getSkinningWorkQueue()
+    {
+        static osg::ref_ptr<SceneUtil::WorkQueue> queue;
+        return queue;
+    }
 }
 
 namespace SceneUtil
 {
 
+class RigGeometry::SkinningWorkItem : public WorkItem
+{
+public:
+    SkinningWorkItem(const RigGeometry* rig, osg::Geometry* geom, const std::vector<osg::Matrixf>* matrices)
+        : mRig(rig)
+        , mGeometry(geom)
+        , mMatrices(matrices)
+        , mStarted(false)
+    {
+    }
+
+    void doWork() override
+    {
+        skinIfNotStarted();
+    }
+
+    /// Wait for the skinning to complete. Rather than waiting for a worker thread to get to it, skins in the calling thread
+    /// if no worker has started yet.
+    void complete()
+    {
+        if (isDone())
+            return;
+        if (skinIfNotStarted())
+            signalDone();
+        else
+            waitTillDone();
+    }
+
+private:
+    bool skinIfNotStarted()
+    {
+        if (mStarted.exchange(true))
+            return false;
+        mRig->skin(*mGeometry, *mMatrices);
+        return true;
+    }
+
+    // the RigGeometry completes the work before it is deleted
+    const RigGeometry* mRig;
+    osg::Geometry* mGeometry;
+    const std::vector<osg::Matrixf>* mMatrices;
+    std::atomic<bool> mStarted;
+};
+
+/// The geometry a RigGeometry is rendered with. Completes its skinning before the vertices are used.
+class RigGeometry::SkinnedGeometry : public osg::Geometry
+{
+public:
+    SkinnedGeometry() {}
+
+    SkinnedGeometry(const osg::Geometry& copy, const osg::CopyOp& copyop)
+        : osg::Geometry(copy, copyop)
+    {
+    }
+
+    SkinnedGeometry(const SkinnedGeometry& copy, const osg::CopyOp& copyop)
+        : osg::Geometry(copy, copyop)
+    {
+    }
+
+    META_Object(SceneUtil, SkinnedGeometry)
+
+    using osg::Geometry::accept;
+
+    void setPendingSkinning(SkinningWorkItem* item) { mPendingSkinning = item; }
+
+    void waitForSkinning() const
+    {
+        if (mPendingSkinning)
+            mPendingSkinning->complete();
+    }
+
+    void drawImplementation(osg::RenderInfo& renderInfo) const override
+    {
+        waitForSkinning();
+        osg::Geometry::drawImplementation(renderInfo);
+    }
+
+    void accept(osg::PrimitiveFunctor& functor) const override
+    {
+        waitForSkinning();
+        osg::Geometry::accept(functor);
+    }
+
+    void accept(osg::PrimitiveIndexFunctor& functor) const override
+    {
+        waitForSkinning();
+        osg::Geometry::accept(functor);
+    }
+
+private:
+    // Only replaced by the cull traversal that skins this geometry again, after the previous frame using it was drawn.
+    osg::ref_ptr<SkinningWorkItem> mPendingSkinning;
+};
+
 RigGeometry::RigGeometry()
-    : mSkeleton(nullptr)
+    : mCurrentGeometry(0)
+    , mSkeleton(nullptr)
     , mLastFrameNumber(0)
     , mBoundsFirstFrame(true)
 {
@@ -46,9 +173,11 @@ RigGeometry::RigGeometry()
 
 RigGeometry::RigGeometry(const RigGeometry &copy, const osg::CopyOp &copyop)
     : Drawable(copy, copyop)
+    , mCurrentGeometry(0)
     , mSkeleton(nullptr)
     , mInfluenceMap(copy.mInfluenceMap)
     , mBone2VertexVector(copy.mBone2VertexVector)
+    , mSkinData(copy.mSkinData)
     , mBoneSphereVector(copy.mBoneSphereVector)
     , mLastFrameNumber(0)
     , mBoundsFirstFrame(true)
@@ -57,14 +186,31 @@ RigGeometry::RigGeometry(const RigGeometry &copy, const osg::CopyOp &copyop)
     setNumChildrenRequiringUpdateTraversal(1);
 }
 
+RigGeometry::~RigGeometry()
+{
+    for (unsigned int i=0; i<2; ++i)
+    {
+        if (mGeometry[i])
+            mGeometry[i]->waitForSkinning();
+    }
+}
+
+void RigGeometry::setSkinningWorkQueue(WorkQueue* queue)
+{
+    getSkinningWorkQueue() = queue;
+}
+
 void RigGeometry::setSourceGeometry(osg::ref_ptr<osg::Geometry> sourceGeometry)
 {
     mSourceGeometry = sourceGeometry;
 
     for (unsigned int i=0; i<2; ++i)
     {
+        if (mGeometry[i])
+            mGeometry[i]->waitForSkinning();
+
         const osg::Geometry& from = *sourceGeometry;
-        mGeometry[i] = new osg::Geometry(from, osg::CopyOp::SHALLOW_COPY);
+        mGeometry[i] = new SkinnedGeometry(from, osg::CopyOp::SHALLOW_COPY);
         osg::Geometry& to = *mGeometry[i];
         to.setSupportsDisplayList(false);
         to.setUseVertexBufferObjects(true);
@@ -104,6 +250,8 @@ void RigGeometry::setSourceGeometry(osg::ref_ptr<osg::Geometry> sourceGeometry)
         else
             mSourceTangents = nullptr;
     }
+
+    initSkinData();
 }
 
 osg::ref_ptr<osg::Geometry> RigGeometry::getSourceGeometry()
@@ -182,37 +330,72 @@ void RigGeometry::cull(osg::NodeVisitor* nv)
     }
 
     unsigned int traversalNumber = nv->getTraversalNumber();
-    if (mLastFrameNumber == traversalNumber || (mLastFrameNumber != 0 && !mSkeleton->getActive()))
+    // Skeletons with a reduced update rate leave their bones untouched in some frames
+    bool bonesChanged = mSkeleton->getLastUpdateFrameNumber() == 0 || mSkeleton->getLastUpdateFrameNumber() > mLastFrameNumber;
+    if (mLastFrameNumber == traversalNumber || (mLastFrameNumber != 0 && (!mSkeleton->getActive() || !bonesChanged)))
     {
-        osg::Geometry& geom = *getGeometry(mLastFrameNumber);
+        osg::Geometry& geom = *getGeometry();
         nv->pushOntoNodePath(&geom);
         nv->apply(geom);
         nv->popFromNodePath();
         return;
     }
     mLastFrameNumber = traversalNumber;
-    osg::Geometry& geom = *getGeometry(mLastFrameNumber);
+    // Alternate by skinning rather than by frame, the last skinned geometry may have been drawn in the previous frame
+    // even if it was skinned before that.
+    mCurrentGeometry = 1 - mCurrentGeometry;
+    SkinnedGeometry& geom = *mGeometry[mCurrentGeometry];
 
     mSkeleton->updateBoneMatrices(traversalNumber);
 
-    // skinning
-    const osg::Vec3Array* positionSrc = static_cast<osg::Vec3Array*>(mSourceGeometry->getVertexArray());
-    const osg::Vec3Array* normalSrc = static_cast<osg::Vec3Array*>(mSourceGeometry->getNormalArray());
-    const osg::Vec4Array* tangentSrc = mSourceTangents;
+    // The bone matrices may be changed by the next frame's update before the skinning is done, so the transforms of the
+    // vertex groups are computed right away. The remaining per vertex work is what is worth doing in parallel.
+    std::vector<osg::Matrixf>& matrices = mSkinMatrices[mCurrentGeometry];
+    geom.waitForSkinning(); // normally done long ago, when the geometry was last drawn
+    computeSkinMatrices(matrices);
 
-    osg::Vec3Array* positionDst = static_cast<osg::Vec3Array*>(geom.getVertexArray());
-    osg::Vec3Array* normalDst = static_cast<osg::Vec3Array*>(geom.getNormalArray());
-    osg::Vec4Array* tangentDst = static_cast<osg::Vec4Array*>(geom.getTexCoordArray(7));
+    osg::ref_ptr<WorkQueue> queue = getSkinningWorkQueue();
+    if (queue && mSourceGeometry->getVertexArray()->getNumElements() >= sMinVerticesToSkinInParallel)
+    {
+        osg::ref_ptr<SkinningWorkItem> item = new SkinningWorkItem(this, &geom, &matrices);
+        geom.setPendingSkinning(item);
+        queue->addWorkItem(item);
+    }
+    else
+    {
+        geom.setPendingSkinning(nullptr);
+        skin(geom, matrices);
+    }
+
+    geom.getVertexArray()->dirty();
+    if (osg::Array* normals = geom.getNormalArray())
+        normals->dirty();
+    if (osg::Array* tangents = geom.getTexCoordArray(7))
+        tangents->dirty();
+
+#if OSG_MIN_VERSION_REQUIRED(3, 5, 6)
+    geom.dirtyGLObjects();
+#endif
+
+    nv->pushOntoNodePath(&geom);
+    nv->apply(geom);
+    nv->popFromNodePath();
+}
+
+void RigGeometry::computeSkinMatrices(std::vector<osg::Matrixf>& matrices)
+{
+    matrices.resize(mBone2VertexVector->mData.size());
 
     int index = mBoneSphereVector->mData.size();
-    for (auto &pair : mBone2VertexVector->mData)
+    for (size_t i=0; i<mBone2VertexVector->mData.size(); ++i)
     {
-        osg::Matrixf resultMat (0, 0, 0, 0,
-                                0, 0, 0, 0,
-                                0, 0, 0, 0,
-                                0, 0, 0, 1);
+        osg::Matrixf& resultMat = matrices[i];
+        resultMat.set(0, 0, 0, 0,
+                      0, 0, 0, 0,
+                      0, 0, 0, 0,
+                      0, 0, 0, 1);
 
-        for (auto &weight : pair.first)
+        for (auto &weight : mBone2VertexVector->mData[i].first)
         {
             Bone* bone = mBoneNodesVector[index];
             if (bone == nullptr)
@@ -224,35 +407,60 @@ void RigGeometry::cull(osg::NodeVisitor* nv)
 
         if (mGeomToSkelMatrix)
             resultMat *= (*mGeomToSkelMatrix);
+    }
+}
 
-        for (auto &vertex : pair.second)
-        {
-            (*positionDst)[vertex] = resultMat.preMult((*positionSrc)[vertex]);
-            if (normalDst)
-                (*normalDst)[vertex] = osg::Matrixf::transform3x3((*normalSrc)[vertex], resultMat);
+void RigGeometry::skin(osg::Geometry& geom, const std::vector<osg::Matrixf>& matrices) const
+{
+    const SkinData& skinData = *mSkinData;
+    const osg::Vec4Array* tangentSrc = mSourceTangents;
 
-            if (tangentDst)
-            {
-                const osg::Vec4f& srcTangent = (*tangentSrc)[vertex];
-                osg::Vec3f transformedTangent = osg::Matrixf::transform3x3(osg::Vec3f(srcTangent.x(), srcTangent.y(), srcTangent.z()), resultMat);
-                (*tangentDst)[vertex] = osg::Vec4f(transformedTangent, srcTangent.w());
-            }
+    osg::Vec3Array* positionDst = static_cast<osg::Vec3Array*>(geom.getVertexArray());
+    osg::Vec3Array* normalDst = skinData.mNormals[0].empty() ? nullptr : static_cast<osg::Vec3Array*>(geom.getNormalArray());
+    osg::Vec4Array* tangentDst = skinData.mTangents[0].empty() ? nullptr : static_cast<osg::Vec4Array*>(geom.getTexCoordArray(7));
+
+    // transformed components of a group's vertices, before they are written to the geometry's interleaved arrays
+    thread_local std::vector<float> transformed[3];
+
+    unsigned int groupBegin = 0;
+    for (size_t i=0; i<skinData.mGroupEnds.size(); ++i)
+    {
+        const osg::Matrixf& resultMat = matrices[i];
+        const unsigned int groupEnd = skinData.mGroupEnds[i];
+        const unsigned int count = groupEnd - groupBegin;
+        if (transformed[0].size() < count)
+        {
+            for (int c=0; c<3; ++c)
+                transformed[c].resize(count);
         }
-    }
+        float* outX = transformed[0].data();
+        float* outY = transformed[1].data();
+        float* outZ = transformed[2].data();
+        const unsigned short* vertices = &skinData.mVertices[groupBegin];
 
-    positionDst->dirty();
-    if (normalDst)
-        normalDst->dirty();
-    if (tangentDst)
-        tangentDst->dirty();
+        transformPacked(&skinData.mPositions[0][groupBegin], &skinData.mPositions[1][groupBegin], &skinData.mPositions[2][groupBegin],
+                        count, resultMat, true, outX, outY, outZ);
+        for (unsigned int j=0; j<count; ++j)
+            (*positionDst)[vertices[j]].set(outX[j], outY[j], outZ[j]);
 
-#if OSG_MIN_VERSION_REQUIRED(3, 5, 6)
-    geom.dirtyGLObjects();
-#endif
+        if (normalDst)
+        {
+            transformPacked(&skinData.mNormals[0][groupBegin], &skinData.mNormals[1][groupBegin], &skinData.mNormals[2][groupBegin],
+                            count, resultMat, false, outX, outY, outZ);
+            for (unsigned int j=0; j<count; ++j)
+                (*normalDst)[vertices[j]].set(outX[j], outY[j], outZ[j]);
+        }
 
-    nv->pushOntoNodePath(&geom);
-    nv->apply(geom);
-    nv->popFromNodePath();
+        if (tangentDst)
+        {
+            transformPacked(&skinData.mTangents[0][groupBegin], &skinData.mTangents[1][groupBegin], &skinData.mTangents[2][groupBegin],
+                            count, resultMat, false, outX, outY, outZ);
+            for (unsigned int j=0; j<count; ++j)
+                (*tangentDst)[vertices[j]].set(outX[j], outY[j], outZ[j], (*tangentSrc)[vertices[j]].w());
+        }
+
+        groupBegin = groupEnd;
+    }
 }
 
 void RigGeometry::updateBounds(osg::NodeVisitor *nv)
@@ -364,6 +572,58 @@ void RigGeometry::setInfluenceMap(osg::ref_ptr<InfluenceMap> influenceMap)
 
     mBone2VertexVector->mData.reserve(bone2VertexMap.size());
     mBone2VertexVector->mData.assign(bone2VertexMap.begin(), bone2VertexMap.end());
+
+    initSkinData();
+}
+
+void RigGeometry::initSkinData()
+{
+    if (!mSourceGeometry || !mBone2VertexVector)
+        return;
+    // shared between copies of the same RigGeometry
+    if (mSkinData && mSkinData->mSourceGeometry == mSourceGeometry && mSkinData->mBone2VertexVector == mBone2VertexVector)
+        return;
+
+    osg::ref_ptr<SkinData> skinData = new SkinData;
+    skinData->mSourceGeometry = mSourceGeometry;
+    skinData->mBone2VertexVector = mBone2VertexVector;
+
+    const osg::Vec3Array* positions = static_cast<const osg::Vec3Array*>(mSourceGeometry->getVertexArray());
+    const osg::Vec3Array* normals = static_cast<const osg::Vec3Array*>(mSourceGeometry->getNormalArray());
+    const osg::Vec4Array* tangents = mSourceTangents;
+
+    size_t numVertices = 0;
+    for (auto& pair : mBone2VertexVector->mData)
+        numVertices += pair.second.size();
+    skinData->mVertices.reserve(numVertices);
+    skinData->mGroupEnds.reserve(mBone2VertexVector->mData.size());
+    for (int c=0; c<3; ++c)
+    {
+        skinData->mPositions[c].reserve(numVertices);
+        if (normals)
+            skinData->mNormals[c].reserve(numVertices);
+        if (tangents)
+            skinData->mTangents[c].reserve(numVertices);
+    }
+
+    for (auto& pair : mBone2VertexVector->mData)
+    {
+        for (unsigned short vertex : pair.second)
+        {
+            skinData->mVertices.push_back(vertex);
+            for (int c=0; c<3; ++c)
+            {
+                skinData->mPositions[c].push_back((*positions)[vertex][c]);
+                if (normals)
+                    skinData->mNormals[c].push_back((*normals)[vertex][c]);
+                if (tangents)
+                    skinData->mTangents[c].push_back((*tangents)[vertex][c]);
+            }
+        }
+        skinData->mGroupEnds.push_back(skinData->mVertices.size());
+    }
+
+    mSkinData = skinData;
 }
 
 void RigGeometry::accept(osg::NodeVisitor &nv)
@@ -385,12 +645,12 @@ void RigGeometry::accept(osg::NodeVisitor &nv)
 
 void RigGeometry::accept(osg::PrimitiveFunctor& func) const
 {
-    getGeometry(mLastFrameNumber)->accept(func);
+    getGeometry()->accept(func);
 }
 
-osg::Geometry* RigGeometry::getGeometry(unsigned int frame) const
+osg::Geometry* RigGeometry::getGeometry() const
 {
-    return mGeometry[frame%2].get();
+    return mGeometry[mCurrentGeometry].get();
 }
 
 
@@ -8,6 +8,7 @@ namespace SceneUtil
 {
     class Skeleton;
     class Bone;
+    class WorkQueue;
 
     /// @brief Mesh skinning implementation.
     /// @note A RigGeometry may be attached directly to a Skeleton, or somewhere below a Skeleton.
@@ -19,9 +20,16 @@ namespace SceneUtil
     public:
         RigGeometry();
         RigGeometry(const RigGeometry& copy, const osg::CopyOp& copyop);
+        ~RigGeometry();
 
         META_Object(SceneUtil, RigGeometry)
 
+        /// Skin the geometries that are visible in a frame on the given work queue, in parallel with the rest of the cull
+        /// traversal and with each other. The skinned data is waited for when it is drawn or intersected.
+        /// @param queue nullptr to skin in the cull traversal.
+        /// @note Not thread safe, set before rendering.
+        static void setSkinningWorkQueue(WorkQueue* queue);
+
         // Currently empty as this is difficult to implement. Technically we would need to compile both internal geometries in separate frames but this method is only called once. Alternatively we could compile just the static parts of the model.
         virtual void compileGLObjects(osg::RenderInfo& renderInfo) const {}
 
@@ -65,11 +73,23 @@ namespace SceneUtil
         };
 
     private:
+        class SkinnedGeometry;
+        class SkinningWorkItem;
+
         void cull(osg::NodeVisitor* nv);
         void updateBounds(osg::NodeVisitor* nv);
 
-        osg::ref_ptr<osg::Geometry> mGeometry[2];
-        osg::Geometry* getGeometry(unsigned int frame) const;
+        /// Compute the final transform of each vertex group for the bone matrices of the current frame.
+        void computeSkinMatrices(std::vector<osg::Matrixf>& matrices);
+        /// Apply the transforms of the vertex groups to the vertices of the given geometry.
+        /// @note Only reads data that does not change after initialization, so it can run in a worker thread.
+        void skin(osg::Geometry& geom, const std::vector<osg::Matrixf>& matrices) const;
+
+        osg::ref_ptr<SkinnedGeometry> mGeometry[2];
+        unsigned int mCurrentGeometry; // the one skinned last, the other one is skinned next
+        osg::Geometry* getGeometry() const;
+
+        std::vector<osg::Matrixf> mSkinMatrices[2]; // of the vertex groups, for the skinning of each geometry
 
         osg::ref_ptr<osg::Geometry> mSourceGeometry;
         osg::ref_ptr<const osg::Vec4Array> mSourceTangents;
@@ -93,6 +113,25 @@ namespace SceneUtil
         };
         osg::ref_ptr<Bone2VertexVector> mBone2VertexVector;
 
+        /// The source vertex data in the order of the vertex groups, with separate arrays for each component so that
+        /// the transforms of the groups can be applied with vectorized loops.
+        struct SkinData : public osg::Referenced
+        {
+            // what the data was built from
+            osg::ref_ptr<const osg::Geometry> mSourceGeometry;
+            osg::ref_ptr<const Bone2VertexVector> mBone2VertexVector;
+
+            std::vector<unsigned int> mGroupEnds; // index past the last vertex of each group
+            std::vector<unsigned short> mVertices; // index in the geometry of each vertex
+
+            std::vector<float> mPositions[3];
+            std::vector<float> mNormals[3];
+            std::vector<float> mTangents[3];
+        };
+        osg::ref_ptr<const SkinData> mSkinData;
+
+        void initSkinData();
+
         struct BoneSphereVector : public osg::Referenced
         {
             std::vector<std::pair<std::string, osg::BoundingSpheref>> mData;
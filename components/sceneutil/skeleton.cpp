@@ -1,11 +1,21 @@
 #include "skeleton.hpp"
 
+#include <atomic>
+
 #include <osg/Transform>
 #include <osg/MatrixTransform>
 
 #include <components/debug/debuglog.hpp>
 #include <components/misc/stringops.hpp>
 
+namespace
+{
+    float sHalfRateDistance = 0.f;
+    float sQuarterRateDistance = 0.f;
+
+    std::atomic<unsigned int> sNextUpdatePhase(0);
+}
+
 namespace SceneUtil
 {
 
@@ -38,6 +48,9 @@ Skeleton::Skeleton()
     , mActive(Active)
     , mLastFrameNumber(0)
     , mLastCullFrameNumber(0)
+    , mLastUpdateFrameNumber(0)
+    , mViewDistance(0.f)
+    , mUpdatePhase(sNextUpdatePhase++)
 {
 
 }
@@ -49,6 +62,9 @@ Skeleton::Skeleton(const Skeleton &copy, const osg::CopyOp &copyop)
     , mActive(copy.mActive)
     , mLastFrameNumber(0)
     , mLastCullFrameNumber(0)
+    , mLastUpdateFrameNumber(0)
+    , mViewDistance(0.f)
+    , mUpdatePhase(sNextUpdatePhase++)
 {
 
 }
@@ -134,6 +150,21 @@ bool Skeleton::getActive() const
     return mActive != Inactive;
 }
 
+void Skeleton::setUpdateRateDistances(float halfRateDistance, float quarterRateDistance)
+{
+    sHalfRateDistance = halfRateDistance;
+    sQuarterRateDistance = quarterRateDistance;
+}
+
+unsigned int Skeleton::getUpdateInterval() const
+{
+    if (sQuarterRateDistance > 0.f && mViewDistance > sQuarterRateDistance)
+        return 4;
+    if (sHalfRateDistance > 0.f && mViewDistance > sHalfRateDistance)
+        return 2;
+    return 1;
+}
+
 void Skeleton::markDirty()
 {
     mLastFrameNumber = 0;
@@ -149,9 +180,19 @@ void Skeleton::traverse(osg::NodeVisitor& nv)
             return;
         if (mActive == SemiActive && mLastFrameNumber != 0 && mLastCullFrameNumber+3 <= nv.getTraversalNumber())
             return;
+        // distant skeletons skip the animation of some frames, the skinned geometry of the previous update is drawn instead
+        if (mLastFrameNumber != 0 && (nv.getTraversalNumber() + mUpdatePhase) % getUpdateInterval() != 0)
+            return;
+        mLastUpdateFrameNumber = nv.getTraversalNumber();
     }
     else if (nv.getVisitorType() == osg::NodeVisitor::CULL_VISITOR)
+    {
+        // a skeleton may be culled by several cameras in a frame, e.g. for reflections and shadows
+        float distance = nv.getDistanceToViewPoint(getBound().center(), false);
+        if (mLastCullFrameNumber != nv.getTraversalNumber() || distance < mViewDistance)
+            mViewDistance = distance;
         mLastCullFrameNumber = nv.getTraversalNumber();
+    }
 
     osg::Group::traverse(nv);
 }
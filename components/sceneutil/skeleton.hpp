@@ -60,6 +60,15 @@ namespace SceneUtil
 
         bool getActive() const;
 
+        /// Set the distances from the camera beyond which skeletons only update their bones every second and every fourth
+        /// frame. The frames are staggered between skeletons, so the cost is spread evenly. 0 disables the respective rate.
+        /// @note Not thread safe, set before rendering.
+        static void setUpdateRateDistances(float halfRateDistance, float quarterRateDistance);
+
+        /// The frame in which the bones were last animated by the update traversal, or 0 if never.
+        /// Skinned geometry that is newer than this does not need to be updated.
+        unsigned int getLastUpdateFrameNumber() const { return mLastUpdateFrameNumber; }
+
         void traverse(osg::NodeVisitor& nv);
 
         void markDirty();
@@ -82,6 +91,12 @@ namespace SceneUtil
 
         unsigned int mLastFrameNumber;
         unsigned int mLastCullFrameNumber;
+        unsigned int mLastUpdateFrameNumber;
+
+        float mViewDistance; // closest distance to the view point in the last frame that was culled
+        unsigned int mUpdatePhase; // to stagger the frames skipped by skeletons with a reduced update rate
+
+        unsigned int getUpdateInterval() const;
     };
 
 }
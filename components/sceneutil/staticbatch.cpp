@@ -0,0 +1,435 @@
+#include "staticbatch.hpp"
+
+#include <algorithm>
+#include <typeinfo>
+
+#include <osg/Geode>
+#include <osg/Geometry>
+#include <osg/MatrixTransform>
+
+namespace
+{
+    const unsigned int sMaxTexCoordUnits = 8;
+
+    const unsigned int sLayoutNormals = 1<<0;
+    const unsigned int sLayoutColors = 1<<1;
+
+    unsigned int getTexCoord2Layout(unsigned int unit)
+    {
+        return 1u << (2 + unit);
+    }
+
+    // Four component texture coordinates are tangents generated by the ShaderVisitor
+    unsigned int getTexCoord4Layout(unsigned int unit)
+    {
+        return 1u << (2 + sMaxTexCoordUnits + unit);
+    }
+
+    bool isHidden(const osg::Node& node)
+    {
+        // Hidden nodes only keep the bit of the update visitor, see NifOsg::Loader
+        return (node.getNodeMask() & ~0x1u) == 0;
+    }
+
+    bool hasCallbacks(const osg::Node& node)
+    {
+        return node.getUpdateCallback() || node.getCullCallback() || node.getEventCallback();
+    }
+
+    bool isPerVertexArray(const osg::Array* array, osg::Array::Type type, unsigned int numVertices)
+    {
+        return array->getType() == type && array->getBinding() == osg::Array::BIND_PER_VERTEX && array->getNumElements() >= numVertices;
+    }
+
+    /// @return false if the geometry has arrays that can not be merged.
+    bool getLayout(const osg::Geometry& geometry, unsigned int& layout)
+    {
+        const osg::Array* vertices = geometry.getVertexArray();
+        if (!vertices || vertices->getType() != osg::Array::Vec3ArrayType || vertices->getNumElements() == 0)
+            return false;
+        unsigned int numVertices = vertices->getNumElements();
+
+        layout = 0;
+        if (const osg::Array* normals = geometry.getNormalArray())
+        {
+            if (!isPerVertexArray(normals, osg::Array::Vec3ArrayType, numVertices))
+                return false;
+            layout |= sLayoutNormals;
+        }
+        if (const osg::Array* colors = geometry.getColorArray())
+        {
+            if (!isPerVertexArray(colors, osg::Array::Vec4ArrayType, numVertices))
+                return false;
+            layout |= sLayoutColors;
+        }
+
+        const osg::Geometry::ArrayList& texCoords = geometry.getTexCoordArrayList();
+        for (unsigned int unit=0; unit<texCoords.size(); ++unit)
+        {
+            const osg::Array* array = texCoords[unit].get();
+            if (!array)
+                continue;
+            if (unit >= sMaxTexCoordUnits)
+                return false;
+            if (isPerVertexArray(array, osg::Array::Vec2ArrayType, numVertices))
+                layout |= getTexCoord2Layout(unit);
+            else if (isPerVertexArray(array, osg::Array::Vec4ArrayType, numVertices))
+                layout |= getTexCoord4Layout(unit);
+            else
+                return false;
+        }
+
+        for (const auto& array : geometry.getVertexAttribArrayList())
+        {
+            if (array)
+                return false;
+        }
+        return true;
+    }
+
+    bool canMergePrimitives(const osg::Geometry& geometry)
+    {
+        for (unsigned int i=0; i<geometry.getNumPrimitiveSets(); ++i)
+        {
+            const osg::PrimitiveSet* primitives = geometry.getPrimitiveSet(i);
+            if (primitives->getNumInstances() != 0)
+                return false;
+
+            switch (primitives->getType())
+            {
+                case osg::PrimitiveSet::DrawArraysPrimitiveType:
+                case osg::PrimitiveSet::DrawElementsUBytePrimitiveType:
+                case osg::PrimitiveSet::DrawElementsUShortPrimitiveType:
+                case osg::PrimitiveSet::DrawElementsUIntPrimitiveType:
+                    break;
+                default:
+                    return false;
+            }
+
+            if (primitives->getMode() != osg::PrimitiveSet::TRIANGLES && primitives->getMode() != osg::PrimitiveSet::TRIANGLE_STRIP)
+                return false;
+        }
+        return true;
+    }
+
+    bool canMergeGeometry(const osg::Drawable& drawable)
+    {
+        // Subclasses like particle systems or rig geometry are drawn differently
+        if (typeid(drawable) != typeid(osg::Geometry))
+            return false;
+        if (hasCallbacks(drawable) || drawable.getDrawCallback())
+            return false;
+
+        const osg::Geometry& geometry = static_cast<const osg::Geometry&>(drawable);
+        unsigned int layout;
+        return getLayout(geometry, layout) && canMergePrimitives(geometry);
+    }
+
+    /// Append the triangles of the given primitives to \a indices, offset by \a base.
+    void appendTriangles(const osg::PrimitiveSet& primitives, unsigned int base, unsigned int numVertices, osg::DrawElementsUInt& indices)
+    {
+        unsigned int numIndices = primitives.getNumIndices();
+        if (numIndices < 3)
+            return;
+
+        bool strip = primitives.getMode() == osg::PrimitiveSet::TRIANGLE_STRIP;
+        unsigned int step = strip ? 1 : 3;
+        for (unsigned int i=0; i+2<numIndices; i+=step)
+        {
+            unsigned int a = primitives.index(i);
+            unsigned int b = primitives.index(i+1);
+            unsigned int c = primitives.index(i+2);
+            if (a >= numVertices || b >= numVertices || c >= numVertices)
+                continue;
+
+            if (strip)
+            {
+                // Skip the degenerate triangles used to join strips
+                if (a == b || b == c || a == c)
+                    continue;
+                // Every other triangle of a strip has reversed winding
+                if (i % 2 == 1)
+                    std::swap(a, b);
+            }
+
+            indices.push_back(base + a);
+            indices.push_back(base + b);
+            indices.push_back(base + c);
+        }
+    }
+}
+
+namespace SceneUtil
+{
+
+    void StaticBatch::hideInstance(const void* id)
+    {
+        if (!mHidden.insert(id).second)
+            return;
+
+        for (MergedDrawable& drawable : mDrawables)
+        {
+            bool affected = false;
+            for (const Range& range : drawable.mRanges)
+            {
+                if (range.mId == id)
+                {
+                    affected = true;
+                    break;
+                }
+            }
+            if (!affected || !drawable.mGeometry)
+                continue;
+
+            osg::ref_ptr<osg::DrawElementsUInt> indices (new osg::DrawElementsUInt(osg::PrimitiveSet::TRIANGLES));
+            for (const Range& range : drawable.mRanges)
+            {
+                if (mHidden.find(range.mId) == mHidden.end())
+                    indices->insert(indices->end(), drawable.mIndices->begin() + range.mFirst, drawable.mIndices->begin() + range.mFirst + range.mCount);
+            }
+
+            if (indices->empty())
+            {
+                drawable.mParent->removeChild(drawable.mGeometry);
+                drawable.mGeometry = nullptr;
+                continue;
+            }
+
+            osg::ref_ptr<osg::Geometry> geometry (new osg::Geometry(*drawable.mGeometry, osg::CopyOp::SHALLOW_COPY));
+            geometry->setPrimitiveSet(0, indices);
+            drawable.mParent->replaceChild(drawable.mGeometry, geometry);
+            drawable.mGeometry = geometry;
+        }
+    }
+
+    struct StaticBatchBuilder::Merged
+    {
+        std::vector<osg::ref_ptr<const osg::StateSet> > mStateSets;
+
+        osg::ref_ptr<osg::Vec3Array> mVertices;
+        osg::ref_ptr<osg::Vec3Array> mNormals;
+        osg::ref_ptr<osg::Vec4Array> mColors;
+        osg::ref_ptr<osg::Vec2Array> mTexCoords2[sMaxTexCoordUnits];
+        osg::ref_ptr<osg::Vec4Array> mTexCoords4[sMaxTexCoordUnits];
+
+        osg::ref_ptr<osg::DrawElementsUInt> mIndices;
+
+        // The ranges of the instances in mIndices, in order
+        std::vector<StaticBatch::Range> mRanges;
+    };
+
+    bool StaticBatchBuilder::Key::operator<(const Key& other) const
+    {
+        if (mLayout != other.mLayout)
+            return mLayout < other.mLayout;
+        return mStateSets < other.mStateSets;
+    }
+
+    StaticBatchBuilder::StaticBatchBuilder(const osg::Vec3f& origin)
+        : mOrigin(origin)
+    {
+    }
+
+    StaticBatchBuilder::~StaticBatchBuilder()
+    {
+    }
+
+    bool StaticBatchBuilder::canBatch(const osg::Node& node)
+    {
+        if (isHidden(node))
+            return true;
+
+        if (const osg::Drawable* drawable = node.asDrawable())
+            return canMergeGeometry(*drawable);
+
+        if (hasCallbacks(node))
+            return false;
+
+        if (const osg::Transform* transform = node.asTransform())
+        {
+            if (!transform->asMatrixTransform() || transform->getReferenceFrame() != osg::Transform::RELATIVE_RF)
+                return false;
+        }
+        else if (typeid(node) != typeid(osg::Group) && typeid(node) != typeid(osg::Geode))
+            return false;
+
+        const osg::Group* group = node.asGroup();
+        for (unsigned int i=0; i<group->getNumChildren(); ++i)
+        {
+            if (!canBatch(*group->getChild(i)))
+                return false;
+        }
+        return true;
+    }
+
+    bool StaticBatchBuilder::addInstance(const osg::Node& node, const osg::Matrix& transform, const void* id)
+    {
+        if (!canBatch(node))
+            return false;
+
+        std::vector<const osg::StateSet*> stateSets;
+        merge(node, transform * osg::Matrix::translate(-mOrigin), stateSets, id);
+        mInstances.push_back(id);
+        return true;
+    }
+
+    void StaticBatchBuilder::merge(const osg::Node& node, const osg::Matrix& transform, std::vector<const osg::StateSet*>& stateSets, const void* id)
+    {
+        if (isHidden(node))
+            return;
+
+        if (const osg::Geometry* geometry = node.asGeometry())
+        {
+            Key key;
+            key.mStateSets = stateSets;
+            // The geometry's own state set always goes last, so that it is restored on the merged geometry
+            key.mStateSets.push_back(geometry->getStateSet());
+            getLayout(*geometry, key.mLayout);
+
+            std::unique_ptr<Merged>& merged = mMerged[key];
+            if (!merged)
+            {
+                merged.reset(new Merged);
+                merged->mStateSets.assign(key.mStateSets.begin(), key.mStateSets.end());
+                merged->mVertices = new osg::Vec3Array;
+                if (key.mLayout & sLayoutNormals)
+                    merged->mNormals = new osg::Vec3Array;
+                if (key.mLayout & sLayoutColors)
+                    merged->mColors = new osg::Vec4Array;
+                for (unsigned int unit=0; unit<sMaxTexCoordUnits; ++unit)
+                {
+                    if (key.mLayout & getTexCoord2Layout(unit))
+                        merged->mTexCoords2[unit] = new osg::Vec2Array;
+                    else if (key.mLayout & getTexCoord4Layout(unit))
+                        merged->mTexCoords4[unit] = new osg::Vec4Array;
+                }
+                merged->mIndices = new osg::DrawElementsUInt(osg::PrimitiveSet::TRIANGLES);
+            }
+
+            const osg::Vec3Array* vertices = static_cast<const osg::Vec3Array*>(geometry->getVertexArray());
+            unsigned int numVertices = vertices->size();
+            unsigned int base = merged->mVertices->size();
+
+            osg::Matrixf matrix (transform);
+            for (const osg::Vec3f& vertex : *vertices)
+                merged->mVertices->push_back(vertex * matrix);
+
+            // Directions are transformed without the translation, normals with the inverse transpose to support non-uniform scaling
+            osg::Matrixf normalMatrix = osg::Matrixf::inverse(matrix);
+            if (merged->mNormals)
+            {
+                const osg::Vec3Array* normals = static_cast<const osg::Vec3Array*>(geometry->getNormalArray());
+                for (unsigned int i=0; i<numVertices; ++i)
+                {
+                    osg::Vec3f normal = osg::Matrixf::transform3x3(normalMatrix, (*normals)[i]);
+                    normal.normalize();
+                    merged->mNormals->push_back(normal);
+                }
+            }
+            if (merged->mColors)
+            {
+                const osg::Vec4Array* colors = static_cast<const osg::Vec4Array*>(geometry->getColorArray());
+                merged->mColors->insert(merged->mColors->end(), colors->begin(), colors->begin() + numVertices);
+            }
+            for (unsigned int unit=0; unit<sMaxTexCoordUnits; ++unit)
+            {
+                if (merged->mTexCoords2[unit])
+                {
+                    const osg::Vec2Array* texCoords = static_cast<const osg::Vec2Array*>(geometry->getTexCoordArray(unit));
+                    merged->mTexCoords2[unit]->insert(merged->mTexCoords2[unit]->end(), texCoords->begin(), texCoords->begin() + numVertices);
+                }
+                else if (merged->mTexCoords4[unit])
+                {
+                    const osg::Vec4Array* tangents = static_cast<const osg::Vec4Array*>(geometry->getTexCoordArray(unit));
+                    for (unsigned int i=0; i<numVertices; ++i)
+                    {
+                        const osg::Vec4f& tangent = (*tangents)[i];
+                        osg::Vec3f direction = osg::Matrixf::transform3x3(osg::Vec3f(tangent.x(), tangent.y(), tangent.z()), matrix);
+                        direction.normalize();
+                        merged->mTexCoords4[unit]->push_back(osg::Vec4f(direction, tangent.w()));
+                    }
+                }
+            }
+
+            unsigned int first = merged->mIndices->size();
+            for (unsigned int i=0; i<geometry->getNumPrimitiveSets(); ++i)
+                appendTriangles(*geometry->getPrimitiveSet(i), base, numVertices, *merged->mIndices);
+            unsigned int count = merged->mIndices->size() - first;
+
+            // Merge with the previous range if the instance contributes several geometries with the same state
+            if (!merged->mRanges.empty() && merged->mRanges.back().mId == id)
+                merged->mRanges.back().mCount += count;
+            else if (count > 0)
+                merged->mRanges.push_back({id, first, count});
+            return;
+        }
+
+        osg::Matrix childTransform = transform;
+        if (const osg::MatrixTransform* matrixTransform = node.asTransform() ? node.asTransform()->asMatrixTransform() : nullptr)
+            childTransform = matrixTransform->getMatrix() * transform;
+
+        bool hasStateSet = node.getStateSet() != nullptr;
+        if (hasStateSet)
+            stateSets.push_back(node.getStateSet());
+
+        const osg::Group* group = node.asGroup();
+        for (unsigned int i=0; i<group->getNumChildren(); ++i)
+            merge(*group->getChild(i), childTransform, stateSets, id);
+
+        if (hasStateSet)
+            stateSets.pop_back();
+    }
+
+    osg::ref_ptr<StaticBatch> StaticBatchBuilder::build()
+    {
+        osg::ref_ptr<StaticBatch> batch (new StaticBatch);
+        batch->mNode = new osg::MatrixTransform(osg::Matrix::translate(mOrigin));
+        batch->mNode->setName("Static Batch");
+        batch->mInstances = mInstances;
+
+        for (const auto& pair : mMerged)
+        {
+            const Merged& merged = *pair.second;
+            if (merged.mIndices->empty())
+                continue;
+
+            osg::ref_ptr<osg::Group> parent = batch->mNode;
+            for (size_t i=0; i+1<merged.mStateSets.size(); ++i)
+            {
+                osg::ref_ptr<osg::Group> group (new osg::Group);
+                group->setStateSet(const_cast<osg::StateSet*>(merged.mStateSets[i].get()));
+                parent->addChild(group);
+                parent = group;
+            }
+
+            osg::ref_ptr<osg::Geometry> geometry (new osg::Geometry);
+            geometry->setStateSet(const_cast<osg::StateSet*>(merged.mStateSets.back().get()));
+            geometry->setVertexArray(merged.mVertices);
+            if (merged.mNormals)
+                geometry->setNormalArray(merged.mNormals, osg::Array::BIND_PER_VERTEX);
+            if (merged.mColors)
+                geometry->setColorArray(merged.mColors, osg::Array::BIND_PER_VERTEX);
+            for (unsigned int unit=0; unit<sMaxTexCoordUnits; ++unit)
+            {
+                if (merged.mTexCoords2[unit])
+                    geometry->setTexCoordArray(unit, merged.mTexCoords2[unit], osg::Array::BIND_PER_VERTEX);
+                else if (merged.mTexCoords4[unit])
+                    geometry->setTexCoordArray(unit, merged.mTexCoords4[unit], osg::Array::BIND_PER_VERTEX);
+            }
+            geometry->addPrimitiveSet(merged.mIndices);
+            geometry->setUseDisplayList(false);
+            geometry->setUseVertexBufferObjects(true);
+            parent->addChild(geometry);
+
+            StaticBatch::MergedDrawable drawable;
+            drawable.mGeometry = geometry;
+            drawable.mParent = parent;
+            drawable.mIndices = merged.mIndices;
+            drawable.mRanges = merged.mRanges;
+            batch->mDrawables.push_back(drawable);
+        }
+
+        return batch;
+    }
+
+}
@@ -0,0 +1,114 @@
+#ifndef OPENMW_COMPONENTS_SCENEUTIL_STATICBATCH_H
+#define OPENMW_COMPONENTS_SCENEUTIL_STATICBATCH_H
+
+#include <map>
+#include <memory>
+#include <set>
+#include <vector>
+
+#include <osg/ref_ptr>
+#include <osg/Referenced>
+#include <osg/Matrix>
+#include <osg/Vec3f>
+
+namespace osg
+{
+    class Node;
+    class Group;
+    class MatrixTransform;
+    class Geometry;
+    class StateSet;
+    class DrawElementsUInt;
+}
+
+namespace SceneUtil
+{
+
+    /// @brief The geometry of many static scene instances, merged into one drawable per distinct rendering state.
+    /// @par Each instance occupies a range of the index list of every drawable it contributes to, so instances can still be
+    /// hidden individually after the batch was built.
+    class StaticBatch : public osg::Referenced
+    {
+    public:
+        /// The root of the merged scene graph. Attach it to the scene to draw the batch.
+        osg::MatrixTransform* getNode() { return mNode.get(); }
+
+        /// The IDs of the instances that were merged into this batch.
+        const std::vector<const void*>& getInstances() const { return mInstances; }
+
+        /// Stop drawing the given instance. The affected drawables are replaced by copies with a new index list,
+        /// so the draw traversal of the current frame can keep using the old ones.
+        /// @note Not thread safe, call from the thread that updates the scene graph.
+        void hideInstance(const void* id);
+
+    private:
+        friend class StaticBatchBuilder;
+
+        struct Range
+        {
+            const void* mId;
+            unsigned int mFirst;
+            unsigned int mCount;
+        };
+
+        struct MergedDrawable
+        {
+            osg::ref_ptr<osg::Geometry> mGeometry;
+            osg::ref_ptr<osg::Group> mParent;
+            osg::ref_ptr<osg::DrawElementsUInt> mIndices; // all instances
+            std::vector<Range> mRanges;
+        };
+
+        osg::ref_ptr<osg::MatrixTransform> mNode;
+        std::vector<MergedDrawable> mDrawables;
+        std::vector<const void*> mInstances;
+        std::set<const void*> mHidden;
+    };
+
+    /// @brief Merges static scene instances into a StaticBatch.
+    /// @par Only scenes made of plain groups, matrix transforms and osg::Geometry with triangle primitives can be merged.
+    /// Anything with callbacks (controllers, particles, billboards), switches or other special nodes is rejected, since
+    /// its rendering depends on more than the geometry.
+    /// @note Does not modify the given scenes, so it can be used from a worker thread with read-only scene templates.
+    class StaticBatchBuilder
+    {
+    public:
+        /// @param origin Vertices are stored relative to this point, which should be near the instances to keep precision.
+        StaticBatchBuilder(const osg::Vec3f& origin);
+        ~StaticBatchBuilder();
+
+        /// Check if the given scene can be merged.
+        static bool canBatch(const osg::Node& node);
+
+        /// Merge an instance of the given scene.
+        /// @param transform The world transform of the instance.
+        /// @param id Used to identify the instance in the resulting StaticBatch.
+        /// @return false if the scene can not be merged, in which case nothing is added.
+        bool addInstance(const osg::Node& node, const osg::Matrix& transform, const void* id);
+
+        size_t getNumInstances() const { return mInstances.size(); }
+
+        /// Create the merged scene graph out of the instances added so far.
+        osg::ref_ptr<StaticBatch> build();
+
+    private:
+        struct Key
+        {
+            std::vector<const osg::StateSet*> mStateSets; // of the nodes along the path to the geometry, then the geometry's own
+            unsigned int mLayout;
+
+            bool operator<(const Key& other) const;
+        };
+
+        struct Merged;
+
+        void merge(const osg::Node& node, const osg::Matrix& transform, std::vector<const osg::StateSet*>& stateSets, const void* id);
+
+        osg::Vec3f mOrigin;
+        std::map<Key, std::unique_ptr<Merged> > mMerged;
+        std::vector<const void*> mInstances;
+    };
+
+}
+
+#endif
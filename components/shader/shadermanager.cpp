@@ -8,6 +8,7 @@
 
 #include <boost/filesystem/path.hpp>
 #include <boost/filesystem/fstream.hpp>
+#include <boost/filesystem/operations.hpp>
 #include <boost/algorithm/string.hpp>
 
 #include <components/debug/debuglog.hpp>
@@ -15,6 +16,11 @@
 namespace Shader
 {
 
+    ShaderManager::ShaderManager()
+        : mRecordPermutations(false)
+    {
+    }
+
     void ShaderManager::setShaderPath(const std::string &path)
     {
         mPath = path;
@@ -270,9 +276,53 @@ namespace Shader
         return true;
     }
 
+    std::uint64_t ShaderManager::makeShaderKey(const std::string &shaderTemplate, const ShaderManager::DefineMap &defines)
+    {
+        // DefineMap is sorted, so equal define sets always produce the same key.
+        // Strings are terminated so that adjacent ones can't alias each other.
+        std::uint64_t hash = 14695981039346656037ull;
+        auto add = [&hash] (const std::string& value)
+        {
+            for (char c : value)
+            {
+                hash ^= static_cast<unsigned char>(c);
+                hash *= 1099511628211ull;
+            }
+            hash *= 1099511628211ull;
+        };
+
+        add(shaderTemplate);
+        for (const auto& define : defines)
+        {
+            add(define.first);
+            add(define.second);
+        }
+        return hash;
+    }
+
     osg::ref_ptr<osg::Shader> ShaderManager::getShader(const std::string &shaderTemplate, const ShaderManager::DefineMap &defines, osg::Shader::Type shaderType)
     {
         OpenThreads::ScopedLock<OpenThreads::Mutex> lock(mMutex);
+        return getShaderImpl(shaderTemplate, defines, shaderType);
+    }
+
+    osg::ref_ptr<osg::Shader> ShaderManager::getShaderImpl(const std::string &shaderTemplate, const ShaderManager::DefineMap &defines, osg::Shader::Type shaderType)
+    {
+        std::uint64_t key = makeShaderKey(shaderTemplate, defines);
+        ShaderMap::iterator shaderIt = mShaders.find(key);
+        bool collision = false;
+        if (shaderIt != mShaders.end())
+        {
+            if (shaderIt->second.mTemplate == shaderTemplate && shaderIt->second.mDefines == defines)
+                return shaderIt->second.mShader;
+
+            CollidingShaderMap::const_iterator found = mCollidingShaders.find(std::make_pair(shaderTemplate, defines));
+            if (found != mCollidingShaders.end())
+                return found->second.mShader;
+
+            Log(Debug::Verbose) << "Shader key collision between " << shaderTemplate << " and " << shaderIt->second.mTemplate;
+            collision = true;
+        }
 
         // read the template if we haven't already
         TemplateMap::iterator templateIt = mShaderTemplates.find(shaderTemplate);
@@ -297,31 +347,37 @@ namespace Shader
             templateIt = mShaderTemplates.insert(std::make_pair(shaderTemplate, source)).first;
         }
 
-        ShaderMap::iterator shaderIt = mShaders.find(std::make_pair(shaderTemplate, defines));
-        if (shaderIt == mShaders.end())
+        osg::ref_ptr<osg::Shader> shader;
+        std::string shaderSource = templateIt->second;
+        if (parseDefines(shaderSource, defines, mGlobalDefines) && parseFors(shaderSource))
         {
-            std::string shaderSource = templateIt->second;
-            if (!parseDefines(shaderSource, defines, mGlobalDefines) || !parseFors(shaderSource))
-            {
-                // Add to the cache anyway to avoid logging the same error over and over.
-                mShaders.insert(std::make_pair(std::make_pair(shaderTemplate, defines), nullptr));
-                return nullptr;
-            }
-
-            osg::ref_ptr<osg::Shader> shader (new osg::Shader(shaderType));
+            shader = new osg::Shader(shaderType);
             shader->setShaderSource(shaderSource);
             // Assign a unique name to allow the SharedStateManager to compare shaders efficiently
             static unsigned int counter = 0;
             shader->setName(std::to_string(counter++));
-
-            shaderIt = mShaders.insert(std::make_pair(std::make_pair(shaderTemplate, defines), shader)).first;
         }
-        return shaderIt->second;
+
+        // Add failed shaders to the cache anyway to avoid logging the same error over and over.
+        ShaderEntry& entry = collision ? mCollidingShaders[std::make_pair(shaderTemplate, defines)] : mShaders[key];
+        entry.mTemplate = shaderTemplate;
+        entry.mDefines = defines;
+        entry.mType = shaderType;
+        entry.mShader = shader;
+        // the key does not identify a colliding shader, so its programs are not recorded
+        if (shader && !collision)
+            mShaderKeys[shader.get()] = key;
+        return shader;
     }
 
     osg::ref_ptr<osg::Program> ShaderManager::getProgram(osg::ref_ptr<osg::Shader> vertexShader, osg::ref_ptr<osg::Shader> fragmentShader)
     {
         OpenThreads::ScopedLock<OpenThreads::Mutex> lock(mMutex);
+        return getProgramImpl(vertexShader, fragmentShader);
+    }
+
+    osg::ref_ptr<osg::Program> ShaderManager::getProgramImpl(osg::ref_ptr<osg::Shader> vertexShader, osg::ref_ptr<osg::Shader> fragmentShader)
+    {
         ProgramMap::iterator found = mPrograms.find(std::make_pair(vertexShader, fragmentShader));
         if (found == mPrograms.end())
         {
@@ -329,10 +385,135 @@ namespace Shader
             program->addShader(vertexShader);
             program->addShader(fragmentShader);
             found = mPrograms.insert(std::make_pair(std::make_pair(vertexShader, fragmentShader), program)).first;
+
+            if (mRecordPermutations)
+            {
+                auto vertexKey = mShaderKeys.find(vertexShader.get());
+                auto fragmentKey = mShaderKeys.find(fragmentShader.get());
+                // shaders that were not created by us can't be recreated
+                if (vertexKey != mShaderKeys.end() && fragmentKey != mShaderKeys.end())
+                    mRecordedPermutations.emplace(vertexKey->second, fragmentKey->second);
+            }
         }
         return found->second;
     }
 
+    void ShaderManager::setRecordPermutations(bool record)
+    {
+        OpenThreads::ScopedLock<OpenThreads::Mutex> lock(mMutex);
+        mRecordPermutations = record;
+    }
+
+    /* File format, one line per item:
+        program
+        shader <vertex|fragment> <template>
+        define <name> <value>
+        ...
+        shader <vertex|fragment> <template>
+        define <name> <value>
+        ...
+    */
+
+    std::vector<osg::ref_ptr<osg::Program> > ShaderManager::readPermutations(const std::string &path)
+    {
+        std::vector<osg::ref_ptr<osg::Program> > programs;
+
+        boost::filesystem::ifstream stream;
+        stream.open(boost::filesystem::path(path));
+        if (stream.fail())
+            return programs;
+
+        struct ShaderDesc
+        {
+            std::string mTemplate;
+            osg::Shader::Type mType;
+            DefineMap mDefines;
+        };
+        std::vector<ShaderDesc> shaders;
+
+        OpenThreads::ScopedLock<OpenThreads::Mutex> lock(mMutex);
+
+        auto createProgram = [&] ()
+        {
+            if (shaders.size() != 2 || shaders[0].mType != osg::Shader::VERTEX || shaders[1].mType != osg::Shader::FRAGMENT)
+                return;
+            osg::ref_ptr<osg::Shader> vertexShader = getShaderImpl(shaders[0].mTemplate, shaders[0].mDefines, shaders[0].mType);
+            osg::ref_ptr<osg::Shader> fragmentShader = getShaderImpl(shaders[1].mTemplate, shaders[1].mDefines, shaders[1].mType);
+            if (vertexShader && fragmentShader)
+                programs.push_back(getProgramImpl(vertexShader, fragmentShader));
+        };
+
+        std::string line;
+        while (std::getline(stream, line))
+        {
+            size_t separator = line.find(' ');
+            std::string item = line.substr(0, separator);
+            std::string rest = separator != std::string::npos ? line.substr(separator + 1) : std::string();
+
+            if (item == "program")
+            {
+                createProgram();
+                shaders.clear();
+            }
+            else if (item == "shader")
+            {
+                size_t typeEnd = rest.find(' ');
+                if (typeEnd == std::string::npos)
+                    continue;
+                ShaderDesc desc;
+                desc.mType = rest.compare(0, typeEnd, "vertex") == 0 ? osg::Shader::VERTEX : osg::Shader::FRAGMENT;
+                desc.mTemplate = rest.substr(typeEnd + 1);
+                shaders.push_back(desc);
+            }
+            else if (item == "define" && !shaders.empty())
+            {
+                size_t nameEnd = rest.find(' ');
+                if (nameEnd == std::string::npos)
+                    shaders.back().mDefines[rest] = std::string();
+                else
+                    shaders.back().mDefines[rest.substr(0, nameEnd)] = rest.substr(nameEnd + 1);
+            }
+        }
+        createProgram();
+
+        Log(Debug::Info) << "Created " << programs.size() << " shader programs from " << path;
+        return programs;
+    }
+
+    void ShaderManager::writePermutations(const std::string &path)
+    {
+        std::ostringstream stream;
+        {
+            OpenThreads::ScopedLock<OpenThreads::Mutex> lock(mMutex);
+            for (const auto& permutation : mRecordedPermutations)
+            {
+                stream << "program\n";
+                for (std::uint64_t key : { permutation.first, permutation.second })
+                {
+                    const ShaderEntry& entry = mShaders[key];
+                    stream << "shader " << (entry.mType == osg::Shader::VERTEX ? "vertex" : "fragment") << " " << entry.mTemplate << "\n";
+                    for (const auto& define : entry.mDefines)
+                        stream << "define " << define.first << " " << define.second << "\n";
+                }
+            }
+        }
+
+        try
+        {
+            boost::filesystem::path filePath(path);
+            if (filePath.has_parent_path())
+                boost::filesystem::create_directories(filePath.parent_path());
+            boost::filesystem::ofstream file(filePath, std::ios::binary);
+            file << stream.str();
+            if (file.fail())
+                Log(Debug::Warning) << "Failed to write shader permutations to " << path;
+        }
+        catch (std::exception& e)
+        {
+            Log(Debug::Warning) << "Failed to write shader permutations to " << path << ": " << e.what();
+        }
+    }
+
     ShaderManager::DefineMap ShaderManager::getGlobalDefines()
     {
         return DefineMap(mGlobalDefines);
@@ -341,21 +522,25 @@ namespace Shader
     void ShaderManager::setGlobalDefines(DefineMap & globalDefines)
     {
         mGlobalDefines = globalDefines;
-        for (auto shaderMapElement: mShaders)
+        auto updateShader = [this] (const ShaderEntry& entry)
         {
-            std::string templateId = shaderMapElement.first.first;
-            ShaderManager::DefineMap defines = shaderMapElement.first.second;
-            osg::ref_ptr<osg::Shader> shader = shaderMapElement.second;
+            std::string templateId = entry.mTemplate;
+            ShaderManager::DefineMap defines = entry.mDefines;
+            osg::ref_ptr<osg::Shader> shader = entry.mShader;
             if (shader == nullptr)
                 // I'm not sure how to handle a shader that was already broken as there's no way to get a potential replacement to the nodes that need it.
-                continue;
+                return;
             std::string shaderSource = mShaderTemplates[templateId];
             if (!parseDefines(shaderSource, defines, mGlobalDefines) || !parseFors(shaderSource))
                 // We just broke the shader and there's no way to force existing objects back to fixed-function mode as we would when creating the shader.
                 // If we put a nullptr in the shader map, we just lose the ability to put a working one in later.
-                continue;
+                return;
             shader->setShaderSource(shaderSource);
-        }
+        };
+        for (auto shaderMapElement: mShaders)
+            updateShader(shaderMapElement.second);
+        for (auto shaderMapElement: mCollidingShaders)
+            updateShader(shaderMapElement.second);
     }
 
     void ShaderManager::releaseGLObjects(osg::State *state)
@@ -363,8 +548,13 @@ namespace Shader
         OpenThreads::ScopedLock<OpenThreads::Mutex> lock(mMutex);
         for (auto shader : mShaders)
         {
-            if (shader.second != nullptr)
-                shader.second->releaseGLObjects(state);
+            if (shader.second.mShader != nullptr)
+                shader.second.mShader->releaseGLObjects(state);
+        }
+        for (auto shader : mCollidingShaders)
+        {
+            if (shader.second.mShader != nullptr)
+                shader.second.mShader->releaseGLObjects(state);
         }
         for (auto program : mPrograms)
             program.second->releaseGLObjects(state);
@@ -1,8 +1,12 @@
 #ifndef OPENMW_COMPONENTS_SHADERMANAGER_H
 #define OPENMW_COMPONENTS_SHADERMANAGER_H
 
+#include <cstdint>
 #include <string>
 #include <map>
+#include <set>
+#include <unordered_map>
+#include <vector>
 
 #include <osg/ref_ptr>
 
@@ -20,6 +24,8 @@ namespace Shader
     class ShaderManager
     {
     public:
+        ShaderManager();
+
         void setShaderPath(const std::string& path);
 
         typedef std::map<std::string, std::string> DefineMap;
@@ -44,7 +50,28 @@ namespace Shader
 
         void releaseGLObjects(osg::State* state);
 
+        /// Remember the shader permutations of all programs created from now on, so that they can be saved with writePermutations().
+        void setRecordPermutations(bool record);
+
+        /// Create the programs listed in a file written by writePermutations(), so that they can be compiled before they are needed.
+        /// @return The created programs. Empty if the file does not exist or can't be read, entries that fail to build are skipped.
+        /// @note Thread safe.
+        std::vector<osg::ref_ptr<osg::Program> > readPermutations(const std::string& path);
+
+        /// Save the shader permutations of the programs recorded since setRecordPermutations(true), including those read with readPermutations().
+        /// @note Thread safe.
+        void writePermutations(const std::string& path);
+
     private:
+        /// Canonical key of a shader permutation, a 64-bit FNV-1a hash of the template name and the (sorted) defines.
+        static std::uint64_t makeShaderKey(const std::string& shaderTemplate, const DefineMap& defines);
+
+        /// @note Requires mMutex to be locked.
+        osg::ref_ptr<osg::Shader> getShaderImpl(const std::string& shaderTemplate, const DefineMap& defines, osg::Shader::Type shaderType);
+
+        /// @note Requires mMutex to be locked.
+        osg::ref_ptr<osg::Program> getProgramImpl(osg::ref_ptr<osg::Shader> vertexShader, osg::ref_ptr<osg::Shader> fragmentShader);
+
         std::string mPath;
 
         DefineMap mGlobalDefines;
@@ -53,13 +80,39 @@ namespace Shader
         typedef std::map<std::string, std::string> TemplateMap;
         TemplateMap mShaderTemplates;
 
-        typedef std::pair<std::string, DefineMap> MapKey;
-        typedef std::map<MapKey, osg::ref_ptr<osg::Shader> > ShaderMap;
+        struct ShaderEntry
+        {
+            std::string mTemplate;
+            DefineMap mDefines;
+            osg::Shader::Type mType;
+            osg::ref_ptr<osg::Shader> mShader; // nullptr if the shader failed to build
+        };
+        typedef std::unordered_map<std::uint64_t, ShaderEntry> ShaderMap;
         ShaderMap mShaders;
 
-        typedef std::map<std::pair<osg::ref_ptr<osg::Shader>, osg::ref_ptr<osg::Shader> >, osg::ref_ptr<osg::Program> > ProgramMap;
+        // <<template, defines>, shader> for shaders whose key is already taken by another shader in mShaders
+        typedef std::map<std::pair<std::string, DefineMap>, ShaderEntry> CollidingShaderMap;
+        CollidingShaderMap mCollidingShaders;
+
+        // <shader, key in mShaders>
+        std::unordered_map<const osg::Shader*, std::uint64_t> mShaderKeys;
+
+        typedef std::pair<osg::ref_ptr<osg::Shader>, osg::ref_ptr<osg::Shader> > ProgramKey;
+        struct ProgramKeyHash
+        {
+            size_t operator()(const ProgramKey& key) const
+            {
+                std::hash<const osg::Shader*> hash;
+                return hash(key.first.get()) ^ (hash(key.second.get()) * 31);
+            }
+        };
+        typedef std::unordered_map<ProgramKey, osg::ref_ptr<osg::Program>, ProgramKeyHash> ProgramMap;
         ProgramMap mPrograms;
 
+        bool mRecordPermutations;
+        // <vertex shader key, fragment shader key>
+        std::set<std::pair<std::uint64_t, std::uint64_t> > mRecordedPermutations;
+
         OpenThreads::Mutex mMutex;
     };
 
@@ -6,6 +6,11 @@
 
 #include <osgUtil/IncrementalCompileOperation>
 
+#include <osgDB/Registry>
+
+#include <components/debug/debuglog.hpp>
+#include <components/resource/diskcache.hpp>
+#include <components/resource/memoryusage.hpp>
 #include <components/resource/objectcache.hpp>
 #include <components/resource/scenemanager.hpp>
 
@@ -34,23 +39,132 @@ ChunkManager::ChunkManager(Storage *storage, Resource::SceneManager *sceneMgr, T
 
 }
 
+ChunkManager::~ChunkManager()
+{
+}
+
+/// Stores a rendered composite map in the disk cache.
+class WriteCompositeMap : public CompositeMapReadBack
+{
+public:
+    WriteCompositeMap(const Resource::DiskCache& diskCache, const Resource::DiskCacheKey& key)
+        : mDiskCache(diskCache), mKey(key)
+    {
+    }
+
+    void process(osg::Image& image) override
+    {
+        osgDB::ReaderWriter* readerwriter = osgDB::Registry::instance()->getReaderWriterForExtension("png");
+        if (!readerwriter)
+        {
+            Log(Debug::Warning) << "Can't write composite map to the disk cache: no png readerwriter found";
+            return;
+        }
+
+        std::ostringstream stream;
+        osgDB::ReaderWriter::WriteResult result = readerwriter->writeImage(image, stream);
+        if (!result.success())
+        {
+            Log(Debug::Warning) << "Can't write composite map to the disk cache: " << result.message() << " code " << result.status();
+            return;
+        }
+
+        mDiskCache.write(mKey, stream.str());
+    }
+
+private:
+    // copied, the renderer may still hold on to this after the chunk manager is gone
+    Resource::DiskCache mDiskCache;
+    Resource::DiskCacheKey mKey;
+};
+
+void ChunkManager::setDiskCachePath(const std::string &path)
+{
+    if (path.empty())
+        mDiskCache.reset();
+    else
+        mDiskCache.reset(new Resource::DiskCache(path));
+}
+
+void ChunkManager::PendingChunk::finish(osg::Node* node)
+{
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(mMutex);
+    mNode = node;
+    mDone = true;
+    mCondition.broadcast();
+}
+
+osg::ref_ptr<osg::Node> ChunkManager::PendingChunk::wait()
+{
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(mMutex);
+    while (!mDone)
+        mCondition.wait(&mMutex);
+    return mNode;
+}
+
 osg::ref_ptr<osg::Node> ChunkManager::getChunk(float size, const osg::Vec2f &center, unsigned char lod, unsigned int lodFlags)
 {
     ChunkId id = std::make_tuple(center, lod, lodFlags);
     osg::ref_ptr<osg::Object> obj = mCache->getRefFromObjectCache(id);
     if (obj)
         return obj->asNode();
-    else
+
+    osg::ref_ptr<PendingChunk> pending;
     {
-        osg::ref_ptr<osg::Node> node = createChunk(size, center, lod, lodFlags);
-        mCache->addEntryToObjectCache(id, node.get());
-        return node;
+        OpenThreads::ScopedLock<OpenThreads::Mutex> lock(mPendingMutex);
+        auto found = mPendingChunks.find(id);
+        if (found != mPendingChunks.end())
+            pending = found->second;
+        else
+        {
+            // the chunk may have been finished since the cache was checked, it is cached before it stops being pending
+            obj = mCache->getRefFromObjectCache(id);
+            if (obj)
+                return obj->asNode();
+            mPendingChunks.emplace(id, new PendingChunk);
+        }
     }
+
+    if (pending)
+    {
+        osg::ref_ptr<osg::Node> node = pending->wait();
+        if (node)
+            return node;
+        // the other thread failed, try again to report the error here as well
+        return getChunk(size, center, lod, lodFlags);
+    }
+
+    osg::ref_ptr<osg::Node> node;
+    try
+    {
+        node = createChunk(size, center, lod, lodFlags);
+    }
+    catch (...)
+    {
+        finishPendingChunk(id, nullptr);
+        throw;
+    }
+    mCache->addEntryToObjectCache(id, node.get(), 0.0, Resource::getNodeMemoryUsage(*node));
+    finishPendingChunk(id, node);
+    return node;
+}
+
+void ChunkManager::finishPendingChunk(const ChunkId &id, osg::Node *node)
+{
+    osg::ref_ptr<PendingChunk> pending;
+    {
+        OpenThreads::ScopedLock<OpenThreads::Mutex> lock(mPendingMutex);
+        auto found = mPendingChunks.find(id);
+        pending = found->second;
+        mPendingChunks.erase(found);
+    }
+    pending->finish(node);
 }
 
 void ChunkManager::reportStats(unsigned int frameNumber, osg::Stats *stats) const
 {
     stats->setAttribute(frameNumber, "Terrain Chunk", mCache->getCacheSize());
+    stats->setAttribute(frameNumber, "Chunk KiB", mCache->getMemoryUsage() / 1024.0);
 }
 
 void ChunkManager::clearCache()
@@ -66,6 +180,43 @@ void ChunkManager::releaseGLObjects(osg::State *state)
     mBufferCache.releaseGLObjects(state);
 }
 
+Resource::DiskCacheKey ChunkManager::makeCompositeMapKey(float chunkSize, const osg::Vec2f &chunkCenter)
+{
+    // Bump the version when changing how composite maps are rendered
+    const int version = 1;
+
+    Resource::DiskCacheKey key;
+    key.add("composite map").add(version)
+        .add(chunkSize).add(chunkCenter.x()).add(chunkCenter.y())
+        .add(mCompositeMapSize).add(mMaxCompGeometrySize);
+    mStorage->addBlendmapsToKey(chunkSize, chunkCenter, key);
+    return key;
+}
+
+osg::ref_ptr<osg::Texture2D> ChunkManager::loadCompositeMap(const Resource::DiskCacheKey &key)
+{
+    std::string data;
+    if (!mDiskCache->read(key, data))
+        return nullptr;
+
+    osgDB::ReaderWriter* readerwriter = osgDB::Registry::instance()->getReaderWriterForExtension("png");
+    if (!readerwriter)
+        return nullptr;
+
+    std::istringstream stream(data);
+    osgDB::ReaderWriter::ReadResult result = readerwriter->readImage(stream);
+    if (!result.success())
+    {
+        Log(Debug::Warning) << "Failed to read cached composite map " << key.toString() << ": " << result.message();
+        return nullptr;
+    }
+
+    osg::ref_ptr<osg::Texture2D> texture = createCompositeMapRTT();
+    texture->setImage(result.getImage());
+    texture->setUnRefImageDataAfterApply(true);
+    return texture;
+}
+
 osg::ref_ptr<osg::Texture2D> ChunkManager::createCompositeMapRTT()
 {
     osg::ref_ptr<osg::Texture2D> texture = new osg::Texture2D;
@@ -200,18 +351,34 @@ osg::ref_ptr<osg::Node> ChunkManager::createChunk(float chunkSize, const osg::Ve
 
     if (useCompositeMap)
     {
-        osg::ref_ptr<CompositeMap> compositeMap = new CompositeMap;
-        compositeMap->mTexture = createCompositeMapRTT();
+        osg::ref_ptr<osg::Texture2D> texture;
+        osg::ref_ptr<CompositeMapReadBack> readBack;
+        if (mDiskCache)
+        {
+            Resource::DiskCacheKey key = makeCompositeMapKey(chunkSize, chunkCenter);
+            texture = loadCompositeMap(key);
+            if (!texture)
+                readBack = new WriteCompositeMap(*mDiskCache, key);
+        }
 
-        createCompositeMapGeometry(chunkSize, chunkCenter, osg::Vec4f(0,0,1,1), *compositeMap);
+        if (!texture)
+        {
+            osg::ref_ptr<CompositeMap> compositeMap = new CompositeMap;
+            compositeMap->mTexture = createCompositeMapRTT();
+            compositeMap->mReadBack = readBack;
 
-        mCompositeMapRenderer->addCompositeMap(compositeMap.get(), false);
+            createCompositeMapGeometry(chunkSize, chunkCenter, osg::Vec4f(0,0,1,1), *compositeMap);
 
-        geometry->setCompositeMap(compositeMap);
-        geometry->setCompositeMapRenderer(mCompositeMapRenderer);
+            mCompositeMapRenderer->addCompositeMap(compositeMap.get(), false);
+
+            geometry->setCompositeMap(compositeMap);
+            geometry->setCompositeMapRenderer(mCompositeMapRenderer);
+
+            texture = compositeMap->mTexture;
+        }
 
         TextureLayer layer;
-        layer.mDiffuseMap = compositeMap->mTexture;
+        layer.mDiffuseMap = texture;
         layer.mParallax = false;
         layer.mSpecular = false;
         geometry->setPasses(::Terrain::createPasses(mSceneManager->getForceShaders() || !mSceneManager->getClampLighting(), &mSceneManager->getShaderManager(), std::vector<TextureLayer>(1, layer), std::vector<osg::ref_ptr<osg::Texture2D> >(), 1.f, 1.f));
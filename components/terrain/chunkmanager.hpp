@@ -1,8 +1,13 @@
 #ifndef OPENMW_COMPONENTS_TERRAIN_CHUNKMANAGER_H
 #define OPENMW_COMPONENTS_TERRAIN_CHUNKMANAGER_H
 
+#include <map>
+#include <memory>
 #include <tuple>
 
+#include <OpenThreads/Condition>
+#include <OpenThreads/Mutex>
+
 #include <components/resource/resourcemanager.hpp>
 
 #include "buffercache.hpp"
@@ -16,6 +21,8 @@ namespace osg
 namespace Resource
 {
     class SceneManager;
+    class DiskCache;
+    class DiskCacheKey;
 }
 
 namespace Terrain
@@ -33,7 +40,9 @@ namespace Terrain
     {
     public:
         ChunkManager(Storage* storage, Resource::SceneManager* sceneMgr, TextureManager* textureManager, CompositeMapRenderer* renderer);
+        ~ChunkManager();
 
+        /// @note Thread safe. A chunk that is already being created by another thread is waited for rather than created again.
         osg::ref_ptr<osg::Node> getChunk(float size, const osg::Vec2f& center, unsigned char lod, unsigned int lodFlags);
 
         void setCullingActive(bool active) { mCullingActive = active; }
@@ -41,6 +50,11 @@ namespace Terrain
         void setCompositeMapLevel(float level) { mCompositeMapLevel = level; }
         void setMaxCompositeGeometrySize(float maxCompGeometrySize) { mMaxCompGeometrySize = maxCompGeometrySize; }
 
+        /// Store rendered composite maps in \a path and load them from there in later sessions, instead of rendering them
+        /// again. An empty path disables the cache.
+        /// @note Must be called before any chunks are created.
+        void setDiskCachePath(const std::string& path);
+
         void reportStats(unsigned int frameNumber, osg::Stats* stats) const override;
 
         void clearCache() override;
@@ -48,6 +62,24 @@ namespace Terrain
         void releaseGLObjects(osg::State* state) override;
 
     private:
+        /// A chunk that one thread is creating, and others may wait for.
+        struct PendingChunk : public osg::Referenced
+        {
+            OpenThreads::Mutex mMutex;
+            OpenThreads::Condition mCondition;
+            bool mDone;
+            osg::ref_ptr<osg::Node> mNode; // nullptr if the creation failed
+
+            PendingChunk() : mDone(false) {}
+            void finish(osg::Node* node);
+            osg::ref_ptr<osg::Node> wait();
+        };
+
+        OpenThreads::Mutex mPendingMutex;
+        std::map<ChunkId, osg::ref_ptr<PendingChunk> > mPendingChunks;
+
+        void finishPendingChunk(const ChunkId& id, osg::Node* node);
+
         osg::ref_ptr<osg::Node> createChunk(float size, const osg::Vec2f& center, unsigned char lod, unsigned int lodFlags);
 
         osg::ref_ptr<osg::Texture2D> createCompositeMapRTT();
@@ -56,6 +88,11 @@ namespace Terrain
 
         std::vector<osg::ref_ptr<osg::StateSet> > createPasses(float chunkSize, const osg::Vec2f& chunkCenter, bool forCompositeMap);
 
+        Resource::DiskCacheKey makeCompositeMapKey(float chunkSize, const osg::Vec2f& chunkCenter);
+
+        /// @return nullptr if the composite map is not in the disk cache or could not be read.
+        osg::ref_ptr<osg::Texture2D> loadCompositeMap(const Resource::DiskCacheKey& key);
+
         Terrain::Storage* mStorage;
         Resource::SceneManager* mSceneManager;
         TextureManager* mTextureManager;
@@ -67,6 +104,8 @@ namespace Terrain
         float mMaxCompGeometrySize;
 
         bool mCullingActive;
+
+        std::unique_ptr<Resource::DiskCache> mDiskCache;
     };
 
 }
@@ -3,17 +3,60 @@
 #include <OpenThreads/ScopedLock>
 
 #include <osg/FrameBufferObject>
+#include <osg/Image>
 #include <osg/Texture2D>
 #include <osg/RenderInfo>
 
+#include <components/resource/imagemanager.hpp>
 #include <components/sceneutil/unrefqueue.hpp>
 #include <components/sceneutil/workqueue.hpp>
 
 #include <algorithm>
 
+namespace
+{
+
+    /// Does the state set use a texture that has not been loaded in full resolution yet?
+    bool usesPreviewImage(const osg::StateSet& stateset)
+    {
+        for (unsigned int unit=0; unit<stateset.getTextureAttributeList().size(); ++unit)
+        {
+            const osg::Texture* texture = dynamic_cast<const osg::Texture*>(stateset.getTextureAttribute(unit, osg::StateAttribute::TEXTURE));
+            if (!texture)
+                continue;
+            for (unsigned int i=0; i<texture->getNumImages(); ++i)
+            {
+                const osg::Image* image = texture->getImage(i);
+                if (image && Resource::ImageManager::isPreview(*image))
+                    return true;
+            }
+        }
+        return false;
+    }
+
+}
+
 namespace Terrain
 {
 
+class ReadBackWorkItem : public SceneUtil::WorkItem
+{
+public:
+    ReadBackWorkItem(CompositeMapReadBack* readBack, osg::Image* image)
+        : mReadBack(readBack), mImage(image)
+    {
+    }
+
+    void doWork() override
+    {
+        mReadBack->process(*mImage);
+    }
+
+private:
+    osg::ref_ptr<CompositeMapReadBack> mReadBack;
+    osg::ref_ptr<osg::Image> mImage;
+};
+
 CompositeMapRenderer::CompositeMapRenderer()
     : mTargetFrameRate(120)
     , mMinimumTimeAvailable(0.0025)
@@ -129,7 +172,12 @@ void CompositeMapRenderer::compile(CompositeMap &compositeMap, osg::RenderInfo &
         osg::StateSet* stateset = drw->getStateSet();
 
         if (stateset)
+        {
+            // the map is only good until the full image is swapped in, don't store it
+            if (compositeMap.mReadBack && usesPreviewImage(*stateset))
+                compositeMap.mReadBack = nullptr;
             renderInfo.getState()->pushStateSet(stateset);
+        }
 
         renderInfo.getState()->apply();
 
@@ -156,13 +204,29 @@ void CompositeMapRenderer::compile(CompositeMap &compositeMap, osg::RenderInfo &
                 break;
         }
     }
-    if (compositeMap.mCompiled == compositeMap.mDrawables.size())
+    bool finished = compositeMap.mCompiled == compositeMap.mDrawables.size();
+    if (finished)
         compositeMap.mDrawables = std::vector<osg::ref_ptr<osg::Drawable>>();
 
     state.haveAppliedAttribute(osg::StateAttribute::VIEWPORT);
 
     GLuint fboId = state.getGraphicsContext() ? state.getGraphicsContext()->getDefaultFboId() : 0;
     ext->glBindFramebuffer(GL_FRAMEBUFFER_EXT, fboId);
+
+    if (finished && compositeMap.mReadBack)
+    {
+        osg::ref_ptr<osg::Image> image = new osg::Image;
+        compositeMap.mTexture->apply(state);
+        image->readImageFromCurrentTexture(state.getContextID(), false, GL_UNSIGNED_BYTE);
+        state.haveAppliedTextureAttribute(state.getActiveTextureUnit(), compositeMap.mTexture.get());
+
+        osg::ref_ptr<ReadBackWorkItem> item = new ReadBackWorkItem(compositeMap.mReadBack.get(), image.get());
+        compositeMap.mReadBack = nullptr;
+        if (mWorkQueue)
+            mWorkQueue->addWorkItem(item);
+        else
+            item->doWork();
+    }
 }
 
 void CompositeMapRenderer::setMinimumTimeAvailableForCompile(double time)
@@ -10,6 +10,7 @@
 namespace osg
 {
     class FrameBufferObject;
+    class Image;
     class RenderInfo;
     class Texture2D;
 }
@@ -23,6 +24,14 @@ namespace SceneUtil
 namespace Terrain
 {
 
+    /// @brief Receives the contents of a composite map once it has been rendered, e.g. to store them.
+    class CompositeMapReadBack : public osg::Referenced
+    {
+    public:
+        /// @note Called from a worker thread if the CompositeMapRenderer has a WorkQueue, otherwise from the draw thread.
+        virtual void process(osg::Image& image) = 0;
+    };
+
     class CompositeMap : public osg::Referenced
     {
     public:
@@ -31,6 +40,8 @@ namespace Terrain
         std::vector<osg::ref_ptr<osg::Drawable> > mDrawables;
         osg::ref_ptr<osg::Texture2D> mTexture;
         unsigned int mCompiled;
+        /// Optional. Reading back the texture stalls the graphics pipeline, so only use it for maps that are kept.
+        osg::ref_ptr<CompositeMapReadBack> mReadBack;
     };
 
     /**
@@ -1,6 +1,9 @@
 #include "quadtreenode.hpp"
 
+#include <algorithm>
 #include <cassert>
+#include <cmath>
+#include <limits>
 
 #include <osgUtil/CullVisitor>
 
@@ -109,23 +112,43 @@ void QuadTreeNode::initNeighbours()
 }
 
 void QuadTreeNode::traverse(ViewData* vd, const osg::Vec3f& viewPoint, LodCallback* lodCallback, float maxDist)
+{
+    vd->beginLodTraversal(viewPoint, maxDist);
+    traverseLod(vd, viewPoint, lodCallback, maxDist);
+}
+
+float QuadTreeNode::traverseLod(ViewData* vd, const osg::Vec3f& viewPoint, LodCallback* lodCallback, float maxDist)
 {
     if (!hasValidBounds())
-        return;
+        return std::numeric_limits<float>::max();
+
+    float margin = vd->reuseSubtree(this);
+    if (margin >= 0.f)
+        return margin;
 
     float dist = distance(viewPoint);
+    margin = std::abs(dist - maxDist);
     if (dist > maxDist)
-        return;
+        return margin;
 
-    bool stopTraversal = (lodCallback->isSufficientDetail(this, dist)) || !getNumChildren();
-
-    if (stopTraversal)
+    if (!getNumChildren())
+    {
         vd->add(this);
-    else
+        return margin;
+    }
+
+    margin = std::min(margin, lodCallback->getDetailMargin(this, dist));
+    if (lodCallback->isSufficientDetail(this, dist))
     {
-        for (unsigned int i=0; i<getNumChildren(); ++i)
-            getChild(i)->traverse(vd, viewPoint, lodCallback, maxDist);
+        vd->add(this);
+        return margin;
     }
+
+    unsigned int subtree = vd->beginSubtree(this);
+    for (unsigned int i=0; i<getNumChildren(); ++i)
+        margin = std::min(margin, getChild(i)->traverseLod(vd, viewPoint, lodCallback, maxDist));
+    vd->endSubtree(subtree, margin);
+    return margin;
 }
 
 void QuadTreeNode::traverseTo(ViewData* vd, float size, const osg::Vec2f& center)
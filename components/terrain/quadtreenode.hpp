@@ -43,6 +43,10 @@ namespace Terrain
         virtual ~LodCallback() {}
 
         virtual bool isSufficientDetail(QuadTreeNode *node, float dist) = 0;
+
+        /// Get how much the distance can change before isSufficientDetail could give a different result for the node.
+        /// Parts of a view are only traversed again if that may have happened, see ViewData::reuseSubtree.
+        virtual float getDetailMargin(QuadTreeNode *node, float dist) { return 0.f; }
     };
 
     class ViewDataMap;
@@ -92,6 +96,7 @@ namespace Terrain
         const osg::Vec2f& getCenter() const;
 
         /// Traverse nodes according to LOD selection.
+        /// @note Reuses the parts of the previous traversal of the view that can not have changed.
         void traverse(ViewData* vd, const osg::Vec3f& viewPoint, LodCallback* lodCallback, float maxDist);
 
         /// Traverse to a specific node and add only that node.
@@ -101,6 +106,9 @@ namespace Terrain
         void intersect(ViewData* vd, TerrainLineIntersector* intersector);
 
     private:
+        /// @return How far the view point can move before a LOD decision within this subtree could change.
+        float traverseLod(ViewData* vd, const osg::Vec3f& viewPoint, LodCallback* lodCallback, float maxDist);
+
         QuadTreeNode* mParent;
 
         QuadTreeNode* mNeighbours[4];
@@ -2,10 +2,13 @@
 
 #include <osgUtil/CullVisitor>
 
+#include <cmath>
+#include <limits>
 #include <sstream>
 
 #include <components/misc/constants.hpp>
 #include <components/sceneutil/mwshadowtechnique.hpp>
+#include <components/sceneutil/workqueue.hpp>
 
 #include "quadtreenode.hpp"
 #include "storage.hpp"
@@ -62,6 +65,17 @@ public:
         return nativeLodLevel <= lodLevel;
     }
 
+    virtual float getDetailMargin(QuadTreeNode* node, float dist)
+    {
+        int nativeLodLevel = Log2(static_cast<unsigned int>(node->getSize()/mMinSize));
+        if (nativeLodLevel == 0)
+            return std::numeric_limits<float>::max(); // always sufficient
+
+        // isSufficientDetail changes its mind where the distance crosses this threshold
+        float threshold = Constants::CellSizeInUnits*mMinSize*mFactor * (1 << nativeLodLevel);
+        return std::abs(dist - threshold);
+    }
+
 private:
     float mFactor;
     float mMinSize;
@@ -225,6 +239,7 @@ QuadTreeWorld::QuadTreeWorld(osg::Group *parent, osg::Group *compileRoot, Resour
     , mLodFactor(lodFactor)
     , mVertexLodMod(vertexLodMod)
     , mViewDistance(std::numeric_limits<float>::max())
+    , mChunkGeneration(0)
 {
     mChunkManager->setCompositeMapSize(compMapResolution);
     mChunkManager->setCompositeMapLevel(compMapLevel);
@@ -287,9 +302,10 @@ unsigned int getLodFlags(QuadTreeNode* node, int ourLod, int vertexLodMod, ViewD
     return lodFlags;
 }
 
-void loadRenderingNode(ViewData::Entry& entry, ViewData* vd, int vertexLodMod, ChunkManager* chunkManager)
+void loadRenderingNode(ViewData::Entry& entry, ViewData* vd, int vertexLodMod, ChunkManager* chunkManager,
+                       const std::vector<QuadTreeWorld::ChunkManager*>& extraChunkManagers, unsigned int chunkGeneration)
 {
-    if (!vd->hasChanged() && entry.mRenderingNode)
+    if (!vd->hasChanged() && entry.mRenderingNode && entry.mChunkGeneration == chunkGeneration)
         return;
 
     int ourLod = getVertexLod(entry.mNode, vertexLodMod);
@@ -305,10 +321,73 @@ void loadRenderingNode(ViewData::Entry& entry, ViewData* vd, int vertexLodMod, C
         }
     }
 
+    if (entry.mChunkGeneration != chunkGeneration)
+    {
+        entry.mRenderingNode = nullptr;
+        entry.mChunkGeneration = chunkGeneration;
+    }
+
     if (!entry.mRenderingNode)
-        entry.mRenderingNode = chunkManager->getChunk(entry.mNode->getSize(), entry.mNode->getCenter(), ourLod, entry.mLodFlags);
+    {
+        osg::ref_ptr<osg::Node> terrainChunk = chunkManager->getChunk(entry.mNode->getSize(), entry.mNode->getCenter(), ourLod, entry.mLodFlags);
+        if (extraChunkManagers.empty())
+            entry.mRenderingNode = terrainChunk;
+        else
+        {
+            osg::ref_ptr<osg::Group> group = new osg::Group;
+            group->addChild(terrainChunk);
+            for (QuadTreeWorld::ChunkManager* extraChunkManager : extraChunkManagers)
+            {
+                osg::ref_ptr<osg::Node> chunk = extraChunkManager->getChunk(entry.mNode->getSize(), entry.mNode->getCenter(), ourLod, entry.mLodFlags);
+                if (chunk)
+                    group->addChild(chunk);
+            }
+            entry.mRenderingNode = group;
+        }
+    }
 }
 
+/// Creates a terrain chunk in a worker thread, so that the chunks of a view are created in parallel.
+class CreateChunkWorkItem : public SceneUtil::WorkItem
+{
+public:
+    CreateChunkWorkItem(ChunkManager* chunkManager, float size, const osg::Vec2f& center, unsigned char lod, unsigned int lodFlags)
+        : mChunkManager(chunkManager), mSize(size), mCenter(center), mLod(lod), mLodFlags(lodFlags), mStarted(false)
+    {
+    }
+
+    void doWork() override
+    {
+        if (mStarted.exchange(true))
+            return;
+        try
+        {
+            mChunkManager->getChunk(mSize, mCenter, mLod, mLodFlags);
+        }
+        catch (std::exception&)
+        {
+            // reported when the chunk is requested by the view
+        }
+    }
+
+    /// Wait for the work if a worker started it, otherwise drop it.
+    void complete()
+    {
+        if (mStarted.exchange(true))
+            waitTillDone();
+        else
+            signalDone();
+    }
+
+private:
+    ChunkManager* mChunkManager;
+    float mSize;
+    osg::Vec2f mCenter;
+    unsigned char mLod;
+    unsigned int mLodFlags;
+    std::atomic<bool> mStarted;
+};
+
 void QuadTreeWorld::accept(osg::NodeVisitor &nv)
 {
     bool isCullVisitor = nv.getVisitorType() == osg::NodeVisitor::CULL_VISITOR;
@@ -371,11 +450,15 @@ void QuadTreeWorld::accept(osg::NodeVisitor &nv)
         }
     }
 
+    // intersections only concern the terrain itself
+    static const std::vector<ChunkManager*> sNoChunkManagers;
+    const std::vector<ChunkManager*>& chunkManagers = isCullVisitor ? mChunkManagers : sNoChunkManagers;
+
     for (unsigned int i=0; i<vd->getNumEntries(); ++i)
     {
         ViewData::Entry& entry = vd->getEntry(i);
 
-        loadRenderingNode(entry, vd, mVertexLodMod, mChunkManager.get());
+        loadRenderingNode(entry, vd, mVertexLodMod, mChunkManager.get(), chunkManagers, mChunkGeneration);
 
         entry.mRenderingNode->accept(nv);
     }
@@ -432,7 +515,7 @@ void QuadTreeWorld::cacheCell(View *view, int x, int y)
     for (unsigned int i=0; i<vd->getNumEntries(); ++i)
     {
         ViewData::Entry& entry = vd->getEntry(i);
-        loadRenderingNode(entry, vd, mVertexLodMod, mChunkManager.get());
+        loadRenderingNode(entry, vd, mVertexLodMod, mChunkManager.get(), mChunkManagers, mChunkGeneration);
     }
 }
 
@@ -449,11 +532,34 @@ void QuadTreeWorld::preload(View *view, const osg::Vec3f &viewPoint, std::atomic
     vd->setViewPoint(viewPoint);
     mRootNode->traverse(vd, viewPoint, mLodCallback, mViewDistance);
 
+    // Hand the terrain chunks to the work queue, while this thread goes through the view in order. The chunk manager
+    // makes sure each chunk is only created once, whichever thread gets to it first.
+    std::vector<osg::ref_ptr<CreateChunkWorkItem> > workItems;
+    if (mChunkWorkQueue)
+    {
+        for (unsigned int i=0; i<vd->getNumEntries(); ++i)
+        {
+            const ViewData::Entry& entry = vd->getEntry(i);
+            int ourLod = getVertexLod(entry.mNode, mVertexLodMod);
+            unsigned int lodFlags = getLodFlags(entry.mNode, ourLod, mVertexLodMod, vd);
+            osg::ref_ptr<CreateChunkWorkItem> item = new CreateChunkWorkItem(mChunkManager.get(), entry.mNode->getSize(), entry.mNode->getCenter(), ourLod, lodFlags);
+            mChunkWorkQueue->addWorkItem(item);
+            workItems.push_back(item);
+        }
+    }
+
     for (unsigned int i=0; i<vd->getNumEntries() && !abort; ++i)
     {
         ViewData::Entry& entry = vd->getEntry(i);
-        loadRenderingNode(entry, vd, mVertexLodMod, mChunkManager.get());
+        loadRenderingNode(entry, vd, mVertexLodMod, mChunkManager.get(), mChunkManagers, mChunkGeneration);
+
+        for (ChunkManager* chunkManager : mChunkManagers)
+            chunkManager->preloadChunk(entry.mNode->getSize(), entry.mNode->getCenter(), getVertexLod(entry.mNode, mVertexLodMod), entry.mLodFlags, viewPoint);
     }
+
+    for (const osg::ref_ptr<CreateChunkWorkItem>& item : workItems)
+        item->complete();
+
     vd->markUnchanged();
 }
 
@@ -472,6 +578,23 @@ void QuadTreeWorld::reportStats(unsigned int frameNumber, osg::Stats *stats)
     stats->setAttribute(frameNumber, "Composite", mCompositeMapRenderer->getCompileSetSize());
 }
 
+void QuadTreeWorld::setChunkWorkQueue(SceneUtil::WorkQueue* workQueue)
+{
+    mChunkWorkQueue = workQueue;
+}
+
+void QuadTreeWorld::addChunkManager(QuadTreeWorld::ChunkManager* manager)
+{
+    mChunkManagers.push_back(manager);
+}
+
+void QuadTreeWorld::rebuildViews()
+{
+    // entries created for an older generation get their rendering node replaced the next time they are used,
+    // including those of views that are still being preloaded
+    ++mChunkGeneration;
+}
+
 void QuadTreeWorld::loadCell(int x, int y)
 {
     // fallback behavior only for undefined cells (every other is already handled in quadtree)
@@ -4,11 +4,18 @@
 #include "world.hpp"
 #include "terraingrid.hpp"
 
+#include <osg/Vec2f>
+#include <osg/Vec3f>
+
 #include <OpenThreads/Mutex>
 
+#include <atomic>
+#include <vector>
+
 namespace osg
 {
     class NodeVisitor;
+    class Node;
 }
 
 namespace Terrain
@@ -43,6 +50,34 @@ namespace Terrain
 
         void reportStats(unsigned int frameNumber, osg::Stats* stats);
 
+        /// Set a WorkQueue to create the terrain chunks of a preloaded view in parallel.
+        /// @note Has to be a different queue than the one preload() is called from, otherwise the chunks could only be created
+        /// after preload() returned.
+        void setChunkWorkQueue(SceneUtil::WorkQueue* workQueue);
+
+        /// @brief Provides additional content that is drawn with the terrain chunks, e.g. distant objects.
+        class ChunkManager
+        {
+        public:
+            virtual ~ChunkManager() {}
+
+            /// @return The node to draw along with the terrain chunk of the same parameters, or nullptr if there is nothing to draw.
+            /// @note May be called from any thread, and concurrently.
+            virtual osg::ref_ptr<osg::Node> getChunk(float size, const osg::Vec2f& center, unsigned char lod, unsigned int lodFlags) = 0;
+
+            /// Called in addition to getChunk when a view is preloaded, to prepare the nodes that will be requested once the
+            /// view point is reached, if they differ from those requested now.
+            /// @note May be called from any thread, and concurrently.
+            virtual void preloadChunk(float size, const osg::Vec2f& center, unsigned char lod, unsigned int lodFlags, const osg::Vec3f& viewPoint) {}
+        };
+
+        /// @note Not thread safe, add chunk managers before the terrain is used.
+        void addChunkManager(ChunkManager* manager);
+
+        /// Discard the chunks that are currently in use, so they are requested again from the chunk managers.
+        /// Call after a chunk manager's content has changed.
+        void rebuildViews();
+
     private:
         void ensureQuadTreeBuilt();
 
@@ -56,6 +91,11 @@ namespace Terrain
         float mLodFactor;
         int mVertexLodMod;
         float mViewDistance;
+
+        std::vector<ChunkManager*> mChunkManagers;
+        std::atomic<unsigned int> mChunkGeneration;
+
+        osg::ref_ptr<SceneUtil::WorkQueue> mChunkWorkQueue;
     };
 
 }
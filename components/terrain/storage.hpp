@@ -15,6 +15,11 @@ namespace osg
     class Image;
 }
 
+namespace Resource
+{
+    class DiskCacheKey;
+}
+
 namespace Terrain
 {
     /// We keep storage of terrain data abstract here since we need different implementations for game and editor
@@ -74,8 +79,24 @@ namespace Terrain
         virtual void getBlendmaps (float chunkSize, const osg::Vec2f& chunkCenter, ImageVector& blendmaps,
                                std::vector<LayerInfo>& layerList) = 0;
 
+        /// Add everything that the blendmaps and layers of a terrain region depend on to a disk cache key, so that
+        /// textures rendered from them can be stored and told apart.
+        /// @note May be called from background threads.
+        /// @param chunkSize size of the region in cell units
+        /// @param chunkCenter center of the region in cell units
+        virtual void addBlendmapsToKey (float chunkSize, const osg::Vec2f& chunkCenter, Resource::DiskCacheKey& key) = 0;
+
         virtual float getHeightAt (const osg::Vec3f& worldPos) = 0;
 
+        /// Get the terrain heights at many positions at once, which is cheaper than querying them one by one when
+        /// neighbouring positions are next to each other.
+        /// @param heights the height at each of the positions will be written here
+        virtual void getHeightsAt (const std::vector<osg::Vec3f>& worldPos, std::vector<float>& heights) = 0;
+
+        /// Forget the land data kept around for height queries, e.g. because it was modified.
+        /// @note Thread safe.
+        virtual void clearHeightCache() = 0;
+
         /// Get the transformation factor for mapping cell units to world units.
         virtual float getCellWorldSize() = 0;
 
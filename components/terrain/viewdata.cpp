@@ -4,7 +4,11 @@ namespace Terrain
 {
 
 ViewData::ViewData()
-    : mNumEntries(0)
+    : mLodMaxDist(0.f)
+    , mHasLod(false)
+    , mPreviousHasLod(false)
+    , mPreviousLodMovement(-1.f)
+    , mNumPreviousEntries(0)
     , mLastUsageTimeStamp(0.0)
     , mChanged(false)
     , mHasViewPoint(false)
@@ -19,8 +23,14 @@ ViewData::~ViewData()
 
 void ViewData::copyFrom(const ViewData& other)
 {
-    mNumEntries = other.mNumEntries;
     mEntries = other.mEntries;
+    mEntryIndices = other.mEntryIndices;
+    mSubtrees = other.mSubtrees;
+    mSubtreeIndices = other.mSubtreeIndices;
+    mLodViewPoint = other.mLodViewPoint;
+    mLodMaxDist = other.mLodMaxDist;
+    mHasLod = other.mHasLod;
+    mNumPreviousEntries = other.mNumPreviousEntries;
     mChanged = other.mChanged;
     mHasViewPoint = other.mHasViewPoint;
     mViewPoint = other.mViewPoint;
@@ -28,19 +38,25 @@ void ViewData::copyFrom(const ViewData& other)
 
 void ViewData::add(QuadTreeNode *node)
 {
-    unsigned int index = mNumEntries++;
-
-    if (index+1 > mEntries.size())
-        mEntries.resize(index+1);
-
-    Entry& entry = mEntries[index];
-    if (entry.set(node))
+    IndexMap::const_iterator found = mPreviousEntryIndices.find(node);
+    if (found != mPreviousEntryIndices.end())
+        addEntry(mPreviousEntries[found->second]);
+    else
+    {
+        addEntry(Entry(node));
         mChanged = true;
+    }
+}
+
+void ViewData::addEntry(const Entry &entry)
+{
+    mEntryIndices[entry.mNode] = mEntries.size();
+    mEntries.push_back(entry);
 }
 
 unsigned int ViewData::getNumEntries() const
 {
-    return mNumEntries;
+    return mEntries.size();
 }
 
 ViewData::Entry &ViewData::getEntry(unsigned int i)
@@ -50,7 +66,19 @@ ViewData::Entry &ViewData::getEntry(unsigned int i)
 
 bool ViewData::hasChanged() const
 {
-    return mChanged;
+    // without new nodes, the view can only have changed if nodes were removed
+    return mChanged || mEntries.size() != mNumPreviousEntries;
+}
+
+void ViewData::markUnchanged()
+{
+    mChanged = false;
+    mNumPreviousEntries = mEntries.size();
+
+    mPreviousEntries.clear();
+    mPreviousEntryIndices.clear();
+    mPreviousSubtrees.clear();
+    mPreviousSubtreeIndices.clear();
 }
 
 bool ViewData::hasViewPoint() const
@@ -71,51 +99,128 @@ const osg::Vec3f& ViewData::getViewPoint() const
 
 void ViewData::reset()
 {
-    // clear any unused entries
-    for (unsigned int i=mNumEntries; i<mEntries.size(); ++i)
-        mEntries[i].set(nullptr);
+    mNumPreviousEntries = mEntries.size();
+
+    mEntries.swap(mPreviousEntries);
+    mEntryIndices.swap(mPreviousEntryIndices);
+    mSubtrees.swap(mPreviousSubtrees);
+    mSubtreeIndices.swap(mPreviousSubtreeIndices);
+    mPreviousHasLod = mHasLod;
 
-    // reset index for next frame
-    mNumEntries = 0;
+    mEntries.clear();
+    mEntryIndices.clear();
+    mSubtrees.clear();
+    mSubtreeIndices.clear();
+    mHasLod = false;
     mChanged = false;
 }
 
 void ViewData::clear()
 {
-    for (unsigned int i=0; i<mEntries.size(); ++i)
-        mEntries[i].set(nullptr);
-    mNumEntries = 0;
+    mEntries.clear();
+    mEntryIndices.clear();
+    mSubtrees.clear();
+    mSubtreeIndices.clear();
+    mHasLod = false;
+    mPreviousEntries.clear();
+    mPreviousEntryIndices.clear();
+    mPreviousSubtrees.clear();
+    mPreviousSubtreeIndices.clear();
+    mPreviousHasLod = false;
+    mNumPreviousEntries = 0;
     mLastUsageTimeStamp = 0;
     mChanged = false;
     mHasViewPoint = false;
 }
 
-bool ViewData::contains(QuadTreeNode *node)
+bool ViewData::contains(QuadTreeNode *node) const
+{
+    return mEntryIndices.find(node) != mEntryIndices.end();
+}
+
+void ViewData::beginLodTraversal(const osg::Vec3f &viewPoint, float maxDist)
 {
-    for (unsigned int i=0; i<mNumEntries; ++i)
-        if (mEntries[i].mNode == node)
-            return true;
-    return false;
+    // the previous subtrees are only of use if they were made with the same parameters
+    if (mPreviousHasLod && maxDist == mLodMaxDist)
+        mPreviousLodMovement = (viewPoint - mLodViewPoint).length();
+    else
+        mPreviousLodMovement = -1.f;
+
+    mLodViewPoint = viewPoint;
+    mLodMaxDist = maxDist;
+    mHasLod = true;
+}
+
+float ViewData::reuseSubtree(QuadTreeNode *node)
+{
+    if (mPreviousLodMovement < 0.f)
+        return -1.f;
+
+    IndexMap::const_iterator found = mPreviousSubtreeIndices.find(node);
+    if (found == mPreviousSubtreeIndices.end())
+        return -1.f;
+
+    const Subtree& subtree = mPreviousSubtrees[found->second];
+    // the distance of a node changes by no more than the view point moves
+    if (subtree.mMargin <= mPreviousLodMovement)
+        return -1.f;
+
+    const unsigned int entryOffset = mEntries.size();
+    for (unsigned int i=subtree.mFirstEntry; i<subtree.mEndEntry; ++i)
+        addEntry(mPreviousEntries[i]);
+
+    // keep the subtrees within as well, they may be reused again when the view point moves further
+    const unsigned int subtreeOffset = mSubtrees.size();
+    for (unsigned int i=found->second; i<subtree.mEndSubtree; ++i)
+    {
+        Subtree copy = mPreviousSubtrees[i];
+        copy.mMargin -= mPreviousLodMovement;
+        copy.mFirstEntry = copy.mFirstEntry - subtree.mFirstEntry + entryOffset;
+        copy.mEndEntry = copy.mEndEntry - subtree.mFirstEntry + entryOffset;
+        copy.mEndSubtree = copy.mEndSubtree - found->second + subtreeOffset;
+        mSubtreeIndices[copy.mNode] = mSubtrees.size();
+        mSubtrees.push_back(copy);
+    }
+
+    return subtree.mMargin - mPreviousLodMovement;
+}
+
+unsigned int ViewData::beginSubtree(QuadTreeNode *node)
+{
+    Subtree subtree;
+    subtree.mNode = node;
+    subtree.mMargin = 0.f;
+    subtree.mFirstEntry = mEntries.size();
+    subtree.mEndEntry = subtree.mFirstEntry;
+    subtree.mEndSubtree = mSubtrees.size() + 1;
+
+    mSubtreeIndices[node] = mSubtrees.size();
+    mSubtrees.push_back(subtree);
+    return mSubtrees.size() - 1;
+}
+
+void ViewData::endSubtree(unsigned int index, float margin)
+{
+    Subtree& subtree = mSubtrees[index];
+    subtree.mMargin = margin;
+    subtree.mEndEntry = mEntries.size();
+    subtree.mEndSubtree = mSubtrees.size();
 }
 
 ViewData::Entry::Entry()
     : mNode(nullptr)
     , mLodFlags(0)
+    , mChunkGeneration(0)
 {
 
 }
 
-bool ViewData::Entry::set(QuadTreeNode *node)
+ViewData::Entry::Entry(QuadTreeNode *node)
+    : mNode(node)
+    , mLodFlags(0)
+    , mChunkGeneration(0)
 {
-    if (node == mNode)
-        return false;
-    else
-    {
-        mNode = node;
-        // clear cached data
-        mRenderingNode = nullptr;
-        return true;
-    }
+
 }
 
 bool suitable(ViewData* vd, const osg::Vec3f& viewPoint, float& maxDist)
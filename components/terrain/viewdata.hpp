@@ -1,8 +1,9 @@
 #ifndef OPENMW_COMPONENTS_TERRAIN_VIEWDATA_H
 #define OPENMW_COMPONENTS_TERRAIN_VIEWDATA_H
 
-#include <vector>
 #include <deque>
+#include <unordered_map>
+#include <vector>
 
 #include <osg/Node>
 
@@ -19,26 +20,50 @@ namespace Terrain
         ViewData();
         ~ViewData();
 
+        /// Add a node to be rendered. A node that was part of the view before the last reset keeps its rendering node.
         void add(QuadTreeNode* node);
 
+        /// Start over with adding nodes. The previous entries are kept around until markUnchanged.
         void reset();
 
         void clear();
 
-        bool contains(QuadTreeNode* node);
+        bool contains(QuadTreeNode* node) const;
 
         void copyFrom(const ViewData& other);
 
+        /// @name Incremental LOD traversal
+        /// The LOD traversal records each subtree it descends into, along with how far the view point can move before
+        /// a LOD decision within the subtree could turn out differently. The next traversal takes the nodes of subtrees
+        /// that are still valid from the previous entries rather than descending into them again.
+        /// @{
+
+        /// Start a LOD traversal after reset.
+        void beginLodTraversal(const osg::Vec3f& viewPoint, float maxDist);
+
+        /// Add the nodes of the given subtree from the previous traversal if none of its LOD decisions can have changed.
+        /// @return The margin of the subtree for the current view point, or a negative value if it could not be reused.
+        float reuseSubtree(QuadTreeNode* node);
+
+        /// Record the subtree of a node that the traversal descends into, before adding its nodes.
+        /// @return The index to pass to endSubtree.
+        unsigned int beginSubtree(QuadTreeNode* node);
+
+        /// @param margin How far the view point can move before a LOD decision within the subtree could change.
+        void endSubtree(unsigned int index, float margin);
+
+        /// @}
+
         struct Entry
         {
             Entry();
-
-            bool set(QuadTreeNode* node);
+            Entry(QuadTreeNode* node);
 
             QuadTreeNode* mNode;
 
             unsigned int mLodFlags;
             osg::ref_ptr<osg::Node> mRenderingNode;
+            unsigned int mChunkGeneration; // of the chunk managers when mRenderingNode was created
         };
 
         unsigned int getNumEntries() const;
@@ -50,7 +75,9 @@ namespace Terrain
 
         /// @return Have any nodes changed since the last frame
         bool hasChanged() const;
-        void markUnchanged() { mChanged = false; }
+
+        /// Mark the view as up to date, and release what was left over from the previous entries.
+        void markUnchanged();
 
         bool hasViewPoint() const;
 
@@ -58,8 +85,35 @@ namespace Terrain
         const osg::Vec3f& getViewPoint() const;
 
     private:
+        void addEntry(const Entry& entry);
+
+        struct Subtree
+        {
+            QuadTreeNode* mNode;
+            float mMargin; // relative to mLodViewPoint
+            unsigned int mFirstEntry;
+            unsigned int mEndEntry;
+            unsigned int mEndSubtree; // the subtrees within this one follow it directly
+        };
+
+        typedef std::unordered_map<QuadTreeNode*, unsigned int> IndexMap;
+
         std::vector<Entry> mEntries;
-        unsigned int mNumEntries;
+        IndexMap mEntryIndices;
+        std::vector<Subtree> mSubtrees;
+        IndexMap mSubtreeIndices;
+        osg::Vec3f mLodViewPoint;
+        float mLodMaxDist;
+        bool mHasLod; // are mSubtrees the result of a LOD traversal?
+
+        std::vector<Entry> mPreviousEntries;
+        IndexMap mPreviousEntryIndices;
+        std::vector<Subtree> mPreviousSubtrees;
+        IndexMap mPreviousSubtreeIndices;
+        bool mPreviousHasLod;
+        float mPreviousLodMovement; // how far the view point moved since the previous LOD traversal
+        unsigned int mNumPreviousEntries;
+
         double mLastUsageTimeStamp;
         bool mChanged;
         osg::Vec3f mViewPoint;
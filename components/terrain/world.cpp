@@ -105,11 +105,21 @@ void World::setTargetFrameRate(float rate)
     mCompositeMapRenderer->setTargetFrameRate(rate);
 }
 
+void World::setCompositeMapDiskCachePath(const std::string &path)
+{
+    mChunkManager->setDiskCachePath(path);
+}
+
 float World::getHeightAt(const osg::Vec3f &worldPos)
 {
     return mStorage->getHeightAt(worldPos);
 }
 
+void World::getHeightsAt(const std::vector<osg::Vec3f> &worldPos, std::vector<float> &heights)
+{
+    mStorage->getHeightsAt(worldPos, heights);
+}
+
 void World::updateTextureFiltering()
 {
     mTextureManager->updateTextureFiltering();
@@ -118,6 +128,7 @@ void World::updateTextureFiltering()
 void World::clearAssociatedCaches()
 {
     mChunkManager->clearCache();
+    mStorage->clearHeightCache();
 }
 
 }
@@ -8,6 +8,7 @@
 #include <atomic>
 #include <memory>
 #include <set>
+#include <string>
 #include <atomic>
 
 #include "defs.hpp"
@@ -72,12 +73,18 @@ namespace Terrain
         /// See CompositeMapRenderer::setTargetFrameRate
         void setTargetFrameRate(float rate);
 
+        /// See ChunkManager::setDiskCachePath
+        void setCompositeMapDiskCachePath(const std::string& path);
+
         /// Apply the scene manager's texture filtering settings to all cached textures.
         /// @note Thread safe.
         void updateTextureFiltering();
 
         float getHeightAt (const osg::Vec3f& worldPos);
 
+        /// See Storage::getHeightsAt
+        void getHeightsAt (const std::vector<osg::Vec3f>& worldPos, std::vector<float>& heights);
+
         /// Clears the cached land and landtexture data.
         /// @note Thread safe.
         virtual void clearAssociatedCaches();